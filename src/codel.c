@@ -0,0 +1,131 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "codel.h"
+
+/*
+ * Follows the dequeue side of RFC 8289. The caller asks about the packet
+ * at the head of the queue each time it is about to send one, and drops
+ * it instead if told to.
+ */
+
+/**
+ *	@brief Sets up the state of an empty queue
+ *	@param codel - the state
+ *	@param target - acceptable time in the queue
+ *	@param interval - time above target before dropping
+ *	@return void
+ */
+void codel_init(struct codel *codel, unsigned long long target,
+		unsigned long long interval)
+{
+	memset(codel, 0, sizeof(struct codel));
+	codel->target = target;
+	codel->interval = interval;
+}
+
+/**
+ *	@brief Finds when to drop next
+ *	@param codel - the state
+ *	@param t - time of the last drop
+ *	@return time of the next drop
+ */
+static unsigned long long codel_control(struct codel *codel,
+		unsigned long long t)
+{
+	return t + (unsigned long long)(codel->interval / sqrt(codel->count));
+}
+
+/**
+ *	@brief Decides whether the packet at the head of the queue is dropped
+ *	@param codel - the state
+ *	@param now - the current time
+ *	@param sojourn - how long the packet has been in the queue
+ *	@return 1 to drop it, 0 to send it
+ */
+int codel_drop(struct codel *codel, unsigned long long now,
+		unsigned long long sojourn)
+{
+	unsigned int delta;
+	int ok_to_drop;
+
+	ok_to_drop = 0;
+	if (sojourn < codel->target)
+		codel->first_above = 0;
+	else if (codel->first_above == 0)
+		codel->first_above = now + codel->interval;
+	else if (now >= codel->first_above)
+		ok_to_drop = 1;
+
+	if (codel->dropping) {
+		if (!ok_to_drop) {
+			/* back under target */
+			codel->dropping = 0;
+			return 0;
+		}
+		if (now < codel->drop_next)
+			return 0;
+
+		codel->count++;
+		codel->drop_next = codel_control(codel, codel->drop_next);
+		return 1;
+	}
+
+	if (!ok_to_drop)
+		return 0;
+
+	/* start near the old rate if dropping stopped only recently */
+	codel->dropping = 1;
+	delta = codel->count - codel->last_count;
+	if ((delta > 1) && (now - codel->drop_next < 16 * codel->interval))
+		codel->count = delta;
+	else
+		codel->count = 1;
+	codel->last_count = codel->count;
+	codel->drop_next = codel_control(codel, now);
+
+	return 1;
+}
+
+/**
+ *	@brief Notes that the queue ran empty
+ *	@param codel - the state
+ *	@return void
+ */
+void codel_empty(struct codel *codel)
+{
+	codel->first_above = 0;
+	codel->dropping = 0;
+}
@@ -0,0 +1,65 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef CODEL_H_
+#define CODEL_H_
+
+/**
+ *      \brief Controlled delay state of one queue
+ *
+ *      CoDel drops from the head of a queue once packets have waited
+ *      longer than target for a whole interval, then drops more often,
+ *      at interval over the square root of the drops so far, until the
+ *      wait falls back under target. Times are in microseconds.
+ */
+struct codel {
+	/** acceptable time spent in the queue */
+	unsigned long long target;
+	/** time the wait must stay above target before dropping */
+	unsigned long long interval;
+	/** when the wait will have been above target for interval, 0 if below */
+	unsigned long long first_above;
+	/** when to drop next while dropping */
+	unsigned long long drop_next;
+	/** drops since dropping started */
+	unsigned int count;
+	/** count when dropping last started */
+	unsigned int last_count;
+	/** set while dropping */
+	int dropping;
+};
+
+void codel_init(struct codel *, unsigned long long, unsigned long long);
+int codel_drop(struct codel *, unsigned long long, unsigned long long);
+void codel_empty(struct codel *);
+
+#endif /* CODEL_H_ */
@@ -0,0 +1,198 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+/*
+ * Microbenchmark for distance_batch. Scatters receivers around a
+ * transmitter, checks both formulas against get_distance and times them.
+ *
+ * usage: distance-bench [receivers] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "distance.h"
+
+/** Radio range used for the comparison, as in wmasterd */
+#define BENCH_RANGE	2500
+
+/**
+ *	@brief Reads a monotonic clock
+ *	@return time in nanoseconds
+ */
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ *	@brief Times distance_batch and checks it against get_distance
+ *	@param name - label to print
+ *	@param tx - the transmitter
+ *	@param rx - the receivers
+ *	@param count - number of receivers
+ *	@param rounds - number of times to measure every receiver
+ *	@param method - DISTANCE_HAVERSINE or DISTANCE_EQUIRECT
+ *	@param out - buffer for count distances
+ *	@return void
+ */
+static void bench_batch(const char *name, struct geo_point *tx,
+		struct geo_points *rx, int count, int rounds, int method,
+		int *out)
+{
+	double start;
+	double elapsed;
+	int worst;
+	int miss;
+	int ref;
+	int d;
+	int i;
+	int r;
+
+	start = now_ns();
+	for (r = 0; r < rounds; r++) {
+		/*
+		 * the compiler must assume the barrier changed *tx and out,
+		 * so no round can be hoisted or folded into another
+		 */
+		__asm__ __volatile__("" : : "r"(tx), "r"(out) : "memory");
+		distance_batch(tx, rx, count, method, BENCH_RANGE, out);
+	}
+	elapsed = now_ns() - start;
+
+	worst = 0;
+	miss = 0;
+	for (i = 0; i < count; i++) {
+		ref = get_distance(tx->latitude, tx->longitude,
+				rx->latitude[i], rx->longitude[i]);
+		if ((ref > BENCH_RANGE) || (ref < 0)) {
+			if (out[i] >= 0)
+				miss++;
+			continue;
+		}
+		if (out[i] < 0) {
+			/* right on the edge either answer is fine */
+			if (ref < BENCH_RANGE - 1)
+				miss++;
+			continue;
+		}
+		d = abs(out[i] - ref);
+		if (d > worst)
+			worst = d;
+	}
+
+	printf("%-14s %8.2f ns/pair  max error %d m  range mismatches %d\n",
+			name, elapsed / ((double)count * rounds), worst, miss);
+}
+
+int main(int argc, char *argv[])
+{
+	struct geo_points rx;
+	struct geo_point tx;
+	double start;
+	double elapsed;
+	volatile int sink;
+	int rounds;
+	int count;
+	int *out;
+	int i;
+	int r;
+
+	count = (argc > 1) ? atoi(argv[1]) : 4096;
+	rounds = (argc > 2) ? atoi(argv[2]) : 1000;
+	if ((count <= 0) || (rounds <= 0)) {
+		fprintf(stderr, "usage: %s [receivers] [rounds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rx.latitude = malloc(count * sizeof(float));
+	rx.longitude = malloc(count * sizeof(float));
+	rx.sin_lat = malloc(count * sizeof(double));
+	rx.cos_lat = malloc(count * sizeof(double));
+	rx.sin_lon = malloc(count * sizeof(double));
+	rx.cos_lon = malloc(count * sizeof(double));
+	out = malloc(count * sizeof(int));
+	if (!rx.latitude || !rx.longitude || !rx.sin_lat || !rx.cos_lat ||
+			!rx.sin_lon || !rx.cos_lon || !out) {
+		perror("distance-bench: malloc");
+		return EXIT_FAILURE;
+	}
+
+	geo_point_set(&tx, 40.44f, -79.94f);
+
+	/* about half the receivers land within radio range */
+	srand(1);
+	for (i = 0; i < count; i++) {
+		rx.latitude[i] = tx.latitude +
+			0.05f * ((float)rand() / RAND_MAX - 0.5f);
+		rx.longitude[i] = tx.longitude +
+			0.06f * ((float)rand() / RAND_MAX - 0.5f);
+	}
+
+	start = now_ns();
+	geo_points_trig(&rx, 0, count);
+	elapsed = now_ns() - start;
+
+	printf("%d receivers, %d rounds\n", count, rounds);
+	printf("%-14s %8.2f ns/point\n", "trig", elapsed / count);
+
+	start = now_ns();
+	sink = 0;
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < count; i++)
+			sink += get_distance(tx.latitude, tx.longitude,
+				rx.latitude[i], rx.longitude[i]);
+	elapsed = now_ns() - start;
+	printf("%-14s %8.2f ns/pair\n", "get_distance",
+			elapsed / ((double)count * rounds));
+
+	bench_batch("haversine", &tx, &rx, count, rounds, DISTANCE_HAVERSINE,
+			out);
+	bench_batch("equirect", &tx, &rx, count, rounds, DISTANCE_EQUIRECT,
+			out);
+
+	free(rx.latitude);
+	free(rx.longitude);
+	free(rx.sin_lat);
+	free(rx.cos_lat);
+	free(rx.sin_lon);
+	free(rx.cos_lon);
+	free(out);
+
+	return EXIT_SUCCESS;
+}
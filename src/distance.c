@@ -0,0 +1,360 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "distance.h"
+
+/**
+ *      convert radians to degrees
+ *      @param rad - angle in radians
+ *      @return degrees
+ */
+double radians_to_degrees(double rad) {
+	return (rad * 180 / M_PI);
+}
+
+/**
+ *      convert degrees to radians
+ *      @param deg - angle in degrees
+ *      @return radians
+ */
+double degrees_to_radians(double deg) {
+	return (deg * M_PI / 180);
+}
+
+/**
+ *	Calculates the distance between two locations
+ *	@param lat1 - latitude of the first location
+ *	@param lon1 - longitude of the first location
+ *	@param lat2 - latitude of the second location
+ *	@param lon2 - longitude of the second location
+ *	@return distance in meters
+ */
+int get_distance(float lat1, float lon1, float lat2, float lon2)
+{
+	int distance;
+	double theta;
+	double dist;
+	double a;
+	double c;
+
+	a = degrees_to_radians(lat1);
+	c = degrees_to_radians(lat2);
+
+	theta = degrees_to_radians(lon1 - lon2);
+	dist = sin(a) * sin(c) + cos(a) * cos(c) * cos(theta);
+	dist = acos(dist);
+	dist = radians_to_degrees(dist);
+	dist = dist * 60 * 1.1515;
+	dist = dist * 1.609344;
+	dist = dist * 1000;
+
+	distance = dist;
+
+	return distance;
+}
+
+/**
+ *	@brief Sets a location and works out its trig
+ *	@param point - the point to set
+ *	@param lat - latitude in degrees decimal
+ *	@param lon - longitude in degrees decimal
+ *	@return void
+ */
+void geo_point_set(struct geo_point *point, float lat, float lon)
+{
+	point->latitude = lat;
+	point->longitude = lon;
+	point->sin_lat = sin(degrees_to_radians(lat));
+	point->cos_lat = cos(degrees_to_radians(lat));
+	point->sin_lon = sin(degrees_to_radians(lon));
+	point->cos_lon = cos(degrees_to_radians(lon));
+}
+
+/**
+ *	@brief Works out the trig of a run of locations
+ *	@param points - the locations
+ *	@param first - position of the first location to update
+ *	@param count - number of locations to update
+ *	@return void
+ */
+void geo_points_trig(struct geo_points *points, int first, int count)
+{
+	double lat;
+	double lon;
+	int i;
+
+	for (i = first; i < first + count; i++) {
+		lat = degrees_to_radians(points->latitude[i]);
+		lon = degrees_to_radians(points->longitude[i]);
+		points->sin_lat[i] = sin(lat);
+		points->cos_lat[i] = cos(lat);
+		points->sin_lon[i] = sin(lon);
+		points->cos_lon[i] = cos(lon);
+	}
+}
+
+/*
+ * Both formulas test the range before taking a square root and so never
+ * need an inverse trig function. They agree with get_distance to within
+ * 1 m for every pair in radio range, the equirectangular one as long as
+ * neither location is within a few degrees of a pole.
+ *
+ * Haversine: the half angle terms come from the cosine of the difference,
+ * cos(a - b) = cos(a)cos(b) + sin(a)sin(b), so only the trig of each
+ * location is needed. The central angle is 2 asin(sqrt(h)), and since h
+ * is tiny for anything in range the first three terms of the asin series
+ * are exact to well under a millimeter.
+ *
+ * Equirectangular: the longitude difference is scaled by the mean of the
+ * cosines of the two latitudes.
+ */
+
+/**
+ *	@brief Haversine distance between a transmitter and one receiver
+ *	@param tx - the transmitter
+ *	@param rx - the receivers
+ *	@param i - position of the receiver
+ *	@param limit - largest haversine in range
+ *	@return distance in meters or -1 if out of range
+ */
+static int haversine_one(const struct geo_point *tx,
+		const struct geo_points *rx, int i, double limit)
+{
+	double cos_lat;
+	double h;
+	double x;
+
+	cos_lat = tx->cos_lat * rx->cos_lat[i];
+	h = (1 - (cos_lat + tx->sin_lat * rx->sin_lat[i])) / 2 +
+		cos_lat * (1 - (tx->cos_lon * rx->cos_lon[i] +
+		tx->sin_lon * rx->sin_lon[i])) / 2;
+	if (h < 0)
+		h = 0;
+	if (!(h <= limit))
+		return -1;
+
+	x = sqrt(h);
+
+	return 2 * EARTH_RADIUS * (x + x * x * x / 6 +
+			3 * x * x * x * x * x / 40);
+}
+
+/**
+ *	@brief Equirectangular distance between a transmitter and one receiver
+ *	@param tx - the transmitter
+ *	@param rx - the receivers
+ *	@param i - position of the receiver
+ *	@param limit - largest squared angle in range
+ *	@return distance in meters or -1 if out of range
+ */
+static int equirect_one(const struct geo_point *tx,
+		const struct geo_points *rx, int i, double limit)
+{
+	double dlat;
+	double dlon;
+	double d;
+
+	dlat = (double)rx->latitude[i] - tx->latitude;
+	dlon = fabs((double)rx->longitude[i] - tx->longitude);
+	/* the short way round across the antimeridian */
+	if (dlon > 180)
+		dlon = 360 - dlon;
+
+	dlat *= M_PI / 180;
+	dlon *= M_PI / 180 * (tx->cos_lat + rx->cos_lat[i]) / 2;
+
+	d = dlat * dlat + dlon * dlon;
+	if (!(d <= limit))
+		return -1;
+
+	return EARTH_RADIUS * sqrt(d);
+}
+
+#ifdef __SSE2__
+/**
+ *	@brief Haversine distances for pairs of receivers at a time
+ *	@param tx - the transmitter
+ *	@param rx - the receivers
+ *	@param count - number of receivers, handled two at a time
+ *	@param limit - largest haversine in range
+ *	@param out - distance to each receiver or -1 if out of range
+ *	@return number of receivers handled
+ */
+static int haversine_sse2(const struct geo_point *tx,
+		const struct geo_points *rx, int count, double limit, int *out)
+{
+	__m128d tsl, tcl, tso, tco;
+	__m128d one, half, zero, lim, none;
+	__m128d c6, c40, r2;
+	__m128d cos_lat, h, x, x2, d, in;
+	int i;
+
+	tsl = _mm_set1_pd(tx->sin_lat);
+	tcl = _mm_set1_pd(tx->cos_lat);
+	tso = _mm_set1_pd(tx->sin_lon);
+	tco = _mm_set1_pd(tx->cos_lon);
+	one = _mm_set1_pd(1);
+	half = _mm_set1_pd(0.5);
+	zero = _mm_setzero_pd();
+	lim = _mm_set1_pd(limit);
+	none = _mm_set1_pd(-1);
+	c6 = _mm_set1_pd(1.0 / 6);
+	c40 = _mm_set1_pd(3.0 / 40);
+	r2 = _mm_set1_pd(2 * EARTH_RADIUS);
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		cos_lat = _mm_mul_pd(tcl, _mm_loadu_pd(rx->cos_lat + i));
+		h = _mm_sub_pd(one, _mm_add_pd(cos_lat,
+			_mm_mul_pd(tsl, _mm_loadu_pd(rx->sin_lat + i))));
+		d = _mm_sub_pd(one, _mm_add_pd(
+			_mm_mul_pd(tco, _mm_loadu_pd(rx->cos_lon + i)),
+			_mm_mul_pd(tso, _mm_loadu_pd(rx->sin_lon + i))));
+		h = _mm_mul_pd(half, _mm_add_pd(h, _mm_mul_pd(cos_lat, d)));
+		/* NaN is kept so it compares out of range */
+		h = _mm_max_pd(zero, h);
+		in = _mm_cmple_pd(h, lim);
+
+		x = _mm_sqrt_pd(h);
+		x2 = _mm_mul_pd(x, x);
+		/* x (1 + x^2 / 6 + 3 x^4 / 40) */
+		d = _mm_add_pd(_mm_mul_pd(c6, x2),
+			_mm_mul_pd(c40, _mm_mul_pd(x2, x2)));
+		d = _mm_mul_pd(r2, _mm_mul_pd(x, _mm_add_pd(one, d)));
+
+		d = _mm_or_pd(_mm_and_pd(in, d), _mm_andnot_pd(in, none));
+		_mm_storel_epi64((__m128i *)(out + i), _mm_cvttpd_epi32(d));
+	}
+
+	return i;
+}
+
+/**
+ *	@brief Equirectangular distances for pairs of receivers at a time
+ *	@param tx - the transmitter
+ *	@param rx - the receivers
+ *	@param count - number of receivers, handled two at a time
+ *	@param limit - largest squared angle in range
+ *	@param out - distance to each receiver or -1 if out of range
+ *	@return number of receivers handled
+ */
+static int equirect_sse2(const struct geo_point *tx,
+		const struct geo_points *rx, int count, double limit, int *out)
+{
+	__m128d tlat, tlon, tcl, rad, circle, half, lim, none, radius;
+	__m128d dlat, dlon, d, in, sign;
+	int i;
+
+	tlat = _mm_set1_pd(tx->latitude);
+	tlon = _mm_set1_pd(tx->longitude);
+	tcl = _mm_set1_pd(tx->cos_lat);
+	rad = _mm_set1_pd(M_PI / 180);
+	circle = _mm_set1_pd(360);
+	half = _mm_set1_pd(0.5);
+	lim = _mm_set1_pd(limit);
+	none = _mm_set1_pd(-1);
+	radius = _mm_set1_pd(EARTH_RADIUS);
+	sign = _mm_set1_pd(-0.0);
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		dlat = _mm_sub_pd(_mm_cvtps_pd(_mm_castsi128_ps(
+			_mm_loadl_epi64((const __m128i *)(rx->latitude + i)))),
+			tlat);
+		dlon = _mm_sub_pd(_mm_cvtps_pd(_mm_castsi128_ps(
+			_mm_loadl_epi64((const __m128i *)(rx->longitude + i)))),
+			tlon);
+		/* the short way round across the antimeridian */
+		dlon = _mm_andnot_pd(sign, dlon);
+		dlon = _mm_min_pd(dlon, _mm_sub_pd(circle, dlon));
+
+		dlat = _mm_mul_pd(dlat, rad);
+		dlon = _mm_mul_pd(_mm_mul_pd(dlon, rad), _mm_mul_pd(half,
+			_mm_add_pd(tcl, _mm_loadu_pd(rx->cos_lat + i))));
+
+		d = _mm_add_pd(_mm_mul_pd(dlat, dlat), _mm_mul_pd(dlon, dlon));
+		in = _mm_cmple_pd(d, lim);
+		d = _mm_mul_pd(radius, _mm_sqrt_pd(d));
+
+		d = _mm_or_pd(_mm_and_pd(in, d), _mm_andnot_pd(in, none));
+		_mm_storel_epi64((__m128i *)(out + i), _mm_cvttpd_epi32(d));
+	}
+
+	return i;
+}
+#endif
+
+/**
+ *	@brief Measures from one transmitter to a run of receivers
+ *	@param tx - the transmitter
+ *	@param rx - the receivers, their trig must be current
+ *	@param count - number of receivers
+ *	@param method - DISTANCE_HAVERSINE or DISTANCE_EQUIRECT
+ *	@param range - distance in meters beyond which receivers are skipped
+ *	@param out - distance to each receiver or -1 if out of range
+ *	@return void
+ */
+void distance_batch(const struct geo_point *tx, const struct geo_points *rx,
+		int count, int method, int range, int *out)
+{
+	double limit;
+	int i;
+
+	i = 0;
+
+	if (method == DISTANCE_EQUIRECT) {
+		limit = (double)range / EARTH_RADIUS;
+		limit *= limit;
+#ifdef __SSE2__
+		i = equirect_sse2(tx, rx, count, limit, out);
+#endif
+		for (; i < count; i++)
+			out[i] = equirect_one(tx, rx, i, limit);
+	} else {
+		limit = sin((double)range / (2 * EARTH_RADIUS));
+		limit *= limit;
+#ifdef __SSE2__
+		i = haversine_sse2(tx, rx, count, limit, out);
+#endif
+		for (; i < count; i++)
+			out[i] = haversine_one(tx, rx, i, limit);
+	}
+}
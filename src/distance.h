@@ -0,0 +1,92 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef DISTANCE_H_
+#define DISTANCE_H_
+
+/** Great circle distance from the haversine formula */
+#define DISTANCE_HAVERSINE	0
+/** Equirectangular approximation, cheaper and good over radio range */
+#define DISTANCE_EQUIRECT	1
+
+/** Radius in meters of the sphere get_distance measures on */
+#define EARTH_RADIUS	6370693.5
+
+/**
+ *      \brief A location and the trig of its latitude and longitude
+ */
+struct geo_point {
+	/** latitude in degrees decimal */
+	float latitude;
+	/** longitude in degrees decimal */
+	float longitude;
+	/** sine of the latitude */
+	double sin_lat;
+	/** cosine of the latitude */
+	double cos_lat;
+	/** sine of the longitude */
+	double sin_lon;
+	/** cosine of the longitude */
+	double cos_lon;
+};
+
+/**
+ *      \brief Locations and their trig in parallel arrays
+ *
+ *      The trig only changes when a location does, so it is worked out
+ *      once per movement epoch by geo_points_trig and reused for every
+ *      distance measured from or to that location.
+ */
+struct geo_points {
+	/** latitude of each location in degrees decimal */
+	float *latitude;
+	/** longitude of each location in degrees decimal */
+	float *longitude;
+	/** sine of each latitude */
+	double *sin_lat;
+	/** cosine of each latitude */
+	double *cos_lat;
+	/** sine of each longitude */
+	double *sin_lon;
+	/** cosine of each longitude */
+	double *cos_lon;
+};
+
+double radians_to_degrees(double);
+double degrees_to_radians(double);
+int get_distance(float, float, float, float);
+void geo_point_set(struct geo_point *, float, float);
+void geo_points_trig(struct geo_points *, int, int);
+void distance_batch(const struct geo_point *, const struct geo_points *, int,
+		int, int, int *);
+
+#endif /* DISTANCE_H_ */
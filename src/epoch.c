@@ -0,0 +1,262 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "epoch.h"
+
+/*
+ * Readers announce the epoch they started in, writers tag what they
+ * unpublish with the epoch it was unpublished in and then move the epoch
+ * forward. Anything tagged before the oldest announced epoch can no
+ * longer be reached by a reader and is freed. Writers must be serialized
+ * by the caller, readers never wait. Pins hold back reclaiming the same
+ * way for readers which are not threads.
+ */
+
+/** the current epoch, starts at 1 since 0 means not reading */
+unsigned long global_epoch = 1;
+/** epoch announced by each reading thread */
+struct epoch_reader epoch_readers[EPOCH_READERS];
+/** number of reader slots handed out */
+int epoch_reader_count;
+/** epoch held by each pin */
+struct epoch_reader epoch_pins[EPOCH_PINS];
+/** number of pins handed out */
+int epoch_pin_count;
+/** memory waiting for readers to move on, newest first */
+struct epoch_retired *retired;
+
+/** reader slot of the calling thread */
+static __thread int reader_slot = -1;
+/** nesting depth of read sections in the calling thread */
+static __thread int reader_depth;
+
+/**
+ *	@brief Hands out a reader slot
+ *	@return the slot
+ */
+static int epoch_slot(void)
+{
+	int slot;
+
+	slot = __atomic_fetch_add(&epoch_reader_count, 1, __ATOMIC_SEQ_CST);
+	if (slot >= EPOCH_READERS) {
+		fprintf(stderr, "epoch: more than %d reader threads\n",
+				EPOCH_READERS);
+		abort();
+	}
+
+	return slot;
+}
+
+/**
+ *	@brief Starts a read section in the calling thread
+ *	published data loaded after this call stays valid until epoch_exit
+ *	@return void
+ */
+void epoch_enter(void)
+{
+	unsigned long epoch;
+
+	if (reader_depth++ > 0)
+		return;
+
+	if (reader_slot < 0)
+		reader_slot = epoch_slot();
+
+	epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&epoch_readers[reader_slot].epoch, epoch,
+			__ATOMIC_SEQ_CST);
+}
+
+/**
+ *	@brief Ends a read section in the calling thread
+ *	@return void
+ */
+void epoch_exit(void)
+{
+	if (--reader_depth > 0)
+		return;
+
+	__atomic_store_n(&epoch_readers[reader_slot].epoch, 0,
+			__ATOMIC_RELEASE);
+}
+
+/**
+ *	@brief Hands out a slot which holds back reclaiming for readers which
+ *	are not threads, such as work queued for another thread
+ *	@return the slot
+ */
+int epoch_pin_alloc(void)
+{
+	int slot;
+
+	slot = __atomic_fetch_add(&epoch_pin_count, 1, __ATOMIC_SEQ_CST);
+	if (slot >= EPOCH_PINS) {
+		fprintf(stderr, "epoch: more than %d pins\n", EPOCH_PINS);
+		abort();
+	}
+
+	return slot;
+}
+
+/**
+ *	@brief Holds an epoch in a pin, nothing retired in or after it is
+ *	freed until the pin moves past it
+ *	@param slot - the pin from epoch_pin_alloc
+ *	@param epoch - epoch to hold, 0 to hold none
+ *	@return void
+ */
+void epoch_pin(int slot, unsigned long epoch)
+{
+	__atomic_store_n(&epoch_pins[slot].epoch, epoch, __ATOMIC_SEQ_CST);
+}
+
+/**
+ *	@brief Finds the oldest epoch a read section in progress started in,
+ *	pins are not included
+ *	@return the epoch, the current epoch when nothing older is read
+ */
+unsigned long epoch_readers_oldest(void)
+{
+	unsigned long oldest;
+	unsigned long epoch;
+	int count;
+	int i;
+
+	/* anything retired from now on is newer than every reader */
+	oldest = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+	count = __atomic_load_n(&epoch_reader_count, __ATOMIC_SEQ_CST);
+	if (count > EPOCH_READERS)
+		count = EPOCH_READERS;
+
+	for (i = 0; i < count; i++) {
+		epoch = __atomic_load_n(&epoch_readers[i].epoch,
+				__ATOMIC_SEQ_CST);
+		if ((epoch != 0) && ((long)(epoch - oldest) < 0))
+			oldest = epoch;
+	}
+
+	return oldest;
+}
+
+/**
+ *	@brief Frees memory once no reader can still hold it
+ *	the memory must already be unreachable for new readers
+ *	@param ptr - the memory
+ *	@param release - function which frees the memory
+ *	@return void
+ */
+void epoch_retire(void *ptr, void (*release)(void *))
+{
+	struct epoch_retired *entry;
+
+	if (ptr == NULL)
+		return;
+
+	entry = malloc(sizeof(struct epoch_retired));
+	if (!entry) {
+		/* a reader may still hold it so leaking is the safe choice */
+		perror("epoch: malloc");
+		return;
+	}
+
+	entry->ptr = ptr;
+	entry->release = release;
+	entry->epoch = __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST);
+	entry->next = retired;
+	retired = entry;
+}
+
+/**
+ *	@brief Frees retired memory which readers have moved past
+ *	@return void
+ */
+void epoch_reclaim(void)
+{
+	struct epoch_retired **prev;
+	struct epoch_retired *entry;
+	unsigned long oldest;
+	unsigned long epoch;
+	int count;
+	int i;
+
+	if (retired == NULL)
+		return;
+
+	oldest = epoch_readers_oldest();
+
+	count = __atomic_load_n(&epoch_pin_count, __ATOMIC_SEQ_CST);
+	if (count > EPOCH_PINS)
+		count = EPOCH_PINS;
+
+	for (i = 0; i < count; i++) {
+		epoch = __atomic_load_n(&epoch_pins[i].epoch,
+				__ATOMIC_SEQ_CST);
+		if ((epoch != 0) && ((long)(epoch - oldest) < 0))
+			oldest = epoch;
+	}
+
+	prev = &retired;
+	while ((entry = *prev) != NULL) {
+		if ((long)(entry->epoch - oldest) < 0) {
+			*prev = entry->next;
+			entry->release(entry->ptr);
+			free(entry);
+		} else {
+			prev = &entry->next;
+		}
+	}
+}
+
+/**
+ *	@brief Frees all retired memory, readers must have stopped
+ *	@return void
+ */
+void epoch_free(void)
+{
+	struct epoch_retired *entry;
+
+	while ((entry = retired) != NULL) {
+		retired = entry->next;
+		entry->release(entry->ptr);
+		free(entry);
+	}
+}
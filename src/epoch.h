@@ -0,0 +1,77 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+/** Maximum number of threads which may read published data */
+#define EPOCH_READERS	64
+/** Maximum number of pins */
+#define EPOCH_PINS	32
+
+/**
+ *      \brief Epoch announced by a reading thread
+ *
+ *      Each slot is padded out to its own cache line so readers entering
+ *      and leaving do not disturb one another.
+ */
+struct epoch_reader {
+	/** epoch seen when the read started, 0 when not reading */
+	unsigned long epoch;
+	/** padding to a cache line */
+	char pad[64 - sizeof(unsigned long)];
+};
+
+/**
+ *      \brief Memory which was unpublished but may still be read
+ */
+struct epoch_retired {
+	/** the memory */
+	void *ptr;
+	/** function which frees the memory */
+	void (*release)(void *);
+	/** epoch at which the memory was unpublished */
+	unsigned long epoch;
+	/** next retired entry */
+	struct epoch_retired *next;
+};
+
+void epoch_enter(void);
+void epoch_exit(void);
+int epoch_pin_alloc(void);
+void epoch_pin(int, unsigned long);
+unsigned long epoch_readers_oldest(void);
+void epoch_retire(void *, void (*)(void *));
+void epoch_reclaim(void);
+void epoch_free(void);
+
+#endif /* EPOCH_H_ */
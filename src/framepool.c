@@ -0,0 +1,286 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "framepool.h"
+
+/** number of cache slots handed out to threads */
+int frame_cache_count;
+
+/** cache slot of the calling thread, shared by every pool */
+static __thread int cache_slot = -1;
+
+/**
+ *	@brief Finds the cache of the calling thread
+ *	@param pool - the pool
+ *	@return the cache, NULL if there are more threads than caches
+ */
+static struct frame_cache *frame_cache(struct frame_pool *pool)
+{
+	if (cache_slot < 0)
+		cache_slot = __atomic_fetch_add(&frame_cache_count, 1,
+				__ATOMIC_RELAXED);
+
+	if (cache_slot >= FRAME_CACHES)
+		return NULL;
+
+	return &pool->caches[cache_slot];
+}
+
+/**
+ *	@brief Finds the header of a buffer
+ *	@param buf - the buffer
+ *	@return the header
+ */
+static struct frame_hdr *frame_header(void *buf)
+{
+	return (struct frame_hdr *)buf - 1;
+}
+
+/**
+ *	@brief Counts a buffer handed out and keeps the high water mark
+ *	@param pool - the pool
+ *	@return void
+ */
+static void frame_count_get(struct frame_pool *pool)
+{
+	unsigned int in_use;
+	unsigned int high;
+
+	in_use = __atomic_add_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+	high = __atomic_load_n(&pool->high_water, __ATOMIC_RELAXED);
+	while ((in_use > high) && !__atomic_compare_exchange_n(
+			&pool->high_water, &high, in_use, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/**
+ *	@brief Allocates every buffer of a pool
+ *	@param pool - the pool
+ *	@param count - number of buffers
+ *	@param size - usable bytes of each buffer
+ *	@return 0 on success, -1 on failure
+ */
+int frame_pool_init(struct frame_pool *pool, unsigned int count,
+		unsigned int size)
+{
+	struct frame_hdr *hdr;
+	unsigned int i;
+	char *first;
+
+	memset(pool, 0, sizeof(struct frame_pool));
+
+	/* keep every header, and so every buffer, on a cache line */
+	pool->stride = (sizeof(struct frame_hdr) + size + 63) & ~63U;
+	pool->size = size;
+	pool->count = count;
+
+	pool->base = malloc((size_t)count * pool->stride + 63);
+	if (!pool->base) {
+		perror("framepool: malloc");
+		return -1;
+	}
+
+	first = (char *)(((uintptr_t)pool->base + 63) & ~(uintptr_t)63);
+	for (i = count; i > 0; i--) {
+		hdr = (struct frame_hdr *)(first + (size_t)(i - 1) * pool->stride);
+		hdr->refs = 0;
+		hdr->next = pool->free;
+		pool->free = hdr;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+
+	return 0;
+}
+
+/**
+ *	@brief Moves up to FRAME_CACHE_BATCH buffers from the shared list to
+ *	a thread cache
+ *	@param pool - the pool
+ *	@param cache - the cache
+ *	@return void
+ */
+static void frame_cache_fill(struct frame_pool *pool, struct frame_cache *cache)
+{
+	struct frame_hdr *hdr;
+
+	pthread_mutex_lock(&pool->lock);
+	while ((pool->free != NULL) && (cache->count < FRAME_CACHE_BATCH)) {
+		hdr = pool->free;
+		pool->free = hdr->next;
+		hdr->next = cache->head;
+		cache->head = hdr;
+		cache->count++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ *	@brief Moves FRAME_CACHE_BATCH buffers from a thread cache back to the
+ *	shared list
+ *	@param pool - the pool
+ *	@param cache - the cache
+ *	@return void
+ */
+static void frame_cache_drain(struct frame_pool *pool,
+		struct frame_cache *cache)
+{
+	struct frame_hdr *hdr;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; (i < FRAME_CACHE_BATCH) && (cache->head != NULL); i++) {
+		hdr = cache->head;
+		cache->head = hdr->next;
+		cache->count--;
+		hdr->next = pool->free;
+		pool->free = hdr;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ *	@brief Takes a free buffer holding one reference
+ *	@param pool - the pool
+ *	@return the buffer, NULL if every buffer is in use
+ */
+void *frame_get(struct frame_pool *pool)
+{
+	struct frame_cache *cache;
+	struct frame_hdr *hdr;
+
+	cache = frame_cache(pool);
+	if (cache == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		hdr = pool->free;
+		if (hdr != NULL)
+			pool->free = hdr->next;
+		pthread_mutex_unlock(&pool->lock);
+	} else {
+		if (cache->head == NULL)
+			frame_cache_fill(pool, cache);
+		hdr = cache->head;
+		if (hdr != NULL) {
+			cache->head = hdr->next;
+			cache->count--;
+		}
+	}
+
+	if (hdr == NULL) {
+		__atomic_fetch_add(&pool->exhausted, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	hdr->next = NULL;
+	__atomic_store_n(&hdr->refs, 1, __ATOMIC_RELAXED);
+	frame_count_get(pool);
+
+	return hdr + 1;
+}
+
+/**
+ *	@brief Takes another reference to a buffer
+ *	@param buf - a buffer the caller holds a reference to
+ *	@return void
+ */
+void frame_hold(void *buf)
+{
+	__atomic_fetch_add(&frame_header(buf)->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ *	@brief Counts the references to a buffer
+ *	a count of 1 read by the only holder stays 1, larger counts may
+ *	drop at any time
+ *	@param buf - a buffer the caller holds a reference to
+ *	@return the count
+ */
+int frame_refs(void *buf)
+{
+	return __atomic_load_n(&frame_header(buf)->refs, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *	@brief Drops a reference to a buffer, freeing it with the last one
+ *	@param pool - the pool the buffer came from
+ *	@param buf - the buffer
+ *	@return void
+ */
+void frame_put(struct frame_pool *pool, void *buf)
+{
+	struct frame_cache *cache;
+	struct frame_hdr *hdr;
+
+	hdr = frame_header(buf);
+	if (__atomic_sub_fetch(&hdr->refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+
+	__atomic_fetch_sub(&pool->in_use, 1, __ATOMIC_RELAXED);
+
+	cache = frame_cache(pool);
+	if (cache == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		hdr->next = pool->free;
+		pool->free = hdr;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+
+	hdr->next = cache->head;
+	cache->head = hdr;
+	cache->count++;
+
+	/* threads which only free, like relay workers, give buffers back */
+	if (cache->count >= FRAME_CACHE_MAX)
+		frame_cache_drain(pool, cache);
+}
+
+/**
+ *	@brief Frees every buffer, none may still be in use
+ *	@param pool - the pool
+ *	@return void
+ */
+void frame_pool_free(struct frame_pool *pool)
+{
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->base);
+	pool->base = NULL;
+	pool->free = NULL;
+	memset(pool->caches, 0, sizeof(pool->caches));
+}
@@ -0,0 +1,108 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef FRAMEPOOL_H_
+#define FRAMEPOOL_H_
+
+#include <pthread.h>
+
+/** Most threads with their own cache of free buffers */
+#define FRAME_CACHES		64
+/** Buffers moved between a thread cache and the shared list at once */
+#define FRAME_CACHE_BATCH	16
+/** Free buffers a thread cache can hold, pools are sized to allow for it */
+#define FRAME_CACHE_MAX		(2 * FRAME_CACHE_BATCH)
+
+/**
+ *      \brief Header in front of every buffer of a pool
+ */
+struct frame_hdr {
+	/** next free buffer */
+	struct frame_hdr *next;
+	/** references held, 0 while free */
+	int refs;
+	/** padding so the buffer after the header is aligned */
+	char pad[64 - sizeof(struct frame_hdr *) - sizeof(int)];
+};
+
+/**
+ *      \brief Free buffers kept by one thread
+ */
+struct frame_cache {
+	/** first free buffer */
+	struct frame_hdr *head;
+	/** number of free buffers */
+	int count;
+	/** padding to a cache line */
+	char pad[64 - sizeof(struct frame_hdr *) - sizeof(int)];
+};
+
+/**
+ *      \brief Preallocated fixed size buffers with reference counts
+ *
+ *      Every buffer is allocated up front. A buffer goes back to the pool
+ *      when its last reference is dropped, by whichever thread held it.
+ *      Each thread keeps a few free buffers of its own and only takes the
+ *      lock to move FRAME_CACHE_BATCH of them to or from the shared list.
+ *      Buffers cached by a thread which exits stay with that thread.
+ */
+struct frame_pool {
+	/** memory of all buffers and their headers */
+	char *base;
+	/** usable bytes of each buffer */
+	unsigned int size;
+	/** distance from one header to the next */
+	unsigned int stride;
+	/** number of buffers */
+	unsigned int count;
+	/** protects the shared list */
+	pthread_mutex_t lock;
+	/** free buffers not in any thread cache */
+	struct frame_hdr *free;
+	/** cache of each thread, by the thread's cache slot */
+	struct frame_cache caches[FRAME_CACHES];
+	/** buffers handed out and not yet returned */
+	unsigned int in_use;
+	/** most buffers in use at once */
+	unsigned int high_water;
+	/** requests which found every buffer in use */
+	unsigned long exhausted;
+};
+
+int frame_pool_init(struct frame_pool *, unsigned int, unsigned int);
+void *frame_get(struct frame_pool *);
+void frame_hold(void *);
+int frame_refs(void *);
+void frame_put(struct frame_pool *, void *);
+void frame_pool_free(struct frame_pool *);
+
+#endif /* FRAMEPOOL_H_ */
@@ -0,0 +1,167 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpsc.h"
+
+/*
+ * Every slot carries the position it is next valid for. A producer may
+ * fill a slot once its seq equals the claimed position and publishes it
+ * by moving seq one past. The consumer may empty it once seq is one past
+ * its position and frees it for the next lap by moving seq a full lap
+ * on. Positions only grow, so wrapping of the counters is harmless.
+ */
+
+/**
+ *	@brief Sets up an empty ring
+ *	@param ring - the ring
+ *	@param size - number of slots, a power of two
+ *	@return 0 on success, -1 on failure
+ */
+int mpsc_init(struct mpsc_ring *ring, unsigned long size)
+{
+	unsigned long i;
+
+	memset(ring, 0, sizeof(struct mpsc_ring));
+
+	ring->slots = malloc(size * sizeof(struct mpsc_slot));
+	if (!ring->slots) {
+		perror("mpsc: malloc");
+		return -1;
+	}
+
+	for (i = 0; i < size; i++) {
+		ring->slots[i].seq = i;
+		ring->slots[i].ptr = NULL;
+	}
+	ring->mask = size - 1;
+
+	return 0;
+}
+
+/**
+ *	@brief Adds a pointer, safe to call from any number of threads
+ *	@param ring - the ring
+ *	@param ptr - the pointer
+ *	@return 0 on success, -1 if the ring is full
+ */
+int mpsc_push(struct mpsc_ring *ring, void *ptr)
+{
+	struct mpsc_slot *slot;
+	unsigned long pos;
+	unsigned long seq;
+	long dif;
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &ring->slots[pos & ring->mask];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		dif = (long)(seq - pos);
+
+		if (dif == 0) {
+			/* free for this lap, claim it unless someone did */
+			if (__atomic_compare_exchange_n(&ring->head, &pos,
+					pos + 1, 1, __ATOMIC_SEQ_CST,
+					__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			/* still holds the previous lap */
+			__atomic_fetch_add(&ring->full, 1, __ATOMIC_RELAXED);
+			return -1;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->ptr = ptr;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ *	@brief Takes the oldest pointer, only one thread may pop
+ *	@param ring - the ring
+ *	@return the pointer, NULL if the ring is empty or the oldest push
+ *	has not finished
+ */
+void *mpsc_pop(struct mpsc_ring *ring)
+{
+	struct mpsc_slot *slot;
+	unsigned long pos;
+	void *ptr;
+
+	pos = ring->tail;
+	slot = &ring->slots[pos & ring->mask];
+	if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+		return NULL;
+
+	ptr = slot->ptr;
+	__atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+	return ptr;
+}
+
+/**
+ *	@brief Counts the positions claimed by producers so far
+ *	@param ring - the ring
+ *	@return number of successful pushes, including any still filling in
+ */
+unsigned long mpsc_claimed(struct mpsc_ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+}
+
+/**
+ *	@brief Counts the pushes refused because the ring was full
+ *	@param ring - the ring
+ *	@return the count
+ */
+unsigned long mpsc_full(struct mpsc_ring *ring)
+{
+	return __atomic_load_n(&ring->full, __ATOMIC_RELAXED);
+}
+
+/**
+ *	@brief Frees the slots, pointers still held are not freed
+ *	@param ring - the ring
+ *	@return void
+ */
+void mpsc_free(struct mpsc_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
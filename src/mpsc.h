@@ -0,0 +1,83 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef MPSC_H_
+#define MPSC_H_
+
+/** Size the indices of a ring are padded out to */
+#define MPSC_CACHE_LINE	64
+
+/**
+ *      \brief A slot of a ring
+ */
+struct mpsc_slot {
+	/** position the slot may next be pushed at or popped from */
+	unsigned long seq;
+	/** the pointer held */
+	void *ptr;
+};
+
+/**
+ *      \brief Bounded ring of pointers, many threads push, one pops
+ *
+ *      Producers claim a position with one compare and swap and never
+ *      wait for each other or for the consumer, a push to a full ring
+ *      fails and is counted. Each index sits on its own cache line so
+ *      producers and the consumer do not share one.
+ */
+struct mpsc_ring {
+	/** slots, a power of two */
+	struct mpsc_slot *slots;
+	/** number of slots less one */
+	unsigned long mask;
+	/** padding to a cache line */
+	char pad0[MPSC_CACHE_LINE - sizeof(void *) - sizeof(unsigned long)];
+	/** next position claimed by a producer */
+	unsigned long head;
+	/** padding to a cache line */
+	char pad1[MPSC_CACHE_LINE - sizeof(unsigned long)];
+	/** next position taken by the consumer */
+	unsigned long tail;
+	/** padding to a cache line */
+	char pad2[MPSC_CACHE_LINE - sizeof(unsigned long)];
+	/** pushes which found the ring full */
+	unsigned long full;
+};
+
+int mpsc_init(struct mpsc_ring *, unsigned long);
+int mpsc_push(struct mpsc_ring *, void *);
+void *mpsc_pop(struct mpsc_ring *);
+unsigned long mpsc_claimed(struct mpsc_ring *);
+unsigned long mpsc_full(struct mpsc_ring *);
+void mpsc_free(struct mpsc_ring *);
+
+#endif /* MPSC_H_ */
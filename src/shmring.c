@@ -0,0 +1,437 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include "shmring.h"
+
+#ifdef SHM_SUPPORTED
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+/** Space taken in the ring by a record */
+#define SHM_RECORD(len)	((sizeof(uint32_t) + (len) + 7) & ~7u)
+
+/** Payload of the message which hands a channel over */
+#define SHM_OFFER	"SHM"
+
+/* older C libraries lack the sealing constants */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC		0x0001u
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING	0x0002u
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS		1033
+#define F_GET_SEALS		1034
+#define F_SEAL_SEAL		0x0001
+#define F_SEAL_SHRINK		0x0002
+#define F_SEAL_GROW		0x0004
+#endif
+
+/**
+ *	@brief Adds a record, only one thread at a time may push
+ *	@param ring - the ring
+ *	@param buf - first part of the record
+ *	@param len - size of buf
+ *	@param extra - second part of the record, may be NULL
+ *	@param extra_len - size of extra
+ *	@return 1 if the consumer must be signalled, 0 if not, -1 if full
+ */
+int shm_ring_push(struct shm_ring *ring, const char *buf, uint32_t len,
+		const char *extra, uint32_t extra_len)
+{
+	uint32_t total;
+	uint32_t need;
+	uint32_t tail;
+	uint32_t head;
+	uint32_t pos;
+	uint32_t gap;
+
+	total = len + ((extra != NULL) ? extra_len : 0);
+	need = SHM_RECORD(total);
+	tail = ring->tail;
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	/* a record which would run past the end goes at the start */
+	pos = tail & (SHM_RING_SIZE - 1);
+	gap = 0;
+	if (SHM_RING_SIZE - pos < need)
+		gap = SHM_RING_SIZE - pos;
+
+	if (SHM_RING_SIZE - (tail - head) < gap + need) {
+		__atomic_add_fetch(&ring->full, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+
+	if (gap) {
+		*(uint32_t *)(ring->data + pos) = SHM_RING_WRAP;
+		tail += gap;
+		pos = 0;
+	}
+
+	*(uint32_t *)(ring->data + pos) = total;
+	memcpy(ring->data + pos + sizeof(uint32_t), buf, len);
+	if (extra != NULL)
+		memcpy(ring->data + pos + sizeof(uint32_t) + len, extra,
+				extra_len);
+
+	__atomic_store_n(&ring->tail, tail + need, __ATOMIC_RELEASE);
+
+	/* pairs with the fence in shm_ring_sleep */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED) &&
+			__atomic_exchange_n(&ring->waiting, 0, __ATOMIC_RELAXED))
+		return 1;
+
+	return 0;
+}
+
+/**
+ *	@brief Finds the oldest record, only one thread at a time may take
+ *	records, the producer is not trusted
+ *	@param ring - the ring
+ *	@param buf - set to the record, valid until it is popped
+ *	@return size of the record, -1 if the ring is empty or -2 if the
+ *	ring does not hold valid records
+ */
+int shm_ring_peek(struct shm_ring *ring, char **buf)
+{
+	uint32_t head;
+	uint32_t tail;
+	uint32_t pos;
+	uint32_t len;
+
+	head = ring->head;
+	for (;;) {
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (head == tail)
+			return -1;
+		if ((tail - head > SHM_RING_SIZE) || (head & 7))
+			return -2;
+
+		pos = head & (SHM_RING_SIZE - 1);
+		len = *(volatile uint32_t *)(ring->data + pos);
+		if (len != SHM_RING_WRAP)
+			break;
+
+		head += SHM_RING_SIZE - pos;
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	}
+
+	if ((len > SHM_RING_SIZE - pos - sizeof(uint32_t)) ||
+			(SHM_RECORD(len) > tail - head))
+		return -2;
+
+	*buf = ring->data + pos + sizeof(uint32_t);
+
+	return len;
+}
+
+/**
+ *	@brief Gives the space of the oldest record back to the producer
+ *	@param ring - the ring
+ *	@param len - size returned by shm_ring_peek
+ *	@return void
+ */
+void shm_ring_pop(struct shm_ring *ring, uint32_t len)
+{
+	__atomic_store_n(&ring->head, ring->head + SHM_RECORD(len),
+			__ATOMIC_RELEASE);
+}
+
+/**
+ *	@brief Tells the producer the consumer is about to sleep
+ *	@param ring - the ring
+ *	@return 1 if records arrived meanwhile and it must not sleep, 0 if not
+ */
+int shm_ring_sleep(struct shm_ring *ring)
+{
+	__atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+	/* pairs with the fence in shm_ring_push */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head;
+}
+
+/**
+ *	@brief Wakes the consumer sleeping on an eventfd
+ *	@param fd - the eventfd
+ *	@return void
+ */
+void shm_signal(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0)
+		return;
+}
+
+/**
+ *	@brief Resets an eventfd after waking on it
+ *	@param fd - the eventfd
+ *	@return void
+ */
+void shm_clear(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) < 0)
+		return;
+}
+
+/**
+ *	@brief Creates the memory and eventfds of a channel
+ *	@param ch - the channel
+ *	@return 0 on success, -1 on failure
+ */
+int shm_channel_create(struct shm_channel *ch)
+{
+	ch->map = NULL;
+	ch->up_event = -1;
+	ch->down_event = -1;
+
+	/* older C libraries have no wrapper */
+	ch->fd = syscall(SYS_memfd_create, "welled",
+			MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (ch->fd < 0)
+		return -1;
+
+	/* sealed so wmasterd cannot be made to fault on a shrunken map */
+	if ((ftruncate(ch->fd, sizeof(struct shm_layout)) < 0) ||
+			(fcntl(ch->fd, F_ADD_SEALS,
+			F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0))
+		goto fail;
+
+	ch->map = mmap(NULL, sizeof(struct shm_layout),
+			PROT_READ | PROT_WRITE, MAP_SHARED, ch->fd, 0);
+	if (ch->map == MAP_FAILED) {
+		ch->map = NULL;
+		goto fail;
+	}
+	ch->map->magic = SHM_MAGIC;
+	ch->map->size = sizeof(struct shm_layout);
+
+	ch->up_event = eventfd(0, EFD_NONBLOCK);
+	ch->down_event = eventfd(0, EFD_NONBLOCK);
+	if ((ch->up_event < 0) || (ch->down_event < 0))
+		goto fail;
+
+	return 0;
+fail:
+	shm_channel_free(ch);
+	return -1;
+}
+
+/**
+ *	@brief Hands a channel to wmasterd
+ *	@param sock - a socket bound to the address of this node
+ *	@param addr - where wmasterd accepts channels
+ *	@param len - length of addr
+ *	@param ch - the channel
+ *	@return 0 on success, -1 on failure
+ */
+int shm_channel_offer(int sock, struct sockaddr *addr, socklen_t len,
+		struct shm_channel *ch)
+{
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	int fds[3];
+
+	iov.iov_base = SHM_OFFER;
+	iov.iov_len = sizeof(SHM_OFFER);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = addr;
+	msg.msg_namelen = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	fds[0] = ch->fd;
+	fds[1] = ch->up_event;
+	fds[2] = ch->down_event;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	return (sendmsg(sock, &msg, 0) < 0) ? -1 : 0;
+}
+
+/**
+ *	@brief Closes every descriptor passed in an SCM_RIGHTS message
+ *	@param cmsg - the control message
+ *	@return void
+ */
+static void shm_close_rights(struct cmsghdr *cmsg)
+{
+	size_t count;
+	size_t i;
+	int fd;
+
+	count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	for (i = 0; i < count; i++) {
+		memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+		close(fd);
+	}
+}
+
+/**
+ *	@brief Takes a channel offered by welled and maps it
+ *	@param sock - the socket channels are offered on
+ *	@param ch - set to the channel
+ *	@param addr - set to the address of the welled which offered it
+ *	@param len - size of addr, set to its length
+ *	@return 0 on success, -1 if nothing valid was offered
+ */
+int shm_channel_accept(int sock, struct shm_channel *ch, struct sockaddr *addr,
+		socklen_t *len)
+{
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	struct stat st;
+	char buf[sizeof(SHM_OFFER)];
+	int fds[3];
+	int got;
+	int extra;
+	int seals;
+	ssize_t ret;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = addr;
+	msg.msg_namelen = *len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	ret = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (ret < 0)
+		return -1;
+	*len = msg.msg_namelen;
+
+	/* whatever is not kept is closed so a bad offer cannot leak fds */
+	got = 0;
+	extra = 0;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+			cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if ((cmsg->cmsg_level != SOL_SOCKET) ||
+				(cmsg->cmsg_type != SCM_RIGHTS))
+			continue;
+		if (!got && (cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))) {
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+			got = 1;
+		} else {
+			shm_close_rights(cmsg);
+			extra = 1;
+		}
+	}
+	if (!got)
+		return -1;
+
+	ch->map = NULL;
+	ch->fd = fds[0];
+	ch->up_event = fds[1];
+	ch->down_event = fds[2];
+
+	/* the sender is not trusted, the memory must be what it claims */
+	if (extra || (ret != sizeof(SHM_OFFER)) ||
+			(memcmp(buf, SHM_OFFER, sizeof(SHM_OFFER)) != 0) ||
+			(msg.msg_flags & MSG_CTRUNC) ||
+			(fstat(ch->fd, &st) < 0) ||
+			(st.st_size != sizeof(struct shm_layout)))
+		goto fail;
+
+	/* memory that can be shrunk under the map would fault on access */
+	seals = fcntl(ch->fd, F_GET_SEALS);
+	if ((seals < 0) || !(seals & F_SEAL_SHRINK))
+		goto fail;
+
+	ch->map = mmap(NULL, sizeof(struct shm_layout),
+			PROT_READ | PROT_WRITE, MAP_SHARED, ch->fd, 0);
+	if (ch->map == MAP_FAILED) {
+		ch->map = NULL;
+		goto fail;
+	}
+	if ((ch->map->magic != SHM_MAGIC) ||
+			(ch->map->size != sizeof(struct shm_layout)))
+		goto fail;
+
+	return 0;
+fail:
+	shm_channel_free(ch);
+	return -1;
+}
+
+/**
+ *	@brief Unmaps a channel and closes its descriptors
+ *	@param ch - the channel
+ *	@return void
+ */
+void shm_channel_free(struct shm_channel *ch)
+{
+	if (ch->map != NULL)
+		munmap(ch->map, sizeof(struct shm_layout));
+	if (ch->fd >= 0)
+		close(ch->fd);
+	if (ch->up_event >= 0)
+		close(ch->up_event);
+	if (ch->down_event >= 0)
+		close(ch->down_event);
+
+	ch->map = NULL;
+	ch->fd = -1;
+	ch->up_event = -1;
+	ch->down_event = -1;
+}
+
+#endif /* SHM_SUPPORTED */
@@ -0,0 +1,141 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef SHMRING_H_
+#define SHMRING_H_
+
+#include <stdint.h>
+
+/* the libc of ESXi predates eventfd */
+#if defined(__linux__) && !defined(_ESX)
+#include <sys/syscall.h>
+#ifdef SYS_memfd_create
+/** memfd and eventfd are available for shared memory channels */
+#define SHM_SUPPORTED
+#endif
+#endif
+
+#ifdef SHM_SUPPORTED
+
+#include <sys/socket.h>
+
+/** Bytes of records each direction of a channel holds, a power of two */
+#define SHM_RING_SIZE	65536
+/** Length marking the rest of the ring unused, records go on at 0 */
+#define SHM_RING_WRAP	0xffffffffu
+/** First word of a channel mapping */
+#define SHM_MAGIC	0x57454c4cu
+/** Size the indices of a ring are padded out to */
+#define SHM_CACHE_LINE	64
+
+/**
+ *      \brief Ring of variable sized records with one producer and one
+ *      consumer, possibly in different processes
+ *
+ *      Each record is its length followed by its bytes, padded to 8
+ *      bytes. A record which would not fit before the end of the ring
+ *      is put at the start, after a wrap marker. The indices count bytes
+ *      and are only masked when used, so head equals tail when empty.
+ *      A consumer which has run dry sets waiting before it sleeps, and
+ *      the producer only signals it when waiting is set.
+ */
+struct shm_ring {
+	/** bytes pushed, only moved by the producer */
+	uint32_t tail;
+	/** padding to a cache line */
+	char pad0[SHM_CACHE_LINE - sizeof(uint32_t)];
+	/** bytes popped, only moved by the consumer */
+	uint32_t head;
+	/** padding to a cache line */
+	char pad1[SHM_CACHE_LINE - sizeof(uint32_t)];
+	/** set by the consumer before it sleeps */
+	uint32_t waiting;
+	/** pushes which found the ring full */
+	uint32_t full;
+	/** padding to a cache line */
+	char pad2[SHM_CACHE_LINE - 2 * sizeof(uint32_t)];
+	/** the records */
+	char data[SHM_RING_SIZE];
+};
+
+/**
+ *      \brief Contents of the memory shared by welled and wmasterd
+ */
+struct shm_layout {
+	/** SHM_MAGIC */
+	uint32_t magic;
+	/** size of this structure */
+	uint32_t size;
+	/** set by wmasterd once it reads up and writes down */
+	uint32_t attached;
+	/** padding to a cache line */
+	char pad[SHM_CACHE_LINE - 3 * sizeof(uint32_t)];
+	/** records from welled to wmasterd */
+	struct shm_ring up;
+	/** records from wmasterd to welled */
+	struct shm_ring down;
+};
+
+/**
+ *      \brief A welled's end of a shared memory channel, or wmasterd's
+ *
+ *      welled creates the memory and both eventfds and hands them to
+ *      wmasterd over an AF_UNIX socket.
+ */
+struct shm_channel {
+	/** the shared memory */
+	struct shm_layout *map;
+	/** memfd holding the memory */
+	int fd;
+	/** signalled when up is pushed to while wmasterd waits */
+	int up_event;
+	/** signalled when down is pushed to while welled waits */
+	int down_event;
+};
+
+int shm_ring_push(struct shm_ring *, const char *, uint32_t, const char *,
+		uint32_t);
+int shm_ring_peek(struct shm_ring *, char **);
+void shm_ring_pop(struct shm_ring *, uint32_t);
+int shm_ring_sleep(struct shm_ring *);
+void shm_signal(int);
+void shm_clear(int);
+int shm_channel_create(struct shm_channel *);
+int shm_channel_offer(int, struct sockaddr *, socklen_t,
+		struct shm_channel *);
+int shm_channel_accept(int, struct shm_channel *, struct sockaddr *,
+		socklen_t *);
+void shm_channel_free(struct shm_channel *);
+
+#endif /* SHM_SUPPORTED */
+
+#endif /* SHMRING_H_ */
@@ -0,0 +1,258 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "symtab.h"
+#include "epoch.h"
+
+/** the global symbol table */
+struct symtab symbols;
+
+/**
+ *	@brief FNV-1a hash of a string
+ *	@param str - string to hash
+ *	@param len - length of the string
+ *	@return hash value
+ */
+static unsigned int sym_hash(const char *str, size_t len)
+{
+	unsigned int hash;
+	size_t i;
+
+	hash = 2166136261u;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/**
+ *	@brief Finds the slot holding a string or the empty slot where it belongs
+ *	@param slots - hash slots to search
+ *	@param size - number of hash slots
+ *	@param str - string to find
+ *	@param len - length of the string
+ *	@return slot position
+ */
+static unsigned int sym_find_slot(int *slots, unsigned int size,
+		const char *str, size_t len)
+{
+	unsigned int mask;
+	unsigned int pos;
+	char **names;
+	int id;
+
+	mask = size - 1;
+	pos = sym_hash(str, len) & mask;
+
+	while ((id = __atomic_load_n(&slots[pos], __ATOMIC_ACQUIRE)) >= 0) {
+		/* an id is only stored once the names array holds it */
+		names = __atomic_load_n(&symbols.names, __ATOMIC_ACQUIRE);
+		if ((strncmp(names[id], str, len) == 0) &&
+				(names[id][len] == '\0'))
+			break;
+		pos = (pos + 1) & mask;
+	}
+
+	return pos;
+}
+
+/**
+ *	@brief Doubles the number of hash slots and rehashes every id
+ *	@return 0 on success, -1 on failure
+ */
+static int sym_grow(void)
+{
+	unsigned int size;
+	unsigned int i;
+	int *slots;
+	int *old;
+
+	size = symbols.size ? symbols.size * 2 : SYMTAB_MIN;
+	slots = malloc(size * sizeof(int));
+	if (!slots) {
+		perror("wmasterd: malloc");
+		return -1;
+	}
+	memset(slots, -1, size * sizeof(int));
+
+	for (i = 0; i < symbols.count; i++) {
+		slots[sym_find_slot(slots, size, symbols.names[i],
+				strlen(symbols.names[i]))] = i;
+	}
+
+	/*
+	 * readers load the size before the slots, so they never probe past
+	 * the end of the slots they see
+	 */
+	old = symbols.slots;
+	__atomic_store_n(&symbols.slots, slots, __ATOMIC_RELEASE);
+	__atomic_store_n(&symbols.size, size, __ATOMIC_RELEASE);
+	epoch_retire(old, free);
+
+	return 0;
+}
+
+/**
+ *	@brief Returns the id of a string, adding it to the table if needed
+ *	callers must be serialized, readers may run at the same time
+ *	@param str - string to intern, need not be null terminated
+ *	@param maxlen - maximum number of characters of str to use
+ *	@return symbol id or -1 on failure
+ */
+int sym_intern(const char *str, size_t maxlen)
+{
+	unsigned int names_size;
+	unsigned int pos;
+	char **names;
+	char **old;
+	size_t len;
+	char *name;
+
+	/* the empty string is always id 0 */
+	if ((symbols.count == 0) && (str[0] != '\0')) {
+		if (sym_intern("", 1) < 0)
+			return -1;
+	}
+
+	/* keep the table at most half full */
+	if ((symbols.count + 1) * 2 > symbols.size) {
+		if (sym_grow() < 0)
+			return -1;
+	}
+
+	len = strnlen(str, maxlen);
+	pos = sym_find_slot(symbols.slots, symbols.size, str, len);
+	if (symbols.slots[pos] >= 0)
+		return symbols.slots[pos];
+
+	if (symbols.count == symbols.names_size) {
+		names_size = symbols.names_size ?
+			symbols.names_size * 2 : SYMTAB_MIN;
+		names = malloc(names_size * sizeof(char *));
+		if (!names) {
+			perror("wmasterd: malloc");
+			return -1;
+		}
+		if (symbols.count)
+			memcpy(names, symbols.names,
+				symbols.count * sizeof(char *));
+		old = symbols.names;
+		__atomic_store_n(&symbols.names, names, __ATOMIC_RELEASE);
+		symbols.names_size = names_size;
+		epoch_retire(old, free);
+	}
+
+	name = malloc(len + 1);
+	if (!name) {
+		perror("wmasterd: malloc");
+		return -1;
+	}
+	memcpy(name, str, len);
+	name[len] = '\0';
+
+	/* publish the name before anything which refers to its id */
+	symbols.names[symbols.count] = name;
+	__atomic_store_n(&symbols.count, symbols.count + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&symbols.slots[pos], symbols.count - 1,
+			__ATOMIC_RELEASE);
+
+	return symbols.count - 1;
+}
+
+/**
+ *	@brief Returns the id of a string without adding it to the table
+ *	safe to call alongside sym_intern from a read section, a string
+ *	interned while the slots grow may be missed
+ *	@param str - string to find, need not be null terminated
+ *	@param maxlen - maximum number of characters of str to use
+ *	@return symbol id or -1 if the string has not been interned
+ */
+int sym_lookup(const char *str, size_t maxlen)
+{
+	unsigned int size;
+	int *slots;
+
+	size = __atomic_load_n(&symbols.size, __ATOMIC_ACQUIRE);
+	if (size == 0)
+		return (str[0] == '\0') ? SYM_NONE : -1;
+	slots = __atomic_load_n(&symbols.slots, __ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&slots[sym_find_slot(slots, size, str,
+			strnlen(str, maxlen))], __ATOMIC_ACQUIRE);
+}
+
+/**
+ *	@brief Returns the string for a symbol id
+ *	safe to call alongside sym_intern from a read section
+ *	@param id - symbol id
+ *	@return the string, or an empty string for an unknown id
+ */
+const char *sym_name(int id)
+{
+	char **names;
+
+	if ((id < 0) || ((unsigned int)id >=
+			__atomic_load_n(&symbols.count, __ATOMIC_ACQUIRE)))
+		return "";
+
+	names = __atomic_load_n(&symbols.names, __ATOMIC_ACQUIRE);
+
+	return names[id];
+}
+
+/**
+ *	@brief Frees every interned string and the table itself
+ *	@return void
+ */
+void sym_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < symbols.count; i++)
+		free(symbols.names[i]);
+
+	free(symbols.names);
+	free(symbols.slots);
+	memset(&symbols, 0, sizeof(struct symtab));
+}
@@ -0,0 +1,72 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef SYMTAB_H_
+#define SYMTAB_H_
+
+#include <stddef.h>
+
+/** Symbol id of the empty string, used for unset names and rooms */
+#define SYM_NONE	0
+/** Initial number of hash slots in the symbol table */
+#define SYMTAB_MIN	256
+
+/**
+ *      \brief Table of interned strings
+ *
+ *      Each distinct string is stored once and given a small integer id so
+ *      callers can compare ids instead of strings. Ids are handed out in
+ *      order and never reused, id 0 is always the empty string.
+ *
+ *      Only sym_intern needs to be serialized. Lookups may run alongside
+ *      it from an epoch read section, arrays replaced as the table grows
+ *      are freed once those readers have moved on.
+ */
+struct symtab {
+	/** string for each id */
+	char **names;
+	/** number of ids handed out */
+	unsigned int count;
+	/** number of entries allocated for names */
+	unsigned int names_size;
+	/** open addressing table of ids, -1 marks an empty slot */
+	int *slots;
+	/** number of slots, a power of two */
+	unsigned int size;
+};
+
+int sym_intern(const char *, size_t);
+int sym_lookup(const char *, size_t);
+const char *sym_name(int);
+void sym_free(void);
+
+#endif /* SYMTAB_H_ */
@@ -0,0 +1,219 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdlib.h>
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "timerwheel.h"
+
+/**
+ *	@brief Makes a list head point at itself
+ *	@param head - the list head
+ *	@return void
+ */
+static void tw_list_init(struct tw_entry *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+/**
+ *	@brief Initializes an empty wheel
+ *	@param wheel - the wheel
+ *	@param now - the current tick
+ *	@return void
+ */
+void tw_init(struct timer_wheel *wheel, unsigned int now)
+{
+	int i;
+
+	wheel->now = now;
+
+	for (i = 0; i < TW_SIZE0; i++)
+		tw_list_init(&wheel->level0[i]);
+	for (i = 0; i < TW_SIZE1; i++)
+		tw_list_init(&wheel->level1[i]);
+}
+
+/**
+ *	@brief Puts an entry on the slot list for its deadline
+ *	@param wheel - the wheel
+ *	@param entry - the entry, which must not be pending
+ *	@return void
+ */
+static void tw_link(struct timer_wheel *wheel, struct tw_entry *entry)
+{
+	struct tw_entry *head;
+	unsigned int delta;
+
+	delta = entry->expires - wheel->now;
+
+	if (delta < TW_SIZE0)
+		head = &wheel->level0[entry->expires & (TW_SIZE0 - 1)];
+	else
+		head = &wheel->level1[(entry->expires >> TW_BITS0) &
+			(TW_SIZE1 - 1)];
+
+	entry->next = head;
+	entry->prev = head->prev;
+	head->prev->next = entry;
+	head->prev = entry;
+	entry->pending = 1;
+}
+
+/**
+ *	@brief Schedules an entry, moving it if it is already pending
+ *	@param wheel - the wheel
+ *	@param entry - the entry
+ *	@param expires - tick at which the entry expires
+ *	@return void
+ */
+void tw_add(struct timer_wheel *wheel, struct tw_entry *entry,
+		unsigned int expires)
+{
+	tw_del(entry);
+
+	/* the current tick has been processed, so the earliest is the next */
+	if ((int)(expires - wheel->now) <= 0)
+		expires = wheel->now + 1;
+	else if (expires - wheel->now > TW_SPAN)
+		expires = wheel->now + TW_SPAN;
+
+	entry->expires = expires;
+	tw_link(wheel, entry);
+}
+
+/**
+ *	@brief Cancels an entry, does nothing if it is not pending
+ *	@param entry - the entry
+ *	@return void
+ */
+void tw_del(struct tw_entry *entry)
+{
+	if (!entry->pending)
+		return;
+
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = NULL;
+	entry->prev = NULL;
+	entry->pending = 0;
+}
+
+/**
+ *	@brief Moves the entries of a second level slot down to the first level
+ *	@param wheel - the wheel
+ *	@param slot - the second level slot
+ *	@return void
+ */
+static void tw_cascade(struct timer_wheel *wheel, int slot)
+{
+	struct tw_entry list;
+	struct tw_entry *entry;
+	struct tw_entry *head;
+
+	head = &wheel->level1[slot];
+	if (head->next == head)
+		return;
+
+	/* detach the slot so entries can be relinked as we go */
+	list.next = head->next;
+	list.prev = head->prev;
+	list.next->prev = &list;
+	list.prev->next = &list;
+	tw_list_init(head);
+
+	while (list.next != &list) {
+		entry = list.next;
+		list.next = entry->next;
+		entry->next->prev = &list;
+		entry->pending = 0;
+		tw_link(wheel, entry);
+	}
+}
+
+/**
+ *	@brief Advances the wheel, calling expire for each entry that is due
+ *	expire may free the entry or add it again
+ *	@param wheel - the wheel
+ *	@param now - the current tick
+ *	@param expire - callback for expired entries
+ *	@return number of entries expired
+ */
+int tw_advance(struct timer_wheel *wheel, unsigned int now,
+		void (*expire)(struct tw_entry *))
+{
+	struct tw_entry list;
+	struct tw_entry *entry;
+	struct tw_entry *head;
+	int expired;
+	int slot;
+
+	expired = 0;
+
+	while ((int)(now - wheel->now) > 0) {
+		wheel->now++;
+		slot = wheel->now & (TW_SIZE0 - 1);
+
+		/* first level wrapped, pull down the next block of deadlines */
+		if (slot == 0)
+			tw_cascade(wheel, (wheel->now >> TW_BITS0) &
+					(TW_SIZE1 - 1));
+
+		head = &wheel->level0[slot];
+		if (head->next == head)
+			continue;
+
+		list.next = head->next;
+		list.prev = head->prev;
+		list.next->prev = &list;
+		list.prev->next = &list;
+		tw_list_init(head);
+
+		while (list.next != &list) {
+			entry = list.next;
+			list.next = entry->next;
+			entry->next->prev = &list;
+			entry->next = NULL;
+			entry->prev = NULL;
+			entry->pending = 0;
+			expire(entry);
+			expired++;
+		}
+	}
+
+	return expired;
+}
@@ -0,0 +1,87 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+/** Number of bits of the deadline covered by the first level */
+#define TW_BITS0	8
+/** Number of bits of the deadline covered by the second level */
+#define TW_BITS1	6
+/** Number of slots in the first level, one per tick */
+#define TW_SIZE0	(1 << TW_BITS0)
+/** Number of slots in the second level, one per TW_SIZE0 ticks */
+#define TW_SIZE1	(1 << TW_BITS1)
+/** Longest delay the wheel can hold, later deadlines are clamped */
+#define TW_SPAN		(TW_SIZE0 * TW_SIZE1 - 1)
+
+/**
+ *      \brief Timer embedded in the object it times
+ *
+ *      An entry is on at most one slot list at a time. The owner recovers
+ *      its object from the entry pointer in the expiry callback.
+ */
+struct tw_entry {
+	/** next entry in the slot */
+	struct tw_entry *next;
+	/** previous entry in the slot */
+	struct tw_entry *prev;
+	/** tick at which the entry expires */
+	unsigned int expires;
+	/** whether the entry is on a slot list */
+	int pending;
+};
+
+/**
+ *      \brief Two level hierarchical timer wheel
+ *
+ *      The first level has a slot for each of the next TW_SIZE0 ticks. Later
+ *      deadlines wait in the second level and are moved down a level each
+ *      time the first level wraps. Adding and removing an entry is O(1) and
+ *      advancing the wheel only visits the entries which expire or move.
+ */
+struct timer_wheel {
+	/** last tick processed */
+	unsigned int now;
+	/** list heads for the first level */
+	struct tw_entry level0[TW_SIZE0];
+	/** list heads for the second level */
+	struct tw_entry level1[TW_SIZE1];
+};
+
+void tw_init(struct timer_wheel *, unsigned int);
+void tw_add(struct timer_wheel *, struct tw_entry *, unsigned int);
+void tw_del(struct tw_entry *);
+int tw_advance(struct timer_wheel *, unsigned int,
+		void (*)(struct tw_entry *));
+
+#endif /* TIMERWHEEL_H_ */
@@ -0,0 +1,375 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+#include "transport.h"
+
+/**
+ *	@brief Reads a transport from the command line
+ *	"vsock", "vsock-seq", "udp", "udp:<address>", "unix:<directory>",
+ *	"unix-seq:<directory>" or "shm:<directory>", the address
+ *	of udp is where wmasterd is, 127.0.0.1 if not given
+ *	@param tp - the transport
+ *	@param spec - the option
+ *	@return 0 on success, -1 if spec is not understood
+ */
+int transport_parse(struct transport *tp, const char *spec)
+{
+	memset(tp, 0, sizeof(struct transport));
+
+	if ((strcmp(spec, "vsock") == 0) || (strcmp(spec, "vsock-seq") == 0)) {
+		tp->type = TRANSPORT_VSOCK;
+		tp->seqpacket = (spec[5] == '-');
+#ifdef AF_VSOCK
+		tp->af = AF_VSOCK;
+#endif
+		tp->host = VMADDR_CID_HOST;
+		return 0;
+	}
+
+	if ((strncmp(spec, "udp", 3) == 0) &&
+			((spec[3] == '\0') || (spec[3] == ':'))) {
+		tp->type = TRANSPORT_UDP;
+		tp->af = AF_INET;
+		tp->host = INADDR_LOOPBACK;
+		if (spec[3] == ':')
+			return transport_id_parse(tp, spec + 4, &tp->host);
+		return 0;
+	}
+
+#ifndef _WIN32
+	if ((strncmp(spec, "unix:", 5) == 0) ||
+			(strncmp(spec, "unix-seq:", 9) == 0) ||
+			(strncmp(spec, "shm:", 4) == 0)) {
+		tp->shm = (spec[0] == 's');
+		tp->seqpacket = (spec[4] == '-');
+		spec = strchr(spec, ':') + 1;
+		if ((spec[0] == '\0') || (strlen(spec) >= TRANSPORT_DIR_LEN))
+			return -1;
+		tp->type = TRANSPORT_UNIX;
+		tp->af = AF_UNIX;
+		tp->host = VMADDR_CID_HOST;
+		strncpy(tp->dir, spec, TRANSPORT_DIR_LEN - 1);
+		return 0;
+	}
+#endif
+
+	return -1;
+}
+
+/**
+ *	@brief Reads the name of a node
+ *	@param tp - the transport
+ *	@param str - an IPv4 address for udp, a number otherwise
+ *	@param id - set to the name
+ *	@return 0 on success, -1 if str is not a name
+ */
+int transport_id_parse(struct transport *tp, const char *str,
+		unsigned int *id)
+{
+	unsigned long addr;
+	char *end;
+
+	if (tp->type == TRANSPORT_UDP) {
+		addr = inet_addr(str);
+		if (addr == INADDR_NONE)
+			return -1;
+		*id = ntohl(addr);
+		return 0;
+	}
+
+	addr = strtoul(str, &end, 10);
+	if ((end == str) || (*end != '\0'))
+		return -1;
+	*id = addr;
+
+	return 0;
+}
+
+/**
+ *	@brief Names a transport for messages
+ *	@param tp - the transport
+ *	@return the name
+ */
+const char *transport_name(struct transport *tp)
+{
+	switch (tp->type) {
+	case TRANSPORT_UDP:
+		return "udp";
+	case TRANSPORT_UNIX:
+		if (tp->seqpacket)
+			return "unix-seq";
+		return tp->shm ? "shm" : "unix";
+	default:
+		return tp->seqpacket ? "vsock-seq" : "vsock";
+	}
+}
+
+/**
+ *	@brief Builds the address of a port of a node
+ *	@param tp - the transport
+ *	@param addr - set to the address
+ *	@param id - name of the node
+ *	@param port - the port
+ *	@return length of the address
+ */
+socklen_t transport_addr(struct transport *tp, union transport_addr *addr,
+		unsigned int id, unsigned int port)
+{
+	switch (tp->type) {
+	case TRANSPORT_UDP:
+		memset(&addr->in, 0, sizeof(struct sockaddr_in));
+		addr->in.sin_family = AF_INET;
+		addr->in.sin_addr.s_addr = htonl(id);
+		addr->in.sin_port = htons(port);
+		return sizeof(struct sockaddr_in);
+#ifndef _WIN32
+	case TRANSPORT_UNIX:
+		memset(&addr->un, 0, offsetof(struct sockaddr_un, sun_path));
+		addr->un.sun_family = AF_UNIX;
+		/* the terminator is part of the address so receivers get it */
+		return offsetof(struct sockaddr_un, sun_path) + 1 +
+			snprintf(addr->un.sun_path, sizeof(addr->un.sun_path),
+				"%s/%u.%u", tp->dir, id, port);
+#endif
+	default:
+		memset(&addr->vm, 0, sizeof(struct sockaddr_vm));
+		addr->vm.svm_family = tp->af;
+		addr->vm.svm_cid = id;
+		addr->vm.svm_port = port;
+		return sizeof(struct sockaddr);
+	}
+}
+
+/**
+ *	@brief Finds the name of the node a datagram came from
+ *	@param tp - the transport
+ *	@param addr - address the datagram was received from
+ *	@return name of the node, 0 if it cannot be told
+ */
+unsigned int transport_id(struct transport *tp, union transport_addr *addr)
+{
+#ifndef _WIN32
+	char *name;
+#endif
+
+	switch (tp->type) {
+	case TRANSPORT_UDP:
+		return ntohl(addr->in.sin_addr.s_addr);
+#ifndef _WIN32
+	case TRANSPORT_UNIX:
+		name = strrchr(addr->un.sun_path, '/');
+		if (name == NULL)
+			return 0;
+		return strtoul(name + 1, NULL, 10);
+#endif
+	default:
+		return addr->vm.svm_cid;
+	}
+}
+
+/**
+ *	@brief Opens a datagram socket bound to a port of a node
+ *	a vsock socket is bound to any CID, and only when port is not 0,
+ *	other sockets are always bound so receivers can tell who sent
+ *	@param tp - the transport
+ *	@param id - name of this node
+ *	@param port - the port, 0 for a socket which only sends
+ *	@return the socket, or -1 on error
+ */
+int transport_open(struct transport *tp, unsigned int id, unsigned int port)
+{
+	union transport_addr addr;
+	socklen_t len;
+	int fd;
+
+	fd = socket(tp->af, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (tp->type == TRANSPORT_VSOCK) {
+		if (port == 0)
+			return fd;
+		id = VMADDR_CID_ANY;
+	}
+
+	len = transport_addr(tp, &addr, id, port);
+#ifndef _WIN32
+	/* a socket left behind by an earlier run is in the way */
+	if (tp->type == TRANSPORT_UNIX)
+		unlink(addr.un.sun_path);
+#endif
+	if (bind(fd, &addr.sa, len) < 0) {
+#ifdef _WIN32
+		closesocket(fd);
+#else
+		close(fd);
+#endif
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ *	@brief Closes a socket opened by transport_open
+ *	@param tp - the transport
+ *	@param fd - the socket
+ *	@param id - name of this node
+ *	@param port - port the socket was opened on
+ *	@return void
+ */
+void transport_close(struct transport *tp, int fd, unsigned int id,
+		unsigned int port)
+{
+#ifdef _WIN32
+	/* Winsock sockets are not file descriptors */
+	closesocket(fd);
+#else
+	union transport_addr addr;
+
+	close(fd);
+
+	if (tp->type == TRANSPORT_UNIX) {
+		transport_addr(tp, &addr, id, port);
+		unlink(addr.un.sun_path);
+	}
+#endif
+}
+
+#ifndef _WIN32
+/**
+ *	@brief Opens a SOCK_SEQPACKET socket which wmasterd accepts welled
+ *	connections on
+ *	@param tp - the transport
+ *	@param id - name of this node
+ *	@param port - the port
+ *	@return the socket, or -1 on error
+ */
+int transport_listen(struct transport *tp, unsigned int id, unsigned int port)
+{
+	union transport_addr addr;
+	socklen_t len;
+	int fd;
+
+	fd = socket(tp->af, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	if (tp->type == TRANSPORT_VSOCK)
+		id = VMADDR_CID_ANY;
+
+	len = transport_addr(tp, &addr, id, port);
+	if (tp->type == TRANSPORT_UNIX)
+		unlink(addr.un.sun_path);
+	if ((bind(fd, &addr.sa, len) < 0) || (listen(fd, SOMAXCONN) < 0)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ *	@brief Connects a SOCK_SEQPACKET socket to a port of wmasterd
+ *	an AF_UNIX socket is first bound to port 0 of this node so wmasterd
+ *	can tell who connected, vsock carries the CID itself
+ *	@param tp - the transport
+ *	@param id - name of this node
+ *	@param port - port of wmasterd
+ *	@return the socket, or -1 on error
+ */
+int transport_connect(struct transport *tp, unsigned int id, unsigned int port)
+{
+	union transport_addr addr;
+	socklen_t len;
+	int fd;
+
+	fd = socket(tp->af, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	if (tp->type == TRANSPORT_UNIX) {
+		len = transport_addr(tp, &addr, id, 0);
+		unlink(addr.un.sun_path);
+		if (bind(fd, &addr.sa, len) < 0)
+			goto fail;
+	}
+
+	transport_buffers(tp, fd, TRANSPORT_CONN_BUF);
+
+	len = transport_addr(tp, &addr, tp->host, port);
+	if (connect(fd, &addr.sa, len) < 0)
+		goto fail;
+
+	return fd;
+fail:
+	transport_close(tp, fd, id, 0);
+	return -1;
+}
+
+/**
+ *	@brief Sizes the buffers of a connection, failures are ignored and
+ *	leave the defaults
+ *	@param tp - the transport
+ *	@param fd - the connection
+ *	@param size - bytes wanted each way
+ *	@return void
+ */
+void transport_buffers(struct transport *tp, int fd, int size)
+{
+#ifdef SO_VM_SOCKETS_BUFFER_SIZE
+	unsigned long long vsize;
+
+	/* vsock has one buffer per connection, sized by its own option */
+	if (tp->type == TRANSPORT_VSOCK) {
+		vsize = size;
+		if (setsockopt(fd, tp->af, SO_VM_SOCKETS_BUFFER_MAX_SIZE,
+				&vsize, sizeof(vsize)) == 0)
+			setsockopt(fd, tp->af, SO_VM_SOCKETS_BUFFER_SIZE,
+					&vsize, sizeof(vsize));
+		return;
+	}
+#endif
+
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+#endif
@@ -0,0 +1,119 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include "vmci_sockets.h"
+#else
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <netinet/in.h>
+  #include <linux/vm_sockets.h>
+#endif
+
+#ifndef VMADDR_CID_HOST
+	#define VMADDR_CID_HOST		2
+#endif
+
+/** Frames are carried over vsock or VMCI, nodes are named by CID */
+#define TRANSPORT_VSOCK		0
+/** Frames are carried over UDP, nodes are named by IPv4 address */
+#define TRANSPORT_UDP		1
+/** Frames are carried over AF_UNIX datagrams, nodes are named by number */
+#define TRANSPORT_UNIX		2
+
+/** Port of wmasterd which takes shared memory channels over AF_UNIX */
+#define TRANSPORT_SHM_PORT	1112
+
+/** Buffer size asked for on each SOCK_SEQPACKET connection */
+#define TRANSPORT_CONN_BUF	(1 << 20)
+
+/** Longest directory for AF_UNIX sockets, leaves room for "/id.port" */
+#define TRANSPORT_DIR_LEN	80
+
+/**
+ *      \brief Address of a node on any transport
+ */
+union transport_addr {
+	struct sockaddr sa;
+	struct sockaddr_vm vm;
+	struct sockaddr_in in;
+#ifndef _WIN32
+	struct sockaddr_un un;
+#endif
+};
+
+/**
+ *      \brief How wmasterd and welled reach each other
+ *
+ *      Every node is named by an unsigned int, whatever carries its
+ *      frames. On vsock this is the CID. On UDP it is the IPv4 address
+ *      in host order, so nodes sharing a host can use 127.0.0.0/8. On
+ *      AF_UNIX it is a number, and the socket of port p of node n is
+ *      the file n.p in the transport's directory. The shm transport is
+ *      AF_UNIX plus a shared memory channel per node. The -seq variants
+ *      of vsock and unix carry frames over one SOCK_SEQPACKET connection
+ *      from each welled to wmasterd instead of datagrams.
+ */
+struct transport {
+	/** TRANSPORT_VSOCK, TRANSPORT_UDP or TRANSPORT_UNIX */
+	int type;
+	/** address family of the sockets */
+	int af;
+	/** name of the node wmasterd runs on */
+	unsigned int host;
+	/** AF_UNIX nodes also exchange frames through shared memory */
+	int shm;
+	/** each welled holds a SOCK_SEQPACKET connection to wmasterd */
+	int seqpacket;
+	/** directory of the AF_UNIX sockets */
+	char dir[TRANSPORT_DIR_LEN];
+};
+
+int transport_parse(struct transport *, const char *);
+int transport_id_parse(struct transport *, const char *, unsigned int *);
+const char *transport_name(struct transport *);
+socklen_t transport_addr(struct transport *, union transport_addr *,
+		unsigned int, unsigned int);
+unsigned int transport_id(struct transport *, union transport_addr *);
+int transport_open(struct transport *, unsigned int, unsigned int);
+void transport_close(struct transport *, int, unsigned int, unsigned int);
+int transport_listen(struct transport *, unsigned int, unsigned int);
+int transport_connect(struct transport *, unsigned int, unsigned int);
+void transport_buffers(struct transport *, int, int);
+
+#endif /* TRANSPORT_H_ */
@@ -0,0 +1,383 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "uring.h"
+
+#ifdef URING_SUPPORTED
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * libc has no wrappers for these and liburing is not a dependency, the
+ * ring is set up and driven the way io_uring(7) describes. Loads of what
+ * the kernel writes are acquires and stores of what it reads are
+ * releases.
+ */
+
+/**
+ *	@brief Sets up a ring
+ *	@param ring - the ring
+ *	@param entries - number of SQEs, rounded up by the kernel
+ *	@return 0 on success, -1 with errno set if io_uring is unavailable
+ */
+int uring_init(struct uring *ring, unsigned int entries)
+{
+	struct io_uring_params params;
+	char *sq;
+	char *cq;
+	int err;
+
+	memset(ring, 0, sizeof(struct uring));
+	memset(&params, 0, sizeof(params));
+
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_entries = params.sq_entries;
+	ring->sq_ring_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	/* kernels before 5.4 map the two rings separately */
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = 0;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		goto fail;
+	}
+
+	if (ring->cq_ring_size == 0) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->fd,
+				IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			goto fail;
+		}
+	}
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto fail;
+	}
+
+	sq = ring->sq_ring;
+	ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+
+	cq = ring->cq_ring;
+	ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	return 0;
+
+fail:
+	err = errno;
+	uring_free(ring);
+	errno = err;
+	return -1;
+}
+
+/**
+ *	@brief Gets a cleared SQE to fill in
+ *	@param ring - the ring
+ *	@return the SQE or NULL if the SQ is full
+ */
+struct io_uring_sqe *uring_get_sqe(struct uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int index;
+
+	head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	tail = *ring->sq_tail + ring->sq_pending;
+	if (tail - head >= ring->sq_entries)
+		return NULL;
+
+	index = tail & *ring->sq_mask;
+	ring->sq_array[index] = index;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	ring->sq_pending++;
+
+	return sqe;
+}
+
+/**
+ *	@brief Hands the SQEs not yet taken by the kernel to it
+ *	@param ring - the ring
+ *	@param wait - number of completions to wait for
+ *	@return number of SQEs submitted, -1 with errno set on failure
+ */
+int uring_submit(struct uring *ring, unsigned int wait)
+{
+	unsigned int count;
+	int ret;
+
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->sq_pending,
+			__ATOMIC_RELEASE);
+	ring->sq_pending = 0;
+
+	/* includes any the kernel did not take on an earlier call */
+	count = *ring->sq_tail - __atomic_load_n(ring->sq_head,
+			__ATOMIC_ACQUIRE);
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, count, wait,
+				wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (ret > 0)
+		ring->submitted += ret;
+
+	return ret;
+}
+
+/**
+ *	@brief Takes back the SQEs the kernel has not taken yet
+ *	only safe as the rings are not set up with SQPOLL
+ *	@param ring - the ring
+ *	@return number of SQEs taken back
+ */
+unsigned int uring_withdraw(struct uring *ring)
+{
+	unsigned int head;
+	unsigned int count;
+
+	head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	count = *ring->sq_tail - head + ring->sq_pending;
+	__atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+	ring->sq_pending = 0;
+
+	return count;
+}
+
+/**
+ *	@brief Waits for completions without submitting anything
+ *	@param ring - the ring
+ *	@param wait - number of completions to wait for
+ *	@return 0 on success, -1 with errno set on failure
+ */
+int uring_wait(struct uring *ring, unsigned int wait)
+{
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, 0, wait,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+	} while ((ret < 0) && (errno == EINTR));
+
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ *	@brief Looks at the oldest completion without consuming it
+ *	@param ring - the ring
+ *	@return the CQE or NULL if there are none
+ */
+struct io_uring_cqe *uring_peek(struct uring *ring)
+{
+	unsigned int head;
+
+	head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	return &ring->cqes[head & *ring->cq_mask];
+}
+
+/**
+ *	@brief Consumes the completion returned by uring_peek
+ *	@param ring - the ring
+ *	@return void
+ */
+void uring_seen(struct uring *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+	ring->completed++;
+}
+
+/**
+ *	@brief Signals an eventfd whenever a completion is posted
+ *	@param ring - the ring
+ *	@param fd - the eventfd
+ *	@return 0 on success, -1 with errno set on failure
+ */
+int uring_register_eventfd(struct uring *ring, int fd)
+{
+	return syscall(__NR_io_uring_register, ring->fd,
+			IORING_REGISTER_EVENTFD, &fd, 1) < 0 ? -1 : 0;
+}
+
+/**
+ *	@brief Registers a group of buffers the kernel picks receive buffers
+ *	from, every buffer starts out available
+ *	@param ring - the ring
+ *	@param group - id of the buffer group
+ *	@param count - number of buffers, a power of two
+ *	@param size - size of each buffer
+ *	@return 0 on success, -1 with errno set on failure
+ */
+int uring_buf_ring_init(struct uring *ring, unsigned short group,
+		unsigned int count, unsigned int size)
+{
+	struct io_uring_buf_reg reg;
+	size_t ring_size;
+	unsigned int i;
+	void *p;
+
+	ring_size = count * sizeof(struct io_uring_buf);
+	p = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return -1;
+
+	ring->buf_base = malloc((size_t)count * size);
+	if (!ring->buf_base) {
+		munmap(p, ring_size);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)p;
+	reg.ring_entries = count;
+	reg.bgid = group;
+	if (syscall(__NR_io_uring_register, ring->fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		free(ring->buf_base);
+		ring->buf_base = NULL;
+		munmap(p, ring_size);
+		return -1;
+	}
+
+	ring->buf_ring = p;
+	ring->buf_count = count;
+	ring->buf_size = size;
+	ring->buf_group = group;
+
+	for (i = 0; i < count; i++) {
+		ring->buf_ring->bufs[i].addr =
+			(unsigned long)(ring->buf_base + (size_t)i * size);
+		ring->buf_ring->bufs[i].len = size;
+		ring->buf_ring->bufs[i].bid = i;
+	}
+	__atomic_store_n(&ring->buf_ring->tail, count, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ *	@brief Finds a provided buffer by id
+ *	@param ring - the ring
+ *	@param bid - buffer id from a completion
+ *	@return the buffer
+ */
+char *uring_buf(struct uring *ring, unsigned int bid)
+{
+	return ring->buf_base + (size_t)bid * ring->buf_size;
+}
+
+/**
+ *	@brief Gives a provided buffer back to the kernel
+ *	@param ring - the ring
+ *	@param bid - buffer id from a completion
+ *	@return void
+ */
+void uring_buf_recycle(struct uring *ring, unsigned int bid)
+{
+	struct io_uring_buf *buf;
+	unsigned short tail;
+
+	tail = ring->buf_ring->tail;
+	buf = &ring->buf_ring->bufs[tail & (ring->buf_count - 1)];
+	buf->addr = (unsigned long)uring_buf(ring, bid);
+	buf->len = ring->buf_size;
+	buf->bid = bid;
+	__atomic_store_n(&ring->buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *	@brief Tears down a ring, outstanding requests are cancelled
+ *	@param ring - the ring
+ *	@return void
+ */
+void uring_free(struct uring *ring)
+{
+	if (ring->fd >= 0)
+		close(ring->fd);
+	if (ring->buf_ring)
+		munmap(ring->buf_ring,
+			ring->buf_count * sizeof(struct io_uring_buf));
+	free(ring->buf_base);
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && (ring->cq_ring != ring->sq_ring))
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+
+	memset(ring, 0, sizeof(struct uring));
+	ring->fd = -1;
+}
+#endif /* URING_SUPPORTED */
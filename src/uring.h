@@ -0,0 +1,124 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef URING_H_
+#define URING_H_
+
+#include <stddef.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+/** the kernel headers have every io_uring feature used here */
+#define URING_SUPPORTED
+#endif
+#endif
+#endif
+
+#ifdef URING_SUPPORTED
+
+/**
+ *      \brief An io_uring instance driven with raw system calls
+ *
+ *      Only what wmasterd needs is wrapped: getting and submitting SQEs,
+ *      reaping CQEs, an eventfd for completions and a ring of provided
+ *      receive buffers. A ring must only be used by one thread at a time.
+ */
+struct uring {
+	/** ring descriptor, -1 when not set up */
+	int fd;
+	/** number of SQEs */
+	unsigned int sq_entries;
+	/** SQ head, written by the kernel */
+	unsigned int *sq_head;
+	/** SQ tail */
+	unsigned int *sq_tail;
+	/** SQ index mask */
+	unsigned int *sq_mask;
+	/** SQ index array */
+	unsigned int *sq_array;
+	/** SQE slots */
+	struct io_uring_sqe *sqes;
+	/** SQEs filled in but not yet submitted */
+	unsigned int sq_pending;
+	/** CQ head */
+	unsigned int *cq_head;
+	/** CQ tail, written by the kernel */
+	unsigned int *cq_tail;
+	/** CQ index mask */
+	unsigned int *cq_mask;
+	/** CQE slots */
+	struct io_uring_cqe *cqes;
+	/** mapping of the SQ ring */
+	void *sq_ring;
+	/** size of the SQ ring mapping */
+	size_t sq_ring_size;
+	/** mapping of the CQ ring, may be the SQ ring */
+	void *cq_ring;
+	/** size of the CQ ring mapping */
+	size_t cq_ring_size;
+	/** size of the SQE mapping */
+	size_t sqes_size;
+	/** provided buffer ring, NULL when not set up */
+	struct io_uring_buf_ring *buf_ring;
+	/** number of provided buffers, a power of two */
+	unsigned int buf_count;
+	/** memory of the provided buffers */
+	char *buf_base;
+	/** size of each provided buffer */
+	unsigned int buf_size;
+	/** id of the provided buffer group */
+	unsigned short buf_group;
+	/** SQEs handed to the kernel */
+	unsigned long submitted;
+	/** CQEs reaped */
+	unsigned long completed;
+};
+
+int uring_init(struct uring *, unsigned int);
+struct io_uring_sqe *uring_get_sqe(struct uring *);
+int uring_submit(struct uring *, unsigned int);
+unsigned int uring_withdraw(struct uring *);
+int uring_wait(struct uring *, unsigned int);
+struct io_uring_cqe *uring_peek(struct uring *);
+void uring_seen(struct uring *);
+int uring_register_eventfd(struct uring *, int);
+int uring_buf_ring_init(struct uring *, unsigned short, unsigned int,
+		unsigned int);
+char *uring_buf(struct uring *, unsigned int);
+void uring_buf_recycle(struct uring *, unsigned int);
+void uring_free(struct uring *);
+
+#endif /* URING_SUPPORTED */
+
+#endif /* URING_H_ */
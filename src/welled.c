@@ -63,6 +63,7 @@
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <syslog.h>
 #include <stdarg.h>
 
@@ -76,15 +77,13 @@
 #include "welled.h"
 #include "ieee80211.h"
 #include "nodes.h"
+#include "transport.h"
+#include "shmring.h"
 
 /** Port used to send frames to wmasterd */
 #define SEND_PORT		1111
 /** Port used to receive frames from wmasterd */
 #define RECV_PORT		2222
-/** Address used to send frames to wmasterd */
-#ifndef VMADDR_CID_HOST
-	#define VMADDR_CID_HOST		2
-#endif
 /** Buffer size for VMCI datagrams */
 #define VMCI_BUFF_LEN		4096
 /** Buffer size for UDP datagrams */
@@ -112,10 +111,26 @@ int family_id;
 int sockfd;
 /** FD for vmci receive */
 int myservfd;
-/** sockaddr_vm for vmci send */
-struct sockaddr_vm servaddr_vm;
-/** sockaddr_vm for vmci receive */
-struct sockaddr_vm myservaddr_vm;
+/** how frames reach wmasterd, vsock unless -T says otherwise */
+struct transport transport;
+/** name of this node on transports other than vsock */
+unsigned int node_id;
+/** address frames are sent to wmasterd at */
+union transport_addr servaddr;
+/** length of servaddr */
+socklen_t servaddr_len;
+#ifdef SHM_SUPPORTED
+/** shared memory channel to wmasterd, used by the shm transport */
+struct shm_channel shm;
+/** whether shm has been created */
+int shm_ready;
+/** address wmasterd takes shared memory channels at */
+union transport_addr shmaddr;
+/** length of shmaddr */
+socklen_t shmaddr_len;
+/** head of the up ring at the last heartbeat */
+uint32_t shm_head_seen;
+#endif
 /** mutex for linked list access */
 pthread_mutex_t list_mutex;
 /** mutex for driver unload/load checking */
@@ -145,13 +160,16 @@ void show_usage(int exval)
 
 	printf("welled - wireless emulation link layer exchange daemon\n\n");
 
-	printf("Usage: welled [-hVav] [-D <level>]\n\n");
+	printf("Usage: welled [-hVav] [-D <level>] [-T <transport>] [-i <id>]\n\n");
 
 	printf("Options:\n");
 	printf("  -h, --help	print this help and exit\n");
 	printf("  -V, --version	print version and exit\n");
 	printf("  -a, --any	allow any mac address (patched driver)\n");
 	printf("  -D, --debug   debug level for syslog\n");
+	printf("  -T, --transport	vsock, vsock-seq, udp[:<wmasterd address>], unix:<dir>,\n");
+	printf("			unix-seq:<dir> or shm:<dir>\n");
+	printf("  -i, --id	address for udp or number for unix naming this node\n");
 	printf("  -v, --verbose	verbose output\n\n");
 
 	printf("Copyright (C) 2015 Carnegie Mellon University\n\n");
@@ -845,9 +863,7 @@ attempt idx, count: -1 0
 	}
 
 	pthread_mutex_lock(&send_mutex);
-	bytes = sendto(sockfd, (char *)nlh, msg_len, 0,
-			(struct sockaddr *)&servaddr_vm,
-			sizeof(struct sockaddr));
+	bytes = send_to_master((char *)nlh, msg_len);
 	pthread_mutex_unlock(&send_mutex);
 
 	if (bytes < 0) {
@@ -1029,9 +1045,7 @@ static void generate_ack_frame(uint32_t freq, struct ether_addr *src,
 
 	/* send frame to wmasterd */
 	pthread_mutex_lock(&send_mutex);
-	bytes = sendto(sockfd, (char *)nlh, msg_len, 0,
-			(struct sockaddr *)&servaddr_vm,
-			sizeof(struct sockaddr));
+	bytes = send_to_master((char *)nlh, msg_len);
 	pthread_mutex_unlock(&send_mutex);
 
 	if (bytes < 0) {
@@ -1048,6 +1062,98 @@ out:
 	nlmsg_free(msg);
 }
 
+#ifdef SHM_SUPPORTED
+/**
+ *	@brief Hands the shared memory channel to wmasterd, send_mutex must
+ *	be held
+ *	@return void
+ */
+void shm_offer(void)
+{
+	if (shm_channel_offer(sockfd, &shmaddr.sa, shmaddr_len, &shm) < 0)
+		print_debug(LOG_ERR, "error: cannot offer shared memory to wmasterd");
+	else
+		print_debug(LOG_DEBUG, "shared memory offered to wmasterd");
+}
+
+/**
+ *	@brief Offers the shared memory channel again if wmasterd has not
+ *	taken it or has stopped reading it, as it does when restarted,
+ *	send_mutex must be held
+ *	@return void
+ */
+void shm_check(void)
+{
+	uint32_t head;
+
+	head = __atomic_load_n(&shm.map->up.head, __ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&shm.map->attached, __ATOMIC_ACQUIRE) &&
+			(head == shm_head_seen) &&
+			(head != __atomic_load_n(&shm.map->up.tail,
+			__ATOMIC_ACQUIRE))) {
+		print_debug(LOG_NOTICE, "wmasterd stopped reading shared memory");
+		__atomic_store_n(&shm.map->attached, 0, __ATOMIC_RELEASE);
+	}
+	shm_head_seen = head;
+
+	if (!__atomic_load_n(&shm.map->attached, __ATOMIC_ACQUIRE))
+		shm_offer();
+}
+#endif
+
+/**
+ *	@brief Sends a message to wmasterd, through the shared memory
+ *	channel once wmasterd has taken it, send_mutex must be held
+ *	@param buf - the message
+ *	@param len - length of the message
+ *	@return bytes sent, -1 on failure
+ */
+int send_to_master(char *buf, int len)
+{
+#ifdef SHM_SUPPORTED
+	int ret;
+
+	if (shm_ready &&
+			__atomic_load_n(&shm.map->attached, __ATOMIC_ACQUIRE)) {
+		ret = shm_ring_push(&shm.map->up, buf, len, NULL, 0);
+		if (ret > 0)
+			shm_signal(shm.up_event);
+		if (ret >= 0)
+			return len;
+		/* full, wmasterd is behind or gone so try the socket */
+	}
+#endif
+
+	if (transport.seqpacket)
+		return send(sockfd, buf, len, MSG_NOSIGNAL);
+
+	return sendto(sockfd, buf, len, 0, &servaddr.sa, servaddr_len);
+}
+
+/**
+ *	@brief Connects to wmasterd on a connection oriented transport,
+ *	replacing a connection which has closed, and tells it we are up
+ *	@return 0 on success, -1 on failure
+ */
+int connect_to_master(void)
+{
+	pthread_mutex_lock(&send_mutex);
+
+	/* closed first, the new socket is bound to the same name */
+	if (sockfd >= 0)
+		transport_close(&transport, sockfd, node_id, 0);
+
+	/* frames both ways share the connection */
+	sockfd = transport_connect(&transport, node_id, SEND_PORT);
+	myservfd = sockfd;
+	if (sockfd >= 0)
+		send_to_master("UP", 2);
+
+	pthread_mutex_unlock(&send_mutex);
+
+	return (sockfd < 0) ? -1 : 0;
+}
+
 /**
  *	@brief parse vmci data received from wmastered.
  *	At the moment, this will not
@@ -1059,11 +1165,108 @@ out:
 void recv_from_master(void)
 {
 	char buf[VMCI_BUFF_LEN];
-	struct sockaddr_vm cliaddr_vmci;
-	struct sockaddr_in cliaddr;
+	union transport_addr cliaddr;
 	socklen_t addrlen;
 	struct timeval tv; /* timer to break out of recvfrom function */
 	int bytes;
+
+	addrlen = sizeof(cliaddr);
+	memset(&cliaddr, 0, sizeof(cliaddr));
+
+	/* not connected, try again each second */
+	if (transport.seqpacket && (myservfd < 0)) {
+		if (connect_to_master() < 0) {
+			sleep(1);
+			return;
+		}
+		print_debug(LOG_NOTICE, "connected to wmasterd");
+	}
+
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+
+	if (setsockopt(myservfd, SOL_SOCKET, SO_RCVTIMEO, &tv,
+			 sizeof(tv)) < 0) {
+		perror("setsockopt");
+	}
+
+	/* receive packets from wmasterd */
+	bytes = recvfrom(myservfd, (char *)buf, VMCI_BUFF_LEN, 0,
+			&cliaddr.sa, &addrlen);
+
+	/* wmasterd went away, reconnect on the next call */
+	if (transport.seqpacket && ((bytes == 0) || ((bytes < 0) &&
+			(errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+			(errno != EINTR)))) {
+		print_debug(LOG_NOTICE, "connection to wmasterd closed");
+		pthread_mutex_lock(&send_mutex);
+		transport_close(&transport, sockfd, node_id, 0);
+		sockfd = -1;
+		myservfd = -1;
+		pthread_mutex_unlock(&send_mutex);
+		return;
+	}
+
+	if (bytes < 0)
+		return;
+
+	print_debug(LOG_INFO, "received %d bytes packet from src host: %u",
+			bytes, transport_id(&transport, &cliaddr));
+
+	process_master_frame(buf, bytes);
+}
+
+#ifdef SHM_SUPPORTED
+/**
+ *	@brief Waits for frames from wmasterd on the socket and the shared
+ *	memory channel, and processes them
+ *	@return void
+ */
+void recv_from_master_shm(void)
+{
+	char buf[VMCI_BUFF_LEN];
+	struct pollfd fds[2];
+	char *frame;
+	int len;
+
+	fds[0].fd = myservfd;
+	fds[0].events = POLLIN;
+	fds[1].fd = shm.down_event;
+	fds[1].events = POLLIN;
+
+	/* only sleep if wmasterd pushed nothing while we looked */
+	if (!shm_ring_sleep(&shm.map->down)) {
+		if (poll(fds, 2, 1000) <= 0)
+			return;
+		if (fds[0].revents & POLLIN)
+			recv_from_master();
+		if (!(fds[1].revents & POLLIN))
+			return;
+		shm_clear(shm.down_event);
+	}
+
+	/* processing writes to the frame, so it is copied out first */
+	while ((len = shm_ring_peek(&shm.map->down, &frame)) >= 0) {
+		if (len <= VMCI_BUFF_LEN)
+			memcpy(buf, frame, len);
+		shm_ring_pop(&shm.map->down, len);
+		if (len <= VMCI_BUFF_LEN) {
+			print_debug(LOG_INFO, "received %d bytes packet from shared memory",
+					len);
+			process_master_frame(buf, len);
+		}
+	}
+}
+#endif
+
+/**
+ *	@brief Processes a frame received from wmasterd
+ *	@param buf - the frame, followed by the distance
+ *	@param bytes - length of buf
+ *	@return void
+ */
+void process_master_frame(char *buf, int bytes)
+{
 	struct nlmsghdr *nlh;
 	struct genlmsghdr *gnlh;
 	struct nlattr *attrs[HWSIM_ATTR_MAX + 1];
@@ -1083,28 +1286,7 @@ void recv_from_master(void)
 	int retval;
 	int distance;
 
-	addrlen = sizeof(struct sockaddr);
 	memset(addr, 0, sizeof(addr));
-	memset(&cliaddr_vmci, 0, sizeof(cliaddr_vmci));
-	memset(&cliaddr, 0, sizeof(cliaddr));
-
-	tv.tv_sec = 1;
-	tv.tv_usec = 0;
-
-	if (setsockopt(myservfd, SOL_SOCKET, SO_RCVTIMEO, &tv,
-			 sizeof(tv)) < 0) {
-		perror("setsockopt");
-	}
-
-	/* receive packets from wmasterd */
-	bytes = recvfrom(myservfd, (char *)buf, VMCI_BUFF_LEN, 0,
-			(struct sockaddr *)&cliaddr_vmci, &addrlen);
-
-	if (bytes < 0)
-		return;
-
-	print_debug(LOG_INFO, "received %d bytes packet from src host: %u",
-			bytes, cliaddr_vmci.svm_cid);
 
 	/* netlink header */
 	nlh = (struct nlmsghdr *)buf;
@@ -1373,6 +1555,12 @@ out:
 void *process_master(void *arg)
 {
 	while (running) {
+#ifdef SHM_SUPPORTED
+		if (shm_ready) {
+			recv_from_master_shm();
+			continue;
+		}
+#endif
 		recv_from_master();
 	}
 	print_debug(LOG_DEBUG, "process_master returning");
@@ -1681,9 +1869,11 @@ void *send_status(void *arg)
 			continue;
 
 		pthread_mutex_lock(&send_mutex);
-		bytes = sendto(sockfd, msg, msg_len, 0,
-				(struct sockaddr *)&servaddr_vm,
-				sizeof(struct sockaddr));
+		bytes = send_to_master(msg, msg_len);
+#ifdef SHM_SUPPORTED
+		if (shm_ready)
+			shm_check();
+#endif
 		pthread_mutex_unlock(&send_mutex);
 
 		/* this should be 8 bytes */
@@ -1985,7 +2175,7 @@ int nl80211_get_interface(int ifindex)
 int main(int argc, char *argv[])
 {
 	int euid;
-	int af;
+	char *id;
 	int opt;
 	int cid;
 	int ret;
@@ -2000,13 +2190,15 @@ int main(int argc, char *argv[])
 	any_mac = 0;
 	running = 1;
 	devices = 0;
-	af = 0;
+	id = NULL;
 	long_index = 0;
 	err = 0;
-	ioctl_fd = 0;
+	ioctl_fd = -1;
 	cid = 0;
 	family_id = -1;
 	loglevel = -1;
+	node_id = 0;
+	transport_parse(&transport, "vsock");
 
 	/* TODO: Send syslog message indicating start time */
 
@@ -2015,10 +2207,12 @@ int main(int argc, char *argv[])
 		{"version",	no_argument, 0, 'V'},
 		{"verbose",	no_argument, 0, 'v'},
 		{"debug",       required_argument, 0, 'D'},
+		{"transport",	required_argument, 0, 'T'},
+		{"id",		required_argument, 0, 'i'},
 		{"any",		no_argument, 0, 'a'}
 	};
 
-	while ((opt = getopt_long(argc, argv, "hVavD:", long_options,
+	while ((opt = getopt_long(argc, argv, "hVavD:T:i:", long_options,
 			&long_index)) != -1) {
 		switch (opt) {
 		case 'h':
@@ -2044,6 +2238,16 @@ int main(int argc, char *argv[])
 			}
 			printf("welled: syslog level set to %d\n", loglevel);
 			break;
+		case 'T':
+			if (transport_parse(&transport, optarg) < 0) {
+				printf("welled: unknown transport %s\n",
+						optarg);
+				show_usage(EXIT_FAILURE);
+			}
+			break;
+		case 'i':
+			id = optarg;
+			break;
 		case '?':
 			printf("Error - No such option: `%c'\n\n",
 				optopt);
@@ -2056,6 +2260,16 @@ int main(int argc, char *argv[])
 	if (optind < argc)
 		show_usage(EXIT_FAILURE);
 
+	/* the node is named by its address on udp, any if not given */
+	if (id != NULL) {
+		if (transport_id_parse(&transport, id, &node_id) < 0) {
+			printf("welled: invalid id %s\n", id);
+			show_usage(EXIT_FAILURE);
+		}
+	} else if (transport.type == TRANSPORT_UNIX) {
+		node_id = getpid();
+	}
+
 	if (loglevel >= 0)
 		openlog("welled", LOG_PID, LOG_USER);
 
@@ -2070,21 +2284,24 @@ int main(int argc, char *argv[])
 	//cid = VMCISock_GetLocalCID();
 	//printf("CID: %d\n", cid);
 
-	/* new code for vm_sockets */
-	af = AF_VSOCK;
-
-	ioctl_fd = open("/dev/vsock", 0);
-	if (ioctl_fd < 0) {
-		perror("open");
-		print_debug(LOG_ERR, "could not open /dev/vsock");
-		_exit(EXIT_FAILURE);
-	}
-	err = ioctl(ioctl_fd, IOCTL_VM_SOCKETS_GET_LOCAL_CID, &cid);
-	if (err < 0) {
-		perror("ioctl: Cannot get local CID");
-		print_debug(LOG_ERR, "could not get local CID");
+	/* new code for vm_sockets, other transports have no CID */
+	if (transport.type == TRANSPORT_VSOCK) {
+		ioctl_fd = open("/dev/vsock", 0);
+		if (ioctl_fd < 0) {
+			perror("open");
+			print_debug(LOG_ERR, "could not open /dev/vsock");
+			_exit(EXIT_FAILURE);
+		}
+		err = ioctl(ioctl_fd, IOCTL_VM_SOCKETS_GET_LOCAL_CID, &cid);
+		if (err < 0) {
+			perror("ioctl: Cannot get local CID");
+			print_debug(LOG_ERR, "could not get local CID");
+		} else {
+			print_debug(LOG_DEBUG, "CID: %u", cid);
+		}
 	} else {
-		print_debug(LOG_DEBUG, "CID: %u", cid);
+		print_debug(LOG_DEBUG, "transport: %s id: %u",
+				transport_name(&transport), node_id);
 	}
 
 	/* Handle signals */
@@ -2122,37 +2339,52 @@ int main(int argc, char *argv[])
 		nl_cb_put(cb);
 		_exit(EXIT_FAILURE);
 	}
-	/* setup vmci client socket */
-	sockfd = socket(af, SOCK_DGRAM, 0);
+	/* a connection is retried until wmasterd takes it */
+	sockfd = -1;
+	if (transport.seqpacket) {
+		if (connect_to_master() < 0) {
+			perror("connect");
+			print_debug(LOG_ERR, "cannot connect to wmasterd, retrying");
+		}
+	} else {
+		/* setup client socket */
+		sockfd = transport_open(&transport, node_id, 0);
+	}
 	/* we can initalize this struct because it never changes */
-	memset(&servaddr_vm, 0, sizeof(servaddr_vm));
-	servaddr_vm.svm_cid = VMADDR_CID_HOST;
-	servaddr_vm.svm_port = SEND_PORT;
-	servaddr_vm.svm_family = af;
-	if (sockfd < 0) {
+	servaddr_len = transport_addr(&transport, &servaddr, transport.host,
+			SEND_PORT);
+	if ((sockfd < 0) && !transport.seqpacket) {
 		perror("socket");
 		free_mem();
 		_exit(EXIT_FAILURE);
 	}
 
-	/* create vmci server socket */
-	myservfd = socket(af, SOCK_DGRAM, 0);
-
-	/* we can initalize this struct because it never changes */
-	memset(&myservaddr_vm, 0, sizeof(myservaddr_vm));
-	myservaddr_vm.svm_cid = VMADDR_CID_ANY;
-	myservaddr_vm.svm_port = RECV_PORT;
-	myservaddr_vm.svm_family = af;
-	ret = bind(myservfd, (struct sockaddr *)&myservaddr_vm,
-			sizeof(struct sockaddr));
-	if (ret < 0) {
+	/* create server socket */
+	if (!transport.seqpacket)
+		myservfd = transport_open(&transport, node_id, RECV_PORT);
+	if ((myservfd < 0) && !transport.seqpacket) {
 		perror("bind");
-		close(sockfd);
-		close(myservfd);
+		transport_close(&transport, sockfd, node_id, 0);
 		free_mem();
 		_exit(EXIT_FAILURE);
 	}
 
+	/* frames go through memory shared with wmasterd once it takes it */
+	if (transport.shm) {
+#ifdef SHM_SUPPORTED
+		if (shm_channel_create(&shm) < 0) {
+			perror("shm");
+			print_debug(LOG_ERR, "error: cannot create shared memory");
+		} else {
+			shmaddr_len = transport_addr(&transport, &shmaddr,
+					transport.host, TRANSPORT_SHM_PORT);
+			shm_ready = 1;
+		}
+#else
+		print_debug(LOG_ERR, "error: shared memory is not supported");
+#endif
+	}
+
 	/* send up notification to wmasterd */
 	msg_len = 2;
 	msg = malloc(msg_len);
@@ -2160,9 +2392,11 @@ int main(int argc, char *argv[])
 	memcpy(msg, "UP", msg_len);
 
 	pthread_mutex_lock(&send_mutex);
-	bytes = sendto(sockfd, msg, msg_len, 0,
-			(struct sockaddr *)&servaddr_vm,
-			sizeof(struct sockaddr));
+	bytes = send_to_master(msg, msg_len);
+#ifdef SHM_SUPPORTED
+	if (shm_ready)
+		shm_offer();
+#endif
 	pthread_mutex_unlock(&send_mutex);
 	free(msg);
 
@@ -2224,9 +2458,17 @@ int main(int argc, char *argv[])
 
 	print_debug(LOG_DEBUG, "Threads have been cancelled");
 
-	close(sockfd);
-	close(myservfd);
-	close(ioctl_fd);
+	if (sockfd >= 0)
+		transport_close(&transport, sockfd, node_id, 0);
+	/* the connection is both */
+	if (!transport.seqpacket)
+		transport_close(&transport, myservfd, node_id, RECV_PORT);
+#ifdef SHM_SUPPORTED
+	if (shm_ready)
+		shm_channel_free(&shm);
+#endif
+	if (ioctl_fd >= 0)
+		close(ioctl_fd);
 
 	print_debug(LOG_DEBUG, "Sockets have been closed");
 
@@ -206,7 +206,13 @@ void attrs_print(struct nlattr *attrs[]);
 static int process_messages_cb(struct nl_msg *, void *);
 int init_netlink(void);
 int send_register_msg(void);
+int send_to_master(char *, int);
+int connect_to_master(void);
+void shm_offer(void);
+void shm_check(void);
 void recv_from_master(void);
+void recv_from_master_shm(void);
+void process_master_frame(char *, int);
 void dellink(struct nlmsghdr *);
 void newlink(struct nlmsghdr *);
 static int process_nl_route_event(struct nl_msg *, void *);
@@ -30,6 +30,11 @@
  *	DM17-0952
  */
 
+#ifndef _WIN32
+/* for sendmmsg */
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
@@ -39,10 +44,12 @@
 #include <math.h>
 #include <errno.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stddef.h>
 #ifdef _WIN32
   #ifndef _WIN32_WINNT
     #define _WIN32_WINNT 0x0501  /* Windows XP. */
@@ -68,6 +75,12 @@
   #include <net/if.h>
   #include <sys/ioctl.h>
   #include <linux/vm_sockets.h>
+  #ifndef _ESX
+  #include <sys/epoll.h>
+  #include <sys/timerfd.h>
+  #include <sys/signalfd.h>
+  #include <sys/eventfd.h>
+  #endif
   #define IOCTL_VMCI_SOCKETS_GET_AF_VALUE    0x7b8
   #define sock_error perror
 #endif
@@ -83,6 +96,14 @@ __asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
 char broadcast_addr[16];
 /** Whether to broadcast frames to host subnet */
 int broadcast;
+/** hosts frames are forwarded to instead of broadcasting */
+struct peer peers[PEER_MAX];
+/** number of peers */
+int peer_count;
+/** socket frames and room lists are sent to peers from */
+int peer_fd = -1;
+/** when the rooms were last sent to peers */
+int peer_advertised;
 /** Port used to receive frames from welled or gelled */
 #define RECV_PORT       1111
 /** Port used to send frames to welled */
@@ -95,6 +116,10 @@ int broadcast;
 #define BUFF_LEN	10000
 /** Buffer size for VMX config file */
 #define LINE_BUF	8192
+/** Size of a pooled frame buffer, the job which relays it and the frame */
+#define FRAME_LEN	(sizeof(struct relay_job) + VMCI_BUFF_LEN)
+/** Frame held in a pooled buffer */
+#define FRAME_DATA(f)	((char *)(f) + sizeof(struct relay_job))
 
 /** mutex for linked list access */
 pthread_mutex_t list_mutex;
@@ -121,6 +146,8 @@ int check_room;
 int update_room;
 /** Whether to prepand distance to frames */
 int send_distance;
+/** Formula used for neighbour distances, DISTANCE_HAVERSINE or EQUIRECT */
+int distance_method;
 /** Whether to send PASHR statements */
 int send_pashr;
 /** Whether to use a cache file for locations */
@@ -135,12 +162,99 @@ int loglevel;
 int af;
 int sockfd;
 int myservfd;
-/** sockaddr_vm for vmci send */
-struct sockaddr_vm servaddr_vm;
-/** sockaddr_vm for vmci receive */
-struct sockaddr_vm myservaddr_vm;
+/** how frames reach welled, vsock unless -T says otherwise */
+struct transport transport;
 
 struct client *head;
+struct client *tail;
+/** index of the nodes in the linked list by CID */
+struct client_index cid_index;
+/** nodes waiting for their neighbour tables to be rebuilt */
+struct client **moved_nodes;
+/** number of nodes in moved_nodes */
+int moved_count;
+/** number of entries allocated in moved_nodes */
+int moved_size;
+/** table built for each node in moved_nodes */
+struct neighbour_table **moved_tables;
+/** neighbour refreshes done, tables are current for rooms changed before */
+unsigned long neighbour_epoch = 1;
+/** threads which rebuild neighbour tables */
+struct work_pool neighbour_pool;
+/** number of threads requested for neighbour_pool, 0 for one per cpu */
+int neighbour_threads;
+/** threads which share the fan-out of large rooms */
+struct work_pool fanout_pool;
+/** held by the thread using fanout_pool */
+pthread_mutex_t fanout_mutex;
+/** receivers from which fan-out uses fanout_pool, 0 to never use it */
+int fanout_threshold;
+/** buffer used by each worker of neighbour_pool */
+struct neighbour_scratch *neighbour_scratch;
+/** datagrams received from welled by the main thread */
+struct recv_batch recv_batch;
+/** buffers frames are received into and queued in */
+struct frame_pool frame_pool;
+/** queues of receivers whose socket buffers were full, hashed by CID */
+struct send_bucket send_queues[SENDQ_BUCKETS];
+/** number of send queues holding frames */
+int sendq_backlog;
+/** number of frames in all send queues */
+int sendq_frames;
+/** sends which failed with a transient error and were dropped */
+unsigned long send_transient;
+/** sends which failed with any other error */
+unsigned long send_errors;
+/** nodes removed because sending to them failed */
+unsigned long send_evictions;
+/** threads relaying the frames of their rooms */
+struct relay_worker *relay_workers;
+/** number of relay_workers, 0 to relay on the receiving thread */
+int relay_count;
+/** number of relay workers requested */
+int relay_threads;
+#ifdef HAVE_EPOLL
+/** descriptors the main thread waits on */
+struct reactor reactor;
+#endif
+#ifdef HAVE_CONN
+/** SOCK_SEQPACKET socket welled connect to, -1 with datagrams */
+int conn_fd = -1;
+/** connections from welled, hashed by CID */
+struct conn_bucket conn_clients[CONN_BUCKETS];
+/** number of connections */
+int conn_count;
+/** connection of each descriptor, used only by the main thread */
+struct conn_client **conn_by_fd;
+/** entries in conn_by_fd */
+int conn_by_fd_len;
+#endif
+#ifdef HAVE_SHM
+/** AF_UNIX socket welled on this host offer shared memory channels on */
+int shm_fd = -1;
+/** shared memory channels, hashed by CID */
+struct shm_bucket shm_clients[SHM_BUCKETS];
+/** number of shared memory channels */
+int shm_count;
+/** set when shm_drain ran out of receive buffers before the rings */
+int shm_pending;
+#endif
+/** whether -U asked for the io_uring backend */
+int use_uring;
+#ifdef HAVE_IO_URING
+/** io_uring rings, used only by the main thread */
+struct uring_backend uring_io;
+#endif
+/** deadlines of all nodes in the linked list */
+struct timer_wheel expiry_wheel;
+/** epoch time read once per loop of the main thread */
+int current_time;
+/** rooms which have or have had members */
+struct room *rooms;
+/** rooms indexed by the symbol id of their GUID */
+struct room **room_table;
+/** number of entries in room_table */
+int room_table_size;
 
 #ifdef _WIN32
 WSADATA wsa_data;
@@ -158,16 +272,25 @@ void show_usage(int exval)
 
 	printf("wmasterd - wireless master daemon\n\n");
 
-	printf("Usage: wmasterd [-hVvbrud] [-D <level>] [-c <file>]\n\n");
+	printf("Usage: wmasterd [-hVvbrudeU] [-t <threads>] [-w <workers>] [-F <receivers>] [-T <transport>] [-P <peer>]... [-D <level>] [-c <file>]\n\n");
 
 	printf("Options:\n");
 	printf("  -h, --help		print this help and exit\n");
 	printf("  -V, --version		print version and exit\n");
 	printf("  -v, --verbose		verbose output\n");
 	printf("  -b, --broadcast       broadcast frames to other hosts\n");
+	printf("  -P, --peer		send frames only to this host, address[:port],\n");
+	printf("			when it has members in their room, may be repeated\n");
 	printf("  -r, --no-room-check	do not check room id\n");
 	printf("  -u, --update-room     update room on receipt\n");
 	printf("  -d, --distance	prepend distance to frames\n");
+	printf("  -e, --equirect	faster approximate distances with -d\n");
+	printf("  -t, --threads		threads for neighbour rebuilds\n");
+	printf("  -w, --workers		relay threads, each room uses one\n");
+	printf("  -F, --fanout		receivers to spread fan-out over threads, 0 never\n");
+	printf("  -U, --io-uring	use io_uring for relay I/O\n");
+	printf("  -T, --transport	vsock, vsock-seq, udp[:<address>], unix:<directory>,\n");
+	printf("			unix-seq:<directory> or shm:<directory>\n");
 	printf("  -D, --debug		debug level for syslog\n");
 	printf("  -c, --cache		file to save location data\n\n");
 
@@ -202,24 +325,6 @@ void print_debug(int level, char *format, ...)
 	#endif
 }
 
-/**
- *      convert radians to degrees
- *      @param rad - angle in radians
- *      @return degrees
- */
-double radians_to_degrees(double rad) {
-	return (rad * 180 / M_PI);
-}
-
-/**
- *      convert degrees to radians
- *      @param deg - angle in degrees
- *      @return radians
- */
-double degrees_to_radians(double deg) {
-	return (deg * M_PI / 180);
-}
-
 /**
  *	Convert decimal degrees to decimal minutes
  *
@@ -313,13 +418,13 @@ void update_cache_file_info(struct client *node)
 
 		fprintf(cache_fp,
 			"%-11d %-36s %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-32s",
-			node->cid, node->room,
-			node->loc.latitude, node->loc.longitude,
-			node->loc.altitude,
+			node->cid, sym_name(node->room_id),
+			NODE_LAT(node), NODE_LON(node),
+			NODE_ALT(node),
 			node->loc.velocity,
 			node->loc.heading,
 			node->loc.pitch,
-			node->name);
+			sym_name(node->name_id));
 		fflush(cache_fp);
 	} else {
 		print_debug(LOG_ERR, "error: no match for node %d in cache file", node->cid);
@@ -375,13 +480,13 @@ void update_cache_file_location(struct client *node)
 
 		fprintf(cache_fp,
 			"%-11d %-36s %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-32s",
-			node->cid, node->room,
-			node->loc.latitude, node->loc.longitude,
-			node->loc.altitude,
+			node->cid, sym_name(node->room_id),
+			NODE_LAT(node), NODE_LON(node),
+			NODE_ALT(node),
 			node->loc.velocity,
 			node->loc.heading,
 			node->loc.pitch,
-			node->name);
+			sym_name(node->name_id));
 		fflush(cache_fp);
 	} else {
 		print_debug(LOG_WARNING, "no match for node %d in cache file",
@@ -401,31 +506,28 @@ void update_followers(struct client *node)
 	if (node == NULL)
 		return;
 
+	/* nothing can follow a node without a name */
+	if (node->name_id == SYM_NONE)
+		return;
+
 	curr = head;
 
 	while (curr != NULL) {
-		/* name is 1024 in header file - caution */
-		if ((strnlen(curr->loc.follow, FOLLOW_LEN) > 0) &&
-				(strncmp(curr->loc.follow, node->name,
-					FOLLOW_LEN - 1) == 0)) {
-			curr->loc.latitude = node->loc.latitude;
-			curr->loc.longitude = node->loc.longitude;
-			curr->loc.altitude = node->loc.altitude;
+		if (curr->loc.follow_id == node->name_id) {
+			NODE_LAT(curr) = NODE_LAT(node);
+			NODE_LON(curr) = NODE_LON(node);
+			NODE_ALT(curr) = NODE_ALT(node);
 			curr->loc.velocity = node->loc.velocity;
 			curr->loc.heading = node->loc.heading;
-			strncpy(curr->loc.nmea_zda,
-				node->loc.nmea_zda, NMEA_LEN);
-			strncpy(curr->loc.nmea_gga, node->loc.nmea_gga,
-				NMEA_LEN);
-			strncpy(curr->loc.nmea_rmc, node->loc.nmea_rmc,
-				NMEA_LEN);
-			if (send_pashr) {
-				strncpy(curr->loc.nmea_pashr, node->loc.nmea_rmc,
-					NMEA_LEN);
-			}
+			node_moved(curr);
+			/*
+			 * sentences belong to the nmea thread, which builds
+			 * them from this location on its next pass
+			 */
 			update_cache_file_location(curr);
 			print_debug(LOG_NOTICE, "follower %s synced to master %s",
-					curr->name, curr->loc.follow);
+					sym_name(curr->name_id),
+					sym_name(curr->loc.follow_id));
 		}
 		curr = curr->next;
 	}
@@ -462,6 +564,7 @@ void update_node_location(struct client *node, struct update_2 *data)
 	float angle;
 	float ms;
 	float overage;
+	int follow_id;
 
 	/* radius of earth in meters */
 	r = 6378137;
@@ -475,19 +578,21 @@ void update_node_location(struct client *node, struct update_2 *data)
 			print_debug(LOG_DEBUG, "follow exists in update");
 			if (strncmp(data->follow, "CLEAR", 5) == 0) {
 				print_debug(LOG_NOTICE, "clearing follow on %d", node->cid);
-				memset(node->loc.follow, 0, FOLLOW_LEN);
+				node->loc.follow_id = SYM_NONE;
 			} else {
-				strncpy(node->loc.follow,
-						data->follow, FOLLOW_LEN - 1);
+				follow_id = sym_intern(data->follow,
+						FOLLOW_LEN - 1);
+				if (follow_id >= 0)
+					node->loc.follow_id = follow_id;
 				print_debug(LOG_NOTICE, "set follow to %s on %d",
-						node->loc.follow, node->cid);
+						sym_name(node->loc.follow_id),
+						node->cid);
 			}
 		}
 
-		if (strnlen(node->loc.follow, FOLLOW_LEN) > 0) {
+		if (node->loc.follow_id != SYM_NONE) {
 			print_debug(LOG_DEBUG, "we need to update a master instead of this node");
-			struct client *master = search_node_name(node->loc.follow);
-			//node = search_node_name(node->loc.follow);
+			struct client *master = search_node_name(node->loc.follow_id);
 
 			/*
 			 * TODO: check windows
@@ -497,7 +602,8 @@ void update_node_location(struct client *node, struct update_2 *data)
 			if (!master) {
 				print_debug(LOG_INFO, "no master for follow on %d", node->cid);
 			} else {
-				print_debug(LOG_DEBUG, "node set to follow %s", node->loc.follow);
+				print_debug(LOG_DEBUG, "node set to follow %s",
+						sym_name(node->loc.follow_id));
 				print_debug(LOG_DEBUG, "update master instead");
 				node = master;
 			}
@@ -507,10 +613,10 @@ void update_node_location(struct client *node, struct update_2 *data)
 
 		if (verbose) {
 			printf("old position: %.8f %.8f\n",
-				node->loc.latitude, node->loc.longitude);
+				NODE_LAT(node), NODE_LON(node));
 			printf("old heading:  %f\n", node->loc.heading);
 			printf("old velocity: %f\n", node->loc.velocity);
-			printf("old altitude: %f\n", node->loc.altitude);
+			printf("old altitude: %f\n", NODE_ALT(node));
 			printf("old pitch:    %f\n", node->loc.pitch);
 		}
 
@@ -529,14 +635,14 @@ void update_node_location(struct client *node, struct update_2 *data)
 		/* update coordinates */
 		if ((data->latitude >= -90) &&
 				(data->latitude <= 90))
-			node->loc.latitude = data->latitude;
+			NODE_LAT(node) = data->latitude;
 		if ((data->longitude >= -180) &&
 				(data->longitude <= 180))
-			node->loc.longitude = data->longitude;
+			NODE_LON(node) = data->longitude;
 
 		/* update altitude */
 		if (data->altitude != -1)
-			node->loc.altitude = data->altitude;
+			NODE_ALT(node) = data->altitude;
 
 		/* correct bad values */
 		if (isnan(node->loc.heading)) {
@@ -545,25 +651,26 @@ void update_node_location(struct client *node, struct update_2 *data)
 		if (isnan(node->loc.velocity)) {
 			node->loc.velocity = 0;
 		}
-		if (isnan(node->loc.altitude)) {
-			node->loc.altitude = 0;
+		if (isnan(NODE_ALT(node))) {
+			NODE_ALT(node) = 0;
 		}
 		if (isnan(node->loc.pitch)) {
 			node->loc.pitch = 0;
 		}
 
-		int age = time(NULL) - node->time;
+		int age = time(NULL) - NODE_TIME(node);
 
 		print_debug(LOG_NOTICE,
 			"%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s",
-			node->cid, node->room, age,
-			node->loc.latitude, node->loc.longitude,
-			node->loc.altitude,
+			node->cid, sym_name(node->room_id), age,
+			NODE_LAT(node), NODE_LON(node),
+			NODE_ALT(node),
 			node->loc.velocity,
 			node->loc.heading,
 			node->loc.pitch,
-			node->name);
+			sym_name(node->name_id));
 
+		node_moved(node);
 		update_cache_file_location(node);
 		update_followers(node);
 
@@ -572,16 +679,16 @@ void update_node_location(struct client *node, struct update_2 *data)
 	}
 
 	/* followers get updated after master node, skip it here */
-	if (strnlen(node->loc.follow, FOLLOW_LEN) > 0) {
+	if (node->loc.follow_id != SYM_NONE) {
 		print_debug(LOG_DEBUG, "skipping update of follower %s",
-				node->name);
+				sym_name(node->name_id));
 		return;
 	}
 
 	/* do not update location if device is not moving */
 	if (node->loc.velocity == 0) {
 		print_debug(LOG_DEBUG, "skipping update with no velocity %s",
-				node->name);
+				sym_name(node->name_id));
 		return;
 	}
 
@@ -592,8 +699,8 @@ void update_node_location(struct client *node, struct update_2 *data)
 	if (isnan(node->loc.velocity)) {
 		node->loc.velocity = 0;
 	}
-	if (isnan(node->loc.altitude)) {
-		node->loc.altitude = 0;
+	if (isnan(NODE_ALT(node))) {
+		NODE_ALT(node) = 0;
 	}
 	if (isnan(node->loc.pitch)) {
 		node->loc.pitch = 0;
@@ -611,49 +718,49 @@ void update_node_location(struct client *node, struct update_2 *data)
 	dy = ms * cosf(angle);
 	dx = ms * sinf(angle);
 
-	node->loc.latitude += (dy / r) * (180 / M_PI);
-	node->loc.longitude += (dx / r) * (180 / M_PI) /
-		cosf(node->loc.latitude * (M_PI / 180));
+	NODE_LAT(node) += (dy / r) * (180 / M_PI);
+	NODE_LON(node) += (dx / r) * (180 / M_PI) /
+		cosf(NODE_LAT(node) * (M_PI / 180));
 
 	/* adjust heading, lat and lon as we cross north pole */
-	if (node->loc.latitude > 90) {
+	if (NODE_LAT(node) > 90) {
 		/* printf("wmasterd: crossing north pole\n"); */
-		overage = node->loc.latitude - 90;
-		node->loc.latitude = 90 - overage;
+		overage = NODE_LAT(node) - 90;
+		NODE_LAT(node) = 90 - overage;
 		if (node->loc.heading < 90)
 			node->loc.heading += 180;
 		else if (node->loc.heading > 270)
 			node->loc.heading -= 180;
-		if (node->loc.longitude < 0)
-			node->loc.longitude += 180;
+		if (NODE_LON(node) < 0)
+			NODE_LON(node) += 180;
 		else
-			node->loc.longitude -= 180;
+			NODE_LON(node) -= 180;
 	}
 
 	/* adjust heading, lat and lon as we cross south pole */
-	if (node->loc.latitude < -90) {
+	if (NODE_LAT(node) < -90) {
 		/* printf("wmasterd: crossing south pole\n"); */
-		overage = node->loc.latitude + 90;
-		node->loc.latitude = -90 - overage;
+		overage = NODE_LAT(node) + 90;
+		NODE_LAT(node) = -90 - overage;
 		if (node->loc.heading > 90)
 			node->loc.heading += 180;
 		else if (node->loc.heading < 270)
 			node->loc.heading -= 180;
-		if (node->loc.longitude < 0)
-			node->loc.longitude += 180;
+		if (NODE_LON(node) < 0)
+			NODE_LON(node) += 180;
 		else
-			node->loc.longitude -= 180;
+			NODE_LON(node) -= 180;
 	}
 
 	/* adjust longitude as we cross east to west */
-	if (node->loc.longitude > 180) {
+	if (NODE_LON(node) > 180) {
 		/* printf("wmasterd: crossing prime meridian\n"); */
-		node->loc.longitude -= 360;
+		NODE_LON(node) -= 360;
 	}
 	/* adjust longitude as we cross west to east */
-	if (node->loc.longitude < -180) {
+	if (NODE_LON(node) < -180) {
 		/* printf("wmasterd: crossing dateline\n"); */
-		node->loc.longitude += 360;
+		NODE_LON(node) += 360;
 	}
 
 	/* keep heading less than 360 */
@@ -665,17 +772,18 @@ void update_node_location(struct client *node, struct update_2 *data)
 		angle = node->loc.pitch;
 		angle *= M_PI / 180;
 		dv = ms * sinf(angle);
-		node->loc.altitude += dv;
+		NODE_ALT(node) += dv;
 	}
 
-	int age = time(NULL) - node->time;
+	int age = time(NULL) - NODE_TIME(node);
 	print_debug(LOG_NOTICE,
 		"%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s",
-		node->cid, node->room, age,
-		node->loc.latitude, node->loc.longitude, node->loc.altitude,
+		node->cid, sym_name(node->room_id), age,
+		NODE_LAT(node), NODE_LON(node), NODE_ALT(node),
 		node->loc.velocity, node->loc.heading, node->loc.pitch,
-		node->name);
+		sym_name(node->name_id));
 
+	node_moved(node);
 	update_cache_file_location(node);
 	update_followers(node);
 
@@ -707,11 +815,16 @@ unsigned int nmea_checksum(char *input)
 
 /**
  *	Creates an NMEA sentence based on a struct location
- *	@param node - struct client for node
+ *	only called through send_gps_to_nodes, whose thread owns the
+ *	sentence buffers: the reactor thread from run_tick in epoll builds,
+ *	the produce_nmea thread in select builds (ESXi, Windows)
+ *	@param set - published members of the room of the node
+ *	@param pos - position of the node in set
  *	@return - pointer to new NMEA sentence
  */
-void create_new_sentences(struct client *node)
+void create_new_sentences(struct member_set *set, int pos)
 {
+	struct client *node;
 	time_t now;
 	struct tm *tmp;
 	char timestamp[10];
@@ -722,6 +835,8 @@ void create_new_sentences(struct client *node)
 	char lat[12];
 	char lon[13];
 
+	node = set->members[pos];
+
 	memset(node->loc.nmea_zda, 0, NMEA_LEN);
 	memset(node->loc.nmea_gga, 0, NMEA_LEN);
 	memset(node->loc.nmea_rmc, 0, NMEA_LEN);
@@ -746,8 +861,6 @@ void create_new_sentences(struct client *node)
 		strftime(rmc_date, 7, "%d%m%y", tmp);
 	}
 
-	update_node_location(node, NULL);
-
 /*
 $GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47
 Where:
@@ -871,8 +984,8 @@ Q2 IMU Status
 	snprintf(node->loc.nmea_gsv3, NMEA_LEN, "$GPGSV,3,3,12,46,36,205,37,20,39,094,11,32,64,043,39,04,67,247,*71");
 */
 
-	dec_deg_to_dec_min(node->loc.latitude, lat, 12);
-	dec_deg_to_dec_min(node->loc.longitude, lon, 13);
+	dec_deg_to_dec_min(set->latitude[pos], lat, 12);
+	dec_deg_to_dec_min(set->longitude[pos], lon, 13);
 
 	/* ZDA */
 	memset(temp, 0, NMEA_LEN);
@@ -888,7 +1001,7 @@ Q2 IMU Status
 
 	/* GGA */
 	memset(temp, 0, NMEA_LEN);
-	snprintf(temp, NMEA_LEN, "GPGGA,%s,%s,%s,2,09,1.0,%05.2f,M,0,M,0,0", timestamp, lat, lon, node->loc.altitude);
+	snprintf(temp, NMEA_LEN, "GPGGA,%s,%s,%s,2,09,1.0,%05.2f,M,0,M,0,0", timestamp, lat, lon, set->altitude[pos]);
 	checksum = nmea_checksum(temp);
 	snprintf(node->loc.nmea_gga, NMEA_LEN, "$%s*%2X", temp, checksum);
 
@@ -933,117 +1046,103 @@ void *read_console(void *arg)
 }
 
 /**
- *	Send NMEA sentence for current location to all nodes
+ *	Send NMEA sentences for its current location to a single node
+ *	@param set - published members of the room of the node
+ *	@param pos - position of the node in set
+ *	@return 0 if sent or dropped, -1 if the node was removed from the list
  */
-void send_gps_to_nodes(void)
+int send_gps_to_node(struct member_set *set, int pos)
 {
 	struct client *curr;
-	struct client *temp;
+	union transport_addr addr;
+	socklen_t addrlen;
 	int bytes;
 	char *buf;
 	int ret;
 
-	pthread_mutex_lock(&list_mutex);
-	curr = head;
-	bytes = 0;
+	curr = set->members[pos];
 
-	while (curr != NULL) {
+	/* update coordinates */
+	create_new_sentences(set, pos);
 
-		/* update coordinates */
-		create_new_sentences(curr);
+	/* send rmc */
+	buf = curr->loc.nmea_rmc;
+	bytes = strlen(buf);
 
-		/* send rmc */
-		buf = curr->loc.nmea_rmc;
-		bytes = strlen(buf);
+	/* without datagrams there is no way to reach gelled */
+	if (sockfd < 0)
+		return 0;
 
-		/* rmc is minumum required nav data */
-		memset(&servaddr_vm, 0, sizeof(servaddr_vm));
-		servaddr_vm.svm_cid = curr->cid;
-		servaddr_vm.svm_port = SEND_PORT_G;
-		servaddr_vm.svm_family = af;
+	/* rmc is minumum required nav data */
+	addrlen = transport_addr(&transport, &addr, set->cid[pos], SEND_PORT_G);
 
-		/* send frame to this welled client */
-		ret = sendto(sockfd, (char *)buf, bytes, 0,
-				(struct sockaddr *)&servaddr_vm,
-				sizeof(struct sockaddr));
-		if (ret < 0) {
-			print_debug(LOG_NOTICE, "del: %11d room: %36s time: %d name: %s", curr->cid, curr->room, curr->time, curr->name);
+	/* send frame to this welled client */
+	ret = sendto(sockfd, (char *)buf, bytes, SEND_DONTWAIT,
+			&addr.sa, addrlen);
+	if (ret < 0) {
+		/*
+		 * the rest of the sentences are dropped, the node gets
+		 * new ones next tick unless the error removes it
+		 */
+		if (send_failed(set->cid[pos], bytes))
+			return -1;
+		return 0;
+	}
 
-			if (verbose)
-				sock_error("wmasterd: sendto");
+	print_debug(LOG_DEBUG, "sent %d/%d bytes: %s", ret, bytes, buf);
+	/* transmission successful, send gga */
+	/* gga provides altitude */
+	buf = curr->loc.nmea_gga;
+	bytes = strlen(buf);
+	sendto(sockfd, (char *)buf, bytes, SEND_DONTWAIT,
+		&addr.sa, addrlen);
 
-			/*
-			 * since powering off a VM results in this error
-			 * we remove the node from list
-			 */
-			temp = curr->next;
-			remove_node_vmci(curr->cid);
-			curr = temp;
-		} else {
-			print_debug(LOG_DEBUG, "sent %d/%d bytes: %s", ret, bytes, buf);
-			/* transmission successful, send gga */
-			/* gga provides altitude */
-			buf = curr->loc.nmea_gga;
-			bytes = strlen(buf);
-			sendto(sockfd, (char *)buf, bytes, 0,
-				(struct sockaddr *)&servaddr_vm,
-				sizeof(struct sockaddr));
-
-			if (send_pashr) {
-				/* send the PASHR message with pitch */
-				buf = curr->loc.nmea_pashr;
-				bytes = strlen(buf);
-				sendto(sockfd, (char *)buf, bytes, 0,
-					(struct sockaddr *)&servaddr_vm,
-					sizeof(struct sockaddr));
-			}
-		}
-		if (curr != NULL)
-			curr = curr->next;
+	if (send_pashr) {
+		/* send the PASHR message with pitch */
+		buf = curr->loc.nmea_pashr;
+		bytes = strlen(buf);
+		sendto(sockfd, (char *)buf, bytes, SEND_DONTWAIT,
+			&addr.sa, addrlen);
 	}
-	pthread_mutex_unlock(&list_mutex);
+
+	return 0;
 }
 
 /**
- *	Calculates the distance between two nodes
- *	@param node1 - struct for first node
- *	@param node2 - struct for second node
+ *	Send NMEA sentence for current location to all nodes, room by room
+ *	list_mutex is only held while moving the nodes and refreshing their
+ *	neighbours, the sentences are built and sent from the published
+ *	member sets
  */
-int get_distance(struct client *node1, struct client *node2)
+void send_gps_to_nodes(void)
 {
-	int distance;
-	double lat1;
-	double lon1;
-	double lat2;
-	double lon2;
-	double theta;
-	double dist;
-	double a;
-	double c;
+	struct member_set *set;
+	struct client *curr;
+	struct room *room;
+	int i;
 
-	lat1 = node1->loc.latitude;
-	lon1 = node1->loc.longitude;
-	lat2 = node2->loc.latitude;
-	lon2 = node2->loc.longitude;
+	pthread_mutex_lock(&list_mutex);
 
-	a = degrees_to_radians(lat1);
-	c = degrees_to_radians(lat2);
+	for (curr = head; curr != NULL; curr = curr->next)
+		update_node_location(curr, NULL);
 
-	theta = degrees_to_radians(lon1 - lon2);
-	dist = sin(a) * sin(c) + cos(a) * cos(c) * cos(theta);
-	dist = acos(dist);
-	dist = radians_to_degrees(dist);
-	dist = dist * 60 * 1.1515;
-	dist = dist * 1.609344;
-	dist = dist * 1000;
+	/* this is the end of a movement epoch */
+	refresh_neighbours();
 
-	distance = dist;
+	pthread_mutex_unlock(&list_mutex);
 
-	print_debug(LOG_DEBUG, "%d meters between %s and %s",
-			distance, node1->name, node2->name);
+	epoch_enter();
 
+	for (room = __atomic_load_n(&rooms, __ATOMIC_ACQUIRE); room != NULL;
+			room = room->next) {
+		set = __atomic_load_n(&room->set, __ATOMIC_ACQUIRE);
+		if (set == NULL)
+			continue;
+		for (i = 0; i < set->count; i++)
+			send_gps_to_node(set, i);
+	}
 
-	return distance;
+	epoch_exit();
 }
 
 #ifndef _WIN32
@@ -1311,7 +1410,6 @@ void add_node_vmci(unsigned int srchost, char *vm_room, char *vm_name, char *uui
 	print_debug(LOG_NOTICE, "adding node");
 
 	struct client *node;
-	struct client *curr;
 	char buf[1024];
 	unsigned int cid;
 	double lat;
@@ -1327,26 +1425,50 @@ void add_node_vmci(unsigned int srchost, char *vm_room, char *vm_name, char *uui
 
 	matched = 0;
 
+	/* the list and index must hold only one node per CID */
+	if (cid_index_lookup(srchost) != NULL)
+		remove_node_vmci(srchost);
+
 	/* create new node */
 	node = malloc(sizeof(struct client));
 	node->cid = srchost;
 	node->next = NULL;
-	node->time = time(NULL);
+	node->prev = NULL;
+	node->bucket = NULL;
+	node->bucket_pos = 0;
+	node->neighbours = NULL;
+	node->moved = 0;
+	node->send_failures = 0;
+	node->failed_at = 0;
+	memset(&node->expiry, 0, sizeof(struct tw_entry));
 	memset(&node->loc, 0, sizeof(struct location));
-	memset(node->name, 0, NAME_LEN);
 	memset(node->uuid, 0, UUID_LEN);
-	memset(node->room, 0, UUID_LEN);
-	strncpy(node->name, vm_name, NAME_LEN - 1);
 	strncpy(node->uuid, uuid, UUID_LEN - 1);
-	strncpy(node->room, vm_room, UUID_LEN - 1);
+	node->tag_id = SYM_NONE;
+	node->loc.follow_id = SYM_NONE;
+	node->room_id = sym_intern(vm_room, UUID_LEN - 1);
+	node->name_id = sym_intern(vm_name, NAME_LEN - 1);
+	if ((node->room_id < 0) || (node->name_id < 0)) {
+		print_debug(LOG_ERR, "error: could not intern room or name for %11d",
+				srchost);
+		free(node);
+		return;
+	}
+
+	/* the room holds the time stamp and location of the node */
+	if (room_add_member(node) < 0) {
+		print_debug(LOG_ERR, "error: could not add node %11d to room %s",
+				srchost, sym_name(node->room_id));
+		free(node);
+		return;
+	}
 
 	/* default to med sea */
-	node->loc.latitude = 35;	/* DD.DDDD*/
-	node->loc.longitude = 35;       /* DD.DDDD*/
-	node->loc.altitude = 0;		/* meters */
+	NODE_LAT(node) = 35;	/* DD.DDDD*/
+	NODE_LON(node) = 35;       /* DD.DDDD*/
+	NODE_ALT(node) = 0;		/* meters */
 	node->loc.velocity = 0;		/* knots */
 	node->loc.heading = 0;		/* degrees */
-	node->loc.altitude = 0;		/* meters */
 	node->loc.pitch = 0;		/* degrees */
 
 	/* add node to cache file */
@@ -1377,15 +1499,18 @@ void add_node_vmci(unsigned int srchost, char *vm_room, char *vm_name, char *uui
 			} else if (cid == srchost) {
 				matched = 1;
 				/* load values from cache file */
-				node->loc.latitude = lat;	/* DD.DDDD*/
-				node->loc.longitude = lon;	/* DD.DDDD*/
-				node->loc.altitude = alt;	/* meters */
+				NODE_LAT(node) = lat;	/* DD.DDDD*/
+				NODE_LON(node) = lon;	/* DD.DDDD*/
+				NODE_ALT(node) = alt;	/* meters */
 				node->loc.velocity = sog;	/* knots */
 				node->loc.heading = cog;	/* degrees */
 				node->loc.pitch = pit;		/* degrees */
-				if (strnlen(vm_name, NAME_LEN) == 0) {
-					strncpy(node->name, name,
-						strnlen(name, NAME_LEN - 1));
+				if ((node->name_id == SYM_NONE) &&
+						(ret == 9)) {
+					node->name_id = sym_intern(name,
+						NAME_LEN - 1);
+					if (node->name_id < 0)
+						node->name_id = SYM_NONE;
 				}
 				break;
 			}
@@ -1397,13 +1522,13 @@ void add_node_vmci(unsigned int srchost, char *vm_room, char *vm_name, char *uui
 			fseek(cache_fp, 0, SEEK_END);
 			fprintf(cache_fp,
 				"%-11d %-36s %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-32s\n",
-				node->cid, node->room,
-				node->loc.latitude, node->loc.longitude,
-				node->loc.altitude,
+				node->cid, sym_name(node->room_id),
+				NODE_LAT(node), NODE_LON(node),
+				NODE_ALT(node),
 				node->loc.velocity,
 				node->loc.heading,
 				node->loc.pitch,
-				node->name);
+				sym_name(node->name_id));
 			fflush(cache_fp);
 		}
 
@@ -1411,686 +1536,4690 @@ void add_node_vmci(unsigned int srchost, char *vm_room, char *vm_name, char *uui
 	}
 
 
+	node_moved(node);
+
+	if (cid_index_insert(node) < 0) {
+		print_debug(LOG_ERR, "error: could not index node %11d", srchost);
+		node_unmark(node);
+		room_remove_member(node);
+		/* readers may have seen it in the room */
+		epoch_retire(node, free);
+		return;
+	}
+
+	tw_add(&expiry_wheel, &node->expiry,
+		NODE_TIME(node) + NODE_TIMEOUT + 1);
+
 	if (head == NULL) {
 		/* add first node */
 		head = node;
-		print_debug(LOG_NOTICE, "add: %11d room: %36s time: %d name: %s", srchost, node->room, node->time, node->name);
 	} else {
-		/* traverse to end of list */
-		curr = head;
-		while (curr->next != NULL)
-			curr = curr->next;
 		/* add to node to end of list */
-		curr->next = node;
-		print_debug(LOG_NOTICE, "add: %11d room: %36s time: %d name: %s", srchost, node->room, node->time, node->name);
+		tail->next = node;
+		node->prev = tail;
 	}
+	tail = node;
+	print_debug(LOG_NOTICE, "add: %11d room: %36s time: %d name: %s", srchost, sym_name(node->room_id), NODE_TIME(node), sym_name(node->name_id));
 }
 
 /**
- *	@brief Removes old, presumably inactive nodes
+ *	@brief Called by the expiry wheel when a node reaches its deadline
+ *	frames do not move the deadline, so a node which has been heard from
+ *	since it was scheduled is simply scheduled again
+ *	@param entry - expiry entry of the node
  *	@return void
  */
-void clear_inactive_nodes(void)
+void expire_node(struct tw_entry *entry)
 {
-	struct client *curr;
-	struct client *prev;
+	struct client *node;
 	int age;
-	int now;
 
-	age = 0;
-	curr = head;
-	prev = NULL;
-	now = time(NULL);
+	node = (struct client *)((char *)entry -
+			offsetof(struct client, expiry));
 
-	while (curr != NULL) {
-		age = now - curr->time;
-		if (age > 300) {
-			print_debug(LOG_INFO, "node: %11d stale at %d sec",
-					curr->cid, age);
-			/* delete node */
-			if (prev == NULL)
-				head = curr->next;
-			else
-				prev->next = curr->next;
+#ifdef HAVE_CONN
+	/* a connected node is removed when its connection closes */
+	if (conn_connected(node->cid)) {
+		tw_add(&expiry_wheel, &node->expiry,
+			current_time + NODE_TIMEOUT);
+		return;
+	}
+#endif
 
-			print_debug(LOG_NOTICE, "del: %11d room: %36s time: %d name: %s", curr->cid, curr->room, curr->time, curr->name);
-			free(curr);
-			print_debug(LOG_DEBUG, "removed stale node");
-			return;
-		}
-		prev = curr;
-		curr = curr->next;
+	age = current_time - NODE_TIME(node);
+	if (age <= NODE_TIMEOUT) {
+		tw_add(&expiry_wheel, &node->expiry,
+			NODE_TIME(node) + NODE_TIMEOUT + 1);
+		return;
 	}
+
+	print_debug(LOG_INFO, "node: %11d stale at %d sec", node->cid, age);
+	/* delete node */
+	remove_node_vmci(node->cid);
+	print_debug(LOG_DEBUG, "removed stale node");
 }
 
 /**
- *	@brief Searches the linked list for a given node
- *	@param srchost - CID of the guest
- *	@return returns the node
+ *	@brief Removes old, presumably inactive nodes
+ *	only nodes whose deadline has passed are visited
+ *	@return void
  */
-struct client *search_node_vmci(unsigned int srchost)
+void clear_inactive_nodes(void)
 {
-	struct client *curr;
+	tw_advance(&expiry_wheel, current_time, expire_node);
+}
 
-	curr = head;
+/**
+ *	@brief Mixes the bits of a CID for use as a hash table position
+ *	CIDs are often handed out sequentially so they are spread with a
+ *	finalizer rather than used directly
+ *	@param cid - CID of the guest
+ *	@return hash of the CID
+ */
+unsigned int cid_hash(unsigned int cid)
+{
+	cid ^= cid >> 16;
+	cid *= 0x7feb352d;
+	cid ^= cid >> 15;
+	cid *= 0x846ca68b;
+	cid ^= cid >> 16;
 
-	while (curr != NULL) {
-		if (curr->cid == srchost) {
-			curr->time = time(NULL);
-			return curr;
-		}
-		curr = curr->next;
+	return cid;
+}
+
+/**
+ *	@brief Resizes the CID index and rehashes all nodes into it
+ *	@param size - new number of slots, must be a power of two
+ *	@return 0 on success, -1 on failure
+ */
+int cid_index_grow(unsigned int size)
+{
+	struct client_slot *old_slots;
+	unsigned int old_size;
+	unsigned int pos;
+	unsigned int i;
+
+	old_slots = cid_index.slots;
+	old_size = cid_index.size;
+
+	cid_index.slots = calloc(size, sizeof(struct client_slot));
+	if (!cid_index.slots) {
+		perror("wmasterd: calloc");
+		cid_index.slots = old_slots;
+		return -1;
 	}
+	cid_index.size = size;
 
-	return NULL;
+	for (i = 0; i < old_size; i++) {
+		if (old_slots[i].node == NULL)
+			continue;
+		pos = cid_hash(old_slots[i].cid) & (size - 1);
+		while (cid_index.slots[pos].node != NULL)
+			pos = (pos + 1) & (size - 1);
+		cid_index.slots[pos] = old_slots[i];
+	}
+
+	free(old_slots);
+
+	print_debug(LOG_DEBUG, "cid index resized to %u slots", size);
+
+	return 0;
 }
 
 /**
- *
+ *	@brief Adds a node to the CID index, replacing any node with the same CID
+ *	@param node - the node to index
+ *	@return 0 on success, -1 on failure
  */
-struct client *search_node_name(char *name)
+int cid_index_insert(struct client *node)
 {
-	struct client *curr;
-
-	curr = head;
+	unsigned int pos;
+	unsigned int mask;
+
+	/* keep the table at most half full so probe runs stay short */
+	if ((cid_index.count + 1) * 2 > cid_index.size) {
+		if (cid_index_grow(cid_index.size ? cid_index.size * 2 :
+				CID_INDEX_MIN) < 0)
+			return -1;
+	}
 
-	print_debug(LOG_DEBUG, "searching for node with name %s", name);
+	mask = cid_index.size - 1;
+	pos = cid_hash(node->cid) & mask;
 
-	while (curr != NULL) {
-		if (strncmp(curr->name, name, NAME_LEN - 1) == 0) {
-			return curr;
+	while (cid_index.slots[pos].node != NULL) {
+		if (cid_index.slots[pos].cid == node->cid) {
+			cid_index.slots[pos].node = node;
+			return 0;
 		}
-		curr = curr->next;
+		pos = (pos + 1) & mask;
 	}
 
-	print_debug(LOG_DEBUG, "no node found with name %s", name);
+	cid_index.slots[pos].cid = node->cid;
+	cid_index.slots[pos].node = node;
+	cid_index.count++;
 
-	return NULL;
+	return 0;
 }
 
-void print_node(struct client *node)
+/**
+ *	@brief Finds a node in the CID index
+ *	@param cid - CID of the guest
+ *	@return the node or NULL if not indexed
+ */
+struct client *cid_index_lookup(unsigned int cid)
 {
-	printf("%d\n", node->cid);
-	printf("%s\n", node->name);
-	printf("%s\n", node->room);
-	printf("%d\n", node->time);
-	printf("%f\n", node->loc.latitude);
-	printf("%f\n", node->loc.longitude);
-	printf("%f\n", node->loc.altitude);
-	printf("%f\n", node->loc.velocity);
-	printf("%f\n", node->loc.heading);
-	printf("%f\n", node->loc.pitch);
+	unsigned int pos;
+	unsigned int mask;
+
+	if (cid_index.count == 0)
+		return NULL;
+
+	mask = cid_index.size - 1;
+	pos = cid_hash(cid) & mask;
+
+	while (cid_index.slots[pos].node != NULL) {
+		if (cid_index.slots[pos].cid == cid)
+			return cid_index.slots[pos].node;
+		pos = (pos + 1) & mask;
+	}
+
+	return NULL;
 }
 
 /**
- *	@brief Lists the nodes in the linked list
+ *	@brief Removes a node from the CID index
+ *	entries after the hole are shifted back so no tombstones are needed
+ *	@param cid - CID of the guest
  *	@return void
  */
-void list_nodes_vmci(void)
+void cid_index_remove(unsigned int cid)
 {
-	struct client *curr;
-	FILE *fp;
-	int age;
+	unsigned int pos;
+	unsigned int next;
+	unsigned int home;
+	unsigned int mask;
 
-	curr = head;
-	fp = fopen("/tmp/wmasterd.status", "w");
+	if (cid_index.count == 0)
+		return;
 
-	if (!fp && esx) {
-		perror("wmasterd: fopen");
-		print_debug(LOG_WARNING, "could not open /tmp/wmasterd.status\n");
-	}
+	mask = cid_index.size - 1;
+	pos = cid_hash(cid) & mask;
 
-	printf("node:       room:				age: lat:      lon:       alt:   sog:       cog: pitch: name:\n");
+	while (cid_index.slots[pos].node != NULL) {
+		if (cid_index.slots[pos].cid == cid)
+			break;
+		pos = (pos + 1) & mask;
+	}
 
-	if (fp)
-		fprintf(fp, "node:       room:				age: lat:      lon:       alt:   sog:     cog:   pitch: name:\n");
+	if (cid_index.slots[pos].node == NULL)
+		return;
 
-	while (curr != NULL) {
-		age = time(NULL) - curr->time;
-		printf("%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s\n",
-			curr->cid, curr->room, age,
-			curr->loc.latitude, curr->loc.longitude,
-			curr->loc.altitude,
-			curr->loc.velocity,
-			curr->loc.heading,
-			curr->loc.pitch,
-			curr->name);
-		if (fp) {
-			fprintf(fp, "%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s\n",
-				curr->cid, curr->room, age,
-				curr->loc.latitude, curr->loc.longitude,
-				curr->loc.altitude,
-				curr->loc.velocity,
-				curr->loc.heading,
-				curr->loc.pitch,
-				curr->name);
+	cid_index.slots[pos].node = NULL;
+	cid_index.count--;
+
+	/* move back any entry whose probe run crosses the hole */
+	next = (pos + 1) & mask;
+	while (cid_index.slots[next].node != NULL) {
+		home = cid_hash(cid_index.slots[next].cid) & mask;
+		if (((next - home) & mask) >= ((next - pos) & mask)) {
+			cid_index.slots[pos] = cid_index.slots[next];
+			cid_index.slots[next].node = NULL;
+			pos = next;
 		}
-		curr = curr->next;
+		next = (next + 1) & mask;
 	}
-
-	if (fp)
-		fclose(fp);
 }
 
 /**
- *	@brief Removed a node from the linked list
- *	@param dsthost - CID of the guest
+ *	@brief Releases the CID index
  *	@return void
  */
-void remove_node_vmci(unsigned int dsthost)
+void cid_index_free(void)
 {
-	struct client *curr;
-	struct client *prev;
-	char name[NAME_LEN];
-	char room[UUID_LEN];
-	int time;
+	free(cid_index.slots);
+	cid_index.slots = NULL;
+	cid_index.size = 0;
+	cid_index.count = 0;
+}
 
-	time = 0;
-	memset(name, 0, NAME_LEN);
-	memset(room, 0, UUID_LEN);
-	curr = head;
-	prev = NULL;
+/**
+ *	@brief Finds a room by the symbol id of its GUID
+ *	safe to call without list_mutex from a read section
+ *	@param room_id - symbol id of the room
+ *	@return the room or NULL if it has never had members
+ */
+struct room *search_room(int room_id)
+{
+	struct room **table;
+	int size;
 
-	/* traverse while not null and no match */
-	while (curr != NULL && !(curr->cid == dsthost)) {
-		prev = curr;
-		curr = curr->next;
+	/* the size is published after the table it describes */
+	size = __atomic_load_n(&room_table_size, __ATOMIC_ACQUIRE);
+	table = __atomic_load_n(&room_table, __ATOMIC_ACQUIRE);
+
+	if ((room_id < 0) || (room_id >= size))
+		return NULL;
+
+	return __atomic_load_n(&table[room_id], __ATOMIC_ACQUIRE);
+}
+
+/**
+ *	@brief Adds a room to the room list and room table
+ *	@param room_id - symbol id of the room
+ *	@return the new room or NULL on failure
+ */
+struct room *add_room(int room_id)
+{
+	struct room *new_room;
+	struct room **table;
+	struct room **old;
+	int size;
+
+	if (room_id < 0)
+		return NULL;
+
+	/* the table is indexed by symbol id so grow it past room_id */
+	if (room_id >= room_table_size) {
+		size = room_table_size ? room_table_size : 64;
+		while (size <= room_id)
+			size *= 2;
+		table = calloc(size, sizeof(struct room *));
+		if (!table) {
+			perror("wmasterd: calloc");
+			return NULL;
+		}
+		if (room_table_size)
+			memcpy(table, room_table,
+				room_table_size * sizeof(struct room *));
+
+		/* readers may still be looking in the old table */
+		old = room_table;
+		__atomic_store_n(&room_table, table, __ATOMIC_RELEASE);
+		__atomic_store_n(&room_table_size, size, __ATOMIC_RELEASE);
+		epoch_retire(old, free);
 	}
 
-	/* exit if we hit the end of the list */
-	if (curr == NULL) {
-		print_debug(LOG_INFO, "node not found: %11d\n", dsthost);
-		return;
+	new_room = calloc(1, sizeof(struct room));
+	if (!new_room) {
+		perror("wmasterd: calloc");
+		return NULL;
 	}
 
-	strncpy(room, curr->room, strnlen(curr->room, UUID_LEN - 1));
-	strncpy(name, curr->name, strnlen(curr->name, NAME_LEN - 1));
-	time = curr->time;
+	new_room->room_id = room_id;
+	new_room->next = rooms;
+	__atomic_store_n(&room_table[room_id], new_room, __ATOMIC_RELEASE);
+	__atomic_store_n(&rooms, new_room, __ATOMIC_RELEASE);
 
-	/* delete node */
-	if (prev == NULL)
-		head = curr->next;
-	else
-		prev->next = curr->next;
+	print_debug(LOG_INFO, "room %s added", sym_name(room_id));
 
-	free(curr);
+	return new_room;
+}
 
-	print_debug(LOG_NOTICE, "del: %11d room: %36s time: %d name: %s",
-		dsthost, room, time, name);
+/**
+ *	@brief Allocates a member set and its arrays in one block
+ *	@param count - number of members in the set
+ *	@return the set or NULL on failure
+ */
+struct member_set *member_set_alloc(int count)
+{
+	struct member_set *set;
+	int buckets;
+	char *p;
+
+	buckets = 1;
+	while (buckets < count)
+		buckets *= 2;
+
+	set = malloc(sizeof(struct member_set) + count *
+			(4 * sizeof(double) + sizeof(struct client *) +
+			 2 * sizeof(unsigned int) + 2 * sizeof(int) +
+			 3 * sizeof(float)) + buckets * sizeof(int));
+	if (!set) {
+		perror("wmasterd: malloc");
+		return NULL;
+	}
+
+	/* widest types go first so every array is aligned */
+	p = (char *)(set + 1);
+	set->count = count;
+	set->sin_lat = (double *)p;
+	p += count * sizeof(double);
+	set->cos_lat = (double *)p;
+	p += count * sizeof(double);
+	set->sin_lon = (double *)p;
+	p += count * sizeof(double);
+	set->cos_lon = (double *)p;
+	p += count * sizeof(double);
+	set->members = (struct client **)p;
+	p += count * sizeof(struct client *);
+	set->cid = (unsigned int *)p;
+	p += count * sizeof(unsigned int);
+	set->time = (int *)p;
+	p += count * sizeof(int);
+	set->latitude = (float *)p;
+	p += count * sizeof(float);
+	set->longitude = (float *)p;
+	p += count * sizeof(float);
+	set->altitude = (float *)p;
+	p += count * sizeof(float);
+	set->cell = (unsigned int *)p;
+	p += count * sizeof(unsigned int);
+	set->cell_next = (int *)p;
+	p += count * sizeof(int);
+	set->cell_head = (int *)p;
+	set->buckets = buckets;
+
+	return set;
 }
 
 /**
- *      @brief Display a hex dump of the passed buffer
- *      this function was pulled off the web somehwere... seems to throw a
- *      segfault when printing some of the netlink error message data
- *      @param addr - address of buffer
- *      @param len - size of buffer
- *      @return void - assumes success
+ *	@brief Copies the first members of one set into another
+ *	@param dst - the set to copy into
+ *	@param src - the set to copy from
+ *	@param count - number of members to copy
+ *	@return void
  */
-void hex_dump(void *addr, int len)
+static void member_set_copy(struct member_set *dst, struct member_set *src,
+		int count)
 {
-	int i;
-	unsigned char buff[17];
-	unsigned char *pc;
+	memcpy(dst->members, src->members, count * sizeof(struct client *));
+	memcpy(dst->cid, src->cid, count * sizeof(unsigned int));
+	memcpy(dst->time, src->time, count * sizeof(int));
+	memcpy(dst->latitude, src->latitude, count * sizeof(float));
+	memcpy(dst->longitude, src->longitude, count * sizeof(float));
+	memcpy(dst->altitude, src->altitude, count * sizeof(float));
+	memcpy(dst->sin_lat, src->sin_lat, count * sizeof(double));
+	memcpy(dst->cos_lat, src->cos_lat, count * sizeof(double));
+	memcpy(dst->sin_lon, src->sin_lon, count * sizeof(double));
+	memcpy(dst->cos_lon, src->cos_lon, count * sizeof(double));
+}
 
-	pc = (unsigned char *)addr;
+/**
+ *	@brief Fills in the locations and trig of a set for distance_batch
+ *	@param set - the set
+ *	@param points - filled in with the arrays of set
+ *	@return void
+ */
+static void member_set_points(struct member_set *set,
+		struct geo_points *points)
+{
+	points->latitude = set->latitude;
+	points->longitude = set->longitude;
+	points->sin_lat = set->sin_lat;
+	points->cos_lat = set->cos_lat;
+	points->sin_lon = set->sin_lon;
+	points->cos_lon = set->cos_lon;
+}
 
-	/* loop through all bytes */
-	for (i = 0; i < len; i++) {
-		/* new line every 16 bytes */
-		if ((i % 16) == 0) {
-			/* dont print ascii for the zeroth line */
-			if (i != 0)
-				printf("  %s\n", buff);
-			/* print offset */
-			printf("  %04x ", i);
-		}
+/**
+ *	@brief Finds the spatial grid cell of a location
+ *	@param lat - latitude in degrees decimal
+ *	@param lon - longitude in degrees decimal
+ *	@return cell number
+ */
+unsigned int grid_cell(float lat, float lon)
+{
+	float y;
+	float x;
+
+	y = (lat + 90) / GRID_CELL;
+	x = (lon + 180) / GRID_CELL;
+
+	/* written so bad values such as NaN land in a valid cell */
+	if (!(y >= 0))
+		y = 0;
+	if (y >= GRID_LAT_CELLS)
+		y = GRID_LAT_CELLS - 1;
+	if (!(x >= 0))
+		x = 0;
+	if (x >= GRID_LON_CELLS)
+		x = GRID_LON_CELLS - 1;
+
+	return (unsigned int)y * GRID_LON_CELLS + (unsigned int)x;
+}
 
-		/* print the hex for the byte */
-		printf(" %02x", pc[i]);
+/**
+ *	@brief Finds how many longitude cells either side of a transmitter
+ *	can hold nodes in range, as parallels get shorter towards the poles
+ *	@param lat - latitude of the transmitter
+ *	@return number of cells, or -1 if the whole room should be walked
+ */
+int grid_span(float lat)
+{
+	double band;
+	double width;
 
-		/* store ASCII character for later */
-		if ((pc[i] < 0x20) || (pc[i] > 0x7e))
-			buff[i % 16] = '.';
-		else
-			buff[i % 16] = pc[i];
-		buff[(i % 16) + 1] = '\0';
-	}
+	/* the neighbouring rows reach further from the equator */
+	band = fabs(lat) + 2 * GRID_CELL;
+	if (!(band < 89))
+		return -1;
 
-	/* pad out last line if not exactly 16 bytes */
-	while ((i % 16) != 0) {
-		printf("   ");
-		i++;
-	}
+	width = RADIO_RANGE / (METERS_PER_DEGREE * cos(band * M_PI / 180));
+	if (width > GRID_MAX_SPAN * GRID_CELL)
+		return -1;
 
-	/* print final ASCII byte */
-	printf("  %s\n", buff);
+	return (int)(width / GRID_CELL) + 1;
 }
 
-#ifndef _WIN32
-void send_to_hosts(char *buf, int bytes, char *room)
-{
-	if (!esx || !broadcast)
+/**
+ *	@brief Hashes every member of a set into its grid buckets
+ *	@param set - the set, which may be published already
+ *	@return void
+ */
+void member_set_index(struct member_set *set)
+{
+	unsigned int bucket;
+	int i;
+
+	for (i = 0; i < set->buckets; i++)
+		set->cell_head[i] = -1;
+
+	for (i = 0; i < set->count; i++) {
+		set->cell[i] = grid_cell(set->latitude[i], set->longitude[i]);
+		bucket = cid_hash(set->cell[i]) & (set->buckets - 1);
+		set->cell_next[i] = set->cell_head[bucket];
+		set->cell_head[bucket] = i;
+	}
+}
+
+/**
+ *	@brief Moves a node in the spatial grid after its location changed
+ *	the members of its room are republished if it changed cells and the
+ *	node is queued for the next neighbour refresh
+ *	@param node - the node
+ *	@return void
+ */
+void node_moved(struct client *node)
+{
+	struct member_set *set;
+	struct member_set *copy;
+	int pos;
+
+	if (node->bucket == NULL)
+		return;
+
+	/* neighbour tables are only used when both checks are on */
+	if (send_distance && check_room)
+		node_mark(node);
+	node->bucket->changed = neighbour_epoch;
+
+	set = node->bucket->set;
+	pos = node->bucket_pos;
+
+	if (grid_cell(set->latitude[pos], set->longitude[pos]) ==
+			set->cell[pos])
+		return;
+
+	copy = member_set_alloc(set->count);
+	if (!copy) {
+		/* readers bound their walk of a bucket so this is safe */
+		member_set_index(set);
+		return;
+	}
+
+	member_set_copy(copy, set, set->count);
+	member_set_index(copy);
+	room_publish(node->bucket, copy);
+}
+
+/**
+ *	@brief Calls a function for the members of a set in the grid cells
+ *	which can hold nodes in range of a location, members out of range
+ *	may be visited as well
+ *	@param set - published members of a room
+ *	@param lat - latitude of the location
+ *	@param lon - longitude of the location
+ *	@param visit - function called with the set and a member position
+ *	@param arg - passed to visit
+ *	@return void
+ */
+void grid_visit(struct member_set *set, float lat, float lon,
+		void (*visit)(struct member_set *, int, void *), void *arg)
+{
+	unsigned int cell;
+	int steps;
+	int span;
+	int row;
+	int col;
+	int x;
+	int y;
+	int i;
+
+	span = grid_span(lat);
+	if (span < 0) {
+		for (i = 0; i < set->count; i++)
+			visit(set, i, arg);
+		return;
+	}
+
+	cell = grid_cell(lat, lon);
+	row = cell / GRID_LON_CELLS;
+	col = cell % GRID_LON_CELLS;
+
+	for (y = row - 1; y <= row + 1; y++) {
+		if ((y < 0) || (y >= GRID_LAT_CELLS))
+			continue;
+		for (x = col - span; x <= col + span; x++) {
+			/* wrap around the antimeridian */
+			cell = y * GRID_LON_CELLS +
+				(x + GRID_LON_CELLS) % GRID_LON_CELLS;
+			i = set->cell_head[cid_hash(cell) & (set->buckets - 1)];
+			/* the walk is bounded in case the set is reindexed */
+			for (steps = 0; (i >= 0) && (steps < set->count);
+					steps++, i = set->cell_next[i]) {
+				if (set->cell[i] == cell)
+					visit(set, i, arg);
+			}
+		}
+	}
+}
+
+/**
+ *	@brief Queues a node for the next neighbour refresh
+ *	@param node - the node, may be NULL
+ *	@return void
+ */
+void node_mark(struct client *node)
+{
+	struct neighbour_table **tables;
+	struct client **nodes;
+	int size;
+
+	if ((node == NULL) || node->moved)
+		return;
+
+	if (moved_count == moved_size) {
+		size = moved_size ? moved_size * 2 : 64;
+		nodes = realloc(moved_nodes, size * sizeof(struct client *));
+		if (!nodes) {
+			perror("wmasterd: realloc");
+			return;
+		}
+		moved_nodes = nodes;
+		tables = realloc(moved_tables,
+				size * sizeof(struct neighbour_table *));
+		if (!tables) {
+			perror("wmasterd: realloc");
+			return;
+		}
+		moved_tables = tables;
+		moved_size = size;
+	}
+
+	moved_nodes[moved_count++] = node;
+	node->moved = moved_count;
+}
+
+/**
+ *	@brief Takes a node off the neighbour refresh queue
+ *	@param node - the node
+ *	@return void
+ */
+void node_unmark(struct client *node)
+{
+	struct client *last;
+	int pos;
+
+	if (!node->moved)
+		return;
+
+	pos = node->moved - 1;
+	last = moved_nodes[--moved_count];
+	moved_nodes[pos] = last;
+	last->moved = pos + 1;
+	node->moved = 0;
+}
+
+/**
+ *	@brief Queues every node in a neighbour table for the next refresh
+ *	@param table - the table, may be NULL
+ *	@return void
+ */
+void mark_neighbours(struct neighbour_table *table)
+{
+	int i;
+
+	if (table == NULL)
+		return;
+
+	for (i = 0; i < table->count; i++)
+		node_mark(cid_index_lookup(table->cid[i]));
+}
+
+/**
+ *	@brief Grows a neighbour scratch buffer
+ *	@param scratch - the buffer
+ *	@return 0 on success, -1 on failure
+ */
+static int neighbour_scratch_grow(struct neighbour_scratch *scratch)
+{
+	struct geo_points *points;
+	void *arrays[8];
+	size_t widths[8];
+	int size;
+	int ret;
+	int i;
+
+	points = &scratch->points;
+	size = scratch->size ? scratch->size * 2 : 64;
+
+	arrays[0] = scratch->pos;
+	widths[0] = sizeof(int);
+	arrays[1] = scratch->distance;
+	widths[1] = sizeof(int);
+	arrays[2] = points->latitude;
+	widths[2] = sizeof(float);
+	arrays[3] = points->longitude;
+	widths[3] = sizeof(float);
+	arrays[4] = points->sin_lat;
+	widths[4] = sizeof(double);
+	arrays[5] = points->cos_lat;
+	widths[5] = sizeof(double);
+	arrays[6] = points->sin_lon;
+	widths[6] = sizeof(double);
+	arrays[7] = points->cos_lon;
+	widths[7] = sizeof(double);
+
+	/* keep whatever grew so nothing leaks if a later array fails */
+	ret = 0;
+	for (i = 0; i < 8; i++) {
+		void *p;
+
+		p = realloc(arrays[i], size * widths[i]);
+		if (p)
+			arrays[i] = p;
+		else
+			ret = -1;
+	}
+
+	scratch->pos = arrays[0];
+	scratch->distance = arrays[1];
+	points->latitude = arrays[2];
+	points->longitude = arrays[3];
+	points->sin_lat = arrays[4];
+	points->cos_lat = arrays[5];
+	points->sin_lon = arrays[6];
+	points->cos_lon = arrays[7];
+
+	if (ret < 0) {
+		perror("wmasterd: realloc");
+		return -1;
+	}
+
+	scratch->size = size;
+
+	return 0;
+}
+
+/**
+ *	@brief Gathers a member into a neighbour table being built
+ *	@param set - published members of the room
+ *	@param pos - position of the member in set
+ *	@param arg - the struct neighbour_scratch being filled
+ *	@return void
+ */
+static void neighbour_visit(struct member_set *set, int pos, void *arg)
+{
+	struct neighbour_scratch *scratch;
+	struct geo_points *points;
+	int i;
+
+	scratch = arg;
+	points = &scratch->points;
+
+	if ((scratch->count == scratch->size) &&
+			(neighbour_scratch_grow(scratch) < 0))
+		return;
+
+	i = scratch->count++;
+	scratch->pos[i] = pos;
+	points->latitude[i] = set->latitude[pos];
+	points->longitude[i] = set->longitude[pos];
+	points->sin_lat[i] = set->sin_lat[pos];
+	points->cos_lat[i] = set->cos_lat[pos];
+	points->sin_lon[i] = set->sin_lon[pos];
+	points->cos_lon[i] = set->cos_lon[pos];
+}
+
+/**
+ *	@brief Finds the nodes in range of a node from its room's grid
+ *	the trig of the room's members must be current
+ *	@param node - the node
+ *	@param scratch - buffer to collect neighbours in
+ *	@return the new table or NULL on failure
+ */
+struct neighbour_table *neighbour_table_build(struct client *node,
+		struct neighbour_scratch *scratch)
+{
+	struct neighbour_table *table;
+	struct member_set *set;
+	struct geo_point tx;
+	int count;
+	int pos;
+	int i;
+
+	if (node->bucket == NULL)
+		return NULL;
+
+	set = node->bucket->set;
+	pos = node->bucket_pos;
+
+	tx.latitude = set->latitude[pos];
+	tx.longitude = set->longitude[pos];
+	tx.sin_lat = set->sin_lat[pos];
+	tx.cos_lat = set->cos_lat[pos];
+	tx.sin_lon = set->sin_lon[pos];
+	tx.cos_lon = set->cos_lon[pos];
+
+	scratch->count = 0;
+	grid_visit(set, tx.latitude, tx.longitude, neighbour_visit, scratch);
+
+	distance_batch(&tx, &scratch->points, scratch->count, distance_method,
+			RADIO_RANGE, scratch->distance);
+
+	count = 0;
+	for (i = 0; i < scratch->count; i++) {
+		/* the node itself is always at 0 */
+		if (scratch->pos[i] == pos)
+			scratch->distance[i] = 0;
+		if (scratch->distance[i] >= 0)
+			count++;
+	}
+
+	table = malloc(sizeof(struct neighbour_table) +
+			count * (sizeof(unsigned int) + sizeof(int)));
+	if (!table) {
+		perror("wmasterd: malloc");
+		return NULL;
+	}
+
+	table->count = count;
+	table->cid = (unsigned int *)(table + 1);
+	table->distance = (int *)(table->cid + table->count);
+
+	count = 0;
+	for (i = 0; i < scratch->count; i++) {
+		if (scratch->distance[i] < 0)
+			continue;
+		table->cid[count] = set->cid[scratch->pos[i]];
+		table->distance[count] = scratch->distance[i];
+		count++;
+	}
+
+	return table;
+}
+
+/**
+ *	@brief Replaces the neighbour table of a node
+ *	@param node - the node
+ *	@param table - the new table
+ *	@return void
+ */
+static void neighbour_table_publish(struct client *node,
+		struct neighbour_table *table)
+{
+	struct neighbour_table *old;
+
+	old = node->neighbours;
+	__atomic_store_n(&node->neighbours, table, __ATOMIC_RELEASE);
+	epoch_retire(old, free);
+}
+
+/**
+ *	@brief Builds the neighbour tables for part of the refresh queue
+ *	runs on the workers of neighbour_pool while list_mutex is held by
+ *	the thread refreshing, every worker has its own scratch buffer
+ *	@param arg - unused
+ *	@param worker - worker number
+ *	@param first - first position in moved_nodes
+ *	@param last - one past the last position in moved_nodes
+ *	@return void
+ */
+static void neighbour_job(void *arg, int worker, int first, int last)
+{
+	int i;
+
+	for (i = first; i < last; i++)
+		moved_tables[i] = neighbour_table_build(moved_nodes[i],
+				&neighbour_scratch[worker]);
+}
+
+/**
+ *	@brief Rebuilds the neighbour tables of the nodes which moved this
+ *	epoch, and of every node which was or now is in range of them
+ *
+ *	The tables are built in parallel on neighbour_pool, first for the
+ *	moved nodes and then for the neighbours they gained or lost. None
+ *	is published until all are built, so a frame relayed during the
+ *	refresh sees either the old graph or a finished table.
+ *	@return void
+ */
+void refresh_neighbours(void)
+{
+	struct geo_points points;
+	struct client *node;
+	int count;
+	int i;
+
+	count = moved_count;
+
+	/*
+	 * only the moved nodes have new locations, and the trig is only
+	 * read here under list_mutex so it is updated in place
+	 */
+	for (i = 0; i < count; i++) {
+		node = moved_nodes[i];
+		if (node->bucket == NULL)
+			continue;
+		member_set_points(node->bucket->set, &points);
+		geo_points_trig(&points, node->bucket_pos, 1);
+	}
+
+	work_pool_run(&neighbour_pool, 0, count, NEIGHBOUR_CHUNK,
+			neighbour_job, NULL);
+
+	/* both old and new neighbours see a new distance */
+	for (i = 0; i < count; i++) {
+		mark_neighbours(moved_nodes[i]->neighbours);
+		mark_neighbours(moved_tables[i]);
+	}
+
+	work_pool_run(&neighbour_pool, count, moved_count, NEIGHBOUR_CHUNK,
+			neighbour_job, NULL);
+
+	for (i = 0; i < moved_count; i++) {
+		neighbour_table_publish(moved_nodes[i], moved_tables[i]);
+		moved_nodes[i]->moved = 0;
+	}
+	moved_count = 0;
+
+	/* every change so far is in the tables */
+	neighbour_epoch++;
+}
+
+/**
+ *	@brief Gets the neighbour table a frame from a node is relayed with
+ *	a room whose members joined, left or moved since the last refresh
+ *	has tables which may miss or misplace them, so its members scan the
+ *	room until then, must hold list_mutex
+ *	@param node - the sender
+ *	@return the table, NULL to scan the members of the room
+ */
+struct neighbour_table *node_neighbours(struct client *node)
+{
+	if ((node->bucket == NULL) ||
+			(node->bucket->changed == neighbour_epoch))
+		return NULL;
+
+	return node->neighbours;
+}
+
+/**
+ *	@brief Starts the threads which rebuild neighbour tables
+ *	@param threads - number of threads, 0 for one per cpu
+ *	@return 0 on success, -1 on failure
+ */
+int neighbour_pool_init(int threads)
+{
+	/* neighbour tables are only used when both checks are on */
+	if (!(send_distance && check_room))
+		threads = 1;
+	else if (threads <= 0)
+		threads = work_pool_cpus();
+
+	if (work_pool_init(&neighbour_pool, threads) < 0)
+		return -1;
+
+	neighbour_scratch = calloc(neighbour_pool.count,
+			sizeof(struct neighbour_scratch));
+	if (!neighbour_scratch) {
+		perror("wmasterd: calloc");
+		work_pool_free(&neighbour_pool);
+		return -1;
+	}
+
+	print_debug(LOG_INFO, "rebuilding neighbours on %d threads",
+			neighbour_pool.count);
+
+	return 0;
+}
+
+/**
+ *	@brief Stops the neighbour threads and frees their buffers
+ *	@return void
+ */
+void neighbour_pool_free(void)
+{
+	struct neighbour_scratch *scratch;
+	int i;
+
+	if (neighbour_scratch == NULL)
+		return;
+
+	for (i = 0; i < neighbour_pool.count; i++) {
+		scratch = &neighbour_scratch[i];
+		free(scratch->pos);
+		free(scratch->distance);
+		free(scratch->points.latitude);
+		free(scratch->points.longitude);
+		free(scratch->points.sin_lat);
+		free(scratch->points.cos_lat);
+		free(scratch->points.sin_lon);
+		free(scratch->points.cos_lon);
+	}
+
+	work_pool_free(&neighbour_pool);
+	free(neighbour_scratch);
+	neighbour_scratch = NULL;
+}
+
+/**
+ *	@brief Starts the threads which share the fan-out of large rooms
+ *	@param threshold - receivers from which fan-out is shared, 0 or less
+ *	for never
+ *	@return 0 on success, -1 on failure
+ */
+int fanout_pool_init(int threshold)
+{
+	int threads;
+
+	if (threshold <= 0)
+		return 0;
+
+	threads = work_pool_cpus();
+	if (threads < 2)
+		return 0;
+
+	if (work_pool_init(&fanout_pool, threads) < 0)
+		return -1;
+	pthread_mutex_init(&fanout_mutex, NULL);
+
+	print_debug(LOG_INFO, "fan-out to %d or more nodes on %d threads",
+			threshold, fanout_pool.count);
+
+	return 0;
+}
+
+/**
+ *	@brief Stops the fan-out threads
+ *	@return void
+ */
+void fanout_pool_free(void)
+{
+	if (fanout_pool.count == 0)
+		return;
+
+	work_pool_free(&fanout_pool);
+	pthread_mutex_destroy(&fanout_mutex);
+	fanout_pool.count = 0;
+}
+
+/**
+ *	@brief Replaces the members of a room
+ *	the old set is freed once no reader can still be walking it
+ *	@param room - the room
+ *	@param set - the new set, NULL if the room is now empty
+ *	@return void
+ */
+void room_publish(struct room *room, struct member_set *set)
+{
+	struct member_set *old;
+
+	old = room->set;
+	__atomic_store_n(&room->set, set, __ATOMIC_RELEASE);
+	epoch_retire(old, free);
+}
+
+/**
+ *	@brief Adds a node to the members of the room in node->room_id
+ *	the node starts with a fresh time stamp and no location
+ *	@param node - the node to add
+ *	@return 0 on success, -1 on failure
+ */
+int room_add_member(struct client *node)
+{
+	struct geo_points points;
+	struct member_set *set;
+	struct room *room;
+	int pos;
+
+	room = search_room(node->room_id);
+	if (room == NULL)
+		room = add_room(node->room_id);
+	if (room == NULL)
+		return -1;
+
+	pos = room->set ? room->set->count : 0;
+
+	set = member_set_alloc(pos + 1);
+	if (!set)
+		return -1;
+	if (pos > 0)
+		member_set_copy(set, room->set, pos);
+
+	set->members[pos] = node;
+	set->cid[pos] = node->cid;
+	set->time[pos] = current_time;
+	set->latitude[pos] = 0;
+	set->longitude[pos] = 0;
+	set->altitude[pos] = 0;
+	member_set_points(set, &points);
+	geo_points_trig(&points, pos, 1);
+	member_set_index(set);
+
+	room_publish(room, set);
+	room->changed = neighbour_epoch;
+
+	node->bucket = room;
+	node->bucket_pos = pos;
+
+	return 0;
+}
+
+/**
+ *	@brief Removes the member at a position from a room
+ *	the last member is moved into the vacated position
+ *	@param room - the room
+ *	@param pos - position of the member to remove
+ *	@return void
+ */
+void room_remove_pos(struct room *room, int pos)
+{
+	struct member_set *set;
+	int last;
+
+	last = room->set->count - 1;
+	room->changed = neighbour_epoch;
+
+	if (last == 0) {
+		room_publish(room, NULL);
+		return;
+	}
+
+	set = member_set_alloc(last);
+	if (set) {
+		member_set_copy(set, room->set, last);
+	} else {
+		/*
+		 * remove in place, a reader walking the set may miss the
+		 * moved member once but only ever sees valid members
+		 */
+		set = room->set;
+		set->count = last;
+	}
+
+	if (pos != last) {
+		set->members[pos] = room->set->members[last];
+		set->cid[pos] = room->set->cid[last];
+		set->time[pos] = room->set->time[last];
+		set->latitude[pos] = room->set->latitude[last];
+		set->longitude[pos] = room->set->longitude[last];
+		set->altitude[pos] = room->set->altitude[last];
+		set->sin_lat[pos] = room->set->sin_lat[last];
+		set->cos_lat[pos] = room->set->cos_lat[last];
+		set->sin_lon[pos] = room->set->sin_lon[last];
+		set->cos_lon[pos] = room->set->cos_lon[last];
+		set->members[pos]->bucket_pos = pos;
+	}
+
+	/* readers bound their walk of a bucket so reindexing in place is safe */
+	member_set_index(set);
+
+	if (set != room->set)
+		room_publish(room, set);
+}
+
+/**
+ *	@brief Removes a node from the members of its room
+ *	@param node - the node to remove
+ *	@return void
+ */
+void room_remove_member(struct client *node)
+{
+	if (node->bucket == NULL)
+		return;
+
+	room_remove_pos(node->bucket, node->bucket_pos);
+
+	node->bucket = NULL;
+	node->bucket_pos = 0;
+}
+
+/**
+ *	@brief Frees all of the rooms in the room list
+ *	@return void
+ */
+void free_rooms(void)
+{
+	struct room *temp;
+	struct room *curr;
+
+	curr = rooms;
+
+	while (curr != NULL) {
+		temp = curr;
+		curr = curr->next;
+		free(temp->set);
+		free(temp);
+	}
+
+	rooms = NULL;
+	free(room_table);
+	room_table = NULL;
+	room_table_size = 0;
+}
+
+/**
+ *	@brief Searches the CID index for a given node
+ *	@param srchost - CID of the guest
+ *	@return returns the node
+ */
+struct client *search_node_vmci(unsigned int srchost)
+{
+	struct client *curr;
+
+	curr = cid_index_lookup(srchost);
+	if (curr != NULL)
+		NODE_TIME(curr) = current_time;
+
+	return curr;
+}
+
+/**
+ *	@brief Searches the linked list for a node by name
+ *	@param name_id - symbol id of the name
+ *	@return returns the node
+ */
+struct client *search_node_name(int name_id)
+{
+	struct client *curr;
+
+	curr = head;
+
+	print_debug(LOG_DEBUG, "searching for node with name %s",
+			sym_name(name_id));
+
+	while (curr != NULL) {
+		if (curr->name_id == name_id) {
+			return curr;
+		}
+		curr = curr->next;
+	}
+
+	print_debug(LOG_DEBUG, "no node found with name %s",
+			sym_name(name_id));
+
+	return NULL;
+}
+
+void print_node(struct client *node)
+{
+	printf("%d\n", node->cid);
+	printf("%s\n", sym_name(node->name_id));
+	printf("%s\n", sym_name(node->room_id));
+	printf("%d\n", NODE_TIME(node));
+	printf("%f\n", NODE_LAT(node));
+	printf("%f\n", NODE_LON(node));
+	printf("%f\n", NODE_ALT(node));
+	printf("%f\n", node->loc.velocity);
+	printf("%f\n", node->loc.heading);
+	printf("%f\n", node->loc.pitch);
+}
+
+/**
+ *	@brief Lists the nodes in each room
+ *	@return void
+ */
+void list_nodes_vmci(void)
+{
+	struct room *room;
+	struct client *curr;
+	FILE *fp;
+	int age;
+	int i;
+
+	fp = fopen("/tmp/wmasterd.status", "w");
+
+	if (!fp && esx) {
+		perror("wmasterd: fopen");
+		print_debug(LOG_WARNING, "could not open /tmp/wmasterd.status\n");
+	}
+
+	printf("node:       room:				age: lat:      lon:       alt:   sog:       cog: pitch: name:\n");
+
+	if (fp)
+		fprintf(fp, "node:       room:				age: lat:      lon:       alt:   sog:     cog:   pitch: name:\n");
+
+	/* nodes are listed grouped by room */
+	for (room = rooms; room != NULL; room = room->next) {
+		if (room->set == NULL)
+			continue;
+		for (i = 0; i < room->set->count; i++) {
+			curr = room->set->members[i];
+			age = time(NULL) - NODE_TIME(curr);
+			printf("%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s\n",
+				curr->cid, sym_name(curr->room_id), age,
+				NODE_LAT(curr), NODE_LON(curr),
+				NODE_ALT(curr),
+				curr->loc.velocity,
+				curr->loc.heading,
+				curr->loc.pitch,
+				sym_name(curr->name_id));
+			if (fp) {
+				fprintf(fp, "%-11d %-36s %-4d %-9.6f %-10.6f %-6.0f %-8.2f %-6.2f %-6.2f %-s\n",
+					curr->cid, sym_name(curr->room_id), age,
+					NODE_LAT(curr), NODE_LON(curr),
+					NODE_ALT(curr),
+					curr->loc.velocity,
+					curr->loc.heading,
+					curr->loc.pitch,
+					sym_name(curr->name_id));
+			}
+		}
+	}
+
+	if (fp)
+		fclose(fp);
+}
+
+/**
+ *	@brief Removed a node from the linked list
+ *	@param dsthost - CID of the guest
+ *	@return void
+ */
+void remove_node_vmci(unsigned int dsthost)
+{
+	struct client *curr;
+	int name_id;
+	int room_id;
+	int time;
+
+	time = 0;
+
+	curr = cid_index_lookup(dsthost);
+
+	/* exit if the node is not in the list */
+	if (curr == NULL) {
+		print_debug(LOG_INFO, "node not found: %11d\n", dsthost);
+		return;
+	}
+
+	room_id = curr->room_id;
+	name_id = curr->name_id;
+	time = NODE_TIME(curr);
+
+	/* delete node */
+	tw_del(&curr->expiry);
+	cid_index_remove(dsthost);
+	room_remove_member(curr);
+
+	/* nodes which could hear this one need new tables */
+	mark_neighbours(curr->neighbours);
+	node_unmark(curr);
+	epoch_retire(curr->neighbours, free);
+
+	if (curr->prev == NULL)
+		head = curr->next;
+	else
+		curr->prev->next = curr->next;
+
+	if (curr->next == NULL)
+		tail = curr->prev;
+	else
+		curr->next->prev = curr->prev;
+
+	/* threads relaying frames may still hold the node */
+	epoch_retire(curr, free);
+
+	print_debug(LOG_NOTICE, "del: %11d room: %36s time: %d name: %s",
+		dsthost, sym_name(room_id), time, sym_name(name_id));
+}
+
+/**
+ *      @brief Display a hex dump of the passed buffer
+ *      this function was pulled off the web somehwere... seems to throw a
+ *      segfault when printing some of the netlink error message data
+ *      @param addr - address of buffer
+ *      @param len - size of buffer
+ *      @return void - assumes success
+ */
+void hex_dump(void *addr, int len)
+{
+	int i;
+	unsigned char buff[17];
+	unsigned char *pc;
+
+	pc = (unsigned char *)addr;
+
+	/* loop through all bytes */
+	for (i = 0; i < len; i++) {
+		/* new line every 16 bytes */
+		if ((i % 16) == 0) {
+			/* dont print ascii for the zeroth line */
+			if (i != 0)
+				printf("  %s\n", buff);
+			/* print offset */
+			printf("  %04x ", i);
+		}
+
+		/* print the hex for the byte */
+		printf(" %02x", pc[i]);
+
+		/* store ASCII character for later */
+		if ((pc[i] < 0x20) || (pc[i] > 0x7e))
+			buff[i % 16] = '.';
+		else
+			buff[i % 16] = pc[i];
+		buff[(i % 16) + 1] = '\0';
+	}
+
+	/* pad out last line if not exactly 16 bytes */
+	while ((i % 16) != 0) {
+		printf("   ");
+		i++;
+	}
+
+	/* print final ASCII byte */
+	printf("  %s\n", buff);
+}
+
+/**
+ *	@brief Adds a host frames are forwarded to
+ *	@param spec - IPv4 address, with ":port" if not HOST_PORT
+ *	@return 0 on success, -1 if spec is not an address or there are
+ *	already PEER_MAX peers
+ */
+int peer_add(const char *spec)
+{
+	struct peer *peer;
+	char host[INET_ADDRSTRLEN];
+	const char *colon;
+	char *end;
+	unsigned long port;
+	size_t len;
+
+	if (peer_count >= PEER_MAX)
+		return -1;
+
+	port = HOST_PORT;
+	len = strlen(spec);
+	colon = strchr(spec, ':');
+	if (colon != NULL) {
+		port = strtoul(colon + 1, &end, 10);
+		if ((end == colon + 1) || (*end != '\0') || (port == 0) ||
+				(port > 65535))
+			return -1;
+		len = colon - spec;
+	}
+	if (len >= sizeof(host))
+		return -1;
+	memcpy(host, spec, len);
+	host[len] = '\0';
+
+	peer = &peers[peer_count];
+	memset(peer, 0, sizeof(struct peer));
+	peer->addr.sin_family = AF_INET;
+	peer->addr.sin_port = htons(port);
+	/* inet_pton is missing before Vista */
+	peer->addr.sin_addr.s_addr = inet_addr(host);
+	if (peer->addr.sin_addr.s_addr == INADDR_NONE)
+		return -1;
+	memcpy(peer->name, host, len + 1);
+	peer_count++;
+
+	return 0;
+}
+
+#ifndef _WIN32
+/**
+ *	@brief Sends every peer the rooms this host has members in
+ *	a list longer than a datagram is split, each part stands alone
+ *	@return void
+ */
+void peer_advertise(void)
+{
+	static char buf[BUFF_LEN];
+	struct room *room;
+	int prefix;
+	int len;
+	int i;
+
+	if ((current_time - peer_advertised) < PEER_ADVERTISE)
+		return;
+	peer_advertised = current_time;
+
+	prefix = strlen(PEER_ROOMS);
+	memcpy(buf, PEER_ROOMS, prefix);
+	len = prefix;
+
+	epoch_enter();
+	for (room = __atomic_load_n(&rooms, __ATOMIC_ACQUIRE); room != NULL;
+			room = room->next) {
+		if (__atomic_load_n(&room->set, __ATOMIC_ACQUIRE) == NULL)
+			continue;
+		/* padded the way frames carry their room */
+		strncpy(buf + len, sym_name(room->room_id), UUID_LEN - 1);
+		len += UUID_LEN - 1;
+
+		if (len + UUID_LEN - 1 > BUFF_LEN) {
+			for (i = 0; i < peer_count; i++)
+				sendto(peer_fd, buf, len, SEND_DONTWAIT,
+					(struct sockaddr *)&peers[i].addr,
+					sizeof(struct sockaddr_in));
+			len = prefix;
+		}
+	}
+	epoch_exit();
+
+	/* an empty list still tells peers this host is up */
+	for (i = 0; i < peer_count; i++)
+		sendto(peer_fd, buf, len, SEND_DONTWAIT,
+			(struct sockaddr *)&peers[i].addr,
+			sizeof(struct sockaddr_in));
+}
+
+/**
+ *	@brief Records the rooms a peer has members in
+ *	rooms without local members are skipped, nothing is sent there until
+ *	this host has members and the peer lists the room again
+ *	@param buf - the room list
+ *	@param bytes - size of buf
+ *	@param from - address it came from
+ *	@return void
+ */
+void peer_interest(char *buf, int bytes, struct sockaddr_in *from)
+{
+	struct room *room;
+	int room_id;
+	int prefix;
+	int p;
+	int i;
+
+	/* a peer is known by its address, its port may be translated */
+	for (p = 0; p < peer_count; p++) {
+		if (peers[p].addr.sin_addr.s_addr == from->sin_addr.s_addr)
+			break;
+	}
+	if (p == peer_count)
+		return;
+
+	prefix = strlen(PEER_ROOMS);
+	if ((bytes - prefix) % (UUID_LEN - 1) != 0)
+		return;
+	peers[p].adverts++;
+
+	epoch_enter();
+	for (i = prefix; i < bytes; i += UUID_LEN - 1) {
+		room_id = sym_lookup(buf + i, UUID_LEN - 1);
+		room = search_room(room_id);
+		if (room != NULL)
+			__atomic_store_n(&room->peer_seen[p], current_time,
+					__ATOMIC_RELAXED);
+	}
+	epoch_exit();
+}
+
+/**
+ *	@brief Forwards a frame to the peers with members in its room,
+ *	read section must be held
+ *	@param buf - the frame
+ *	@param bytes - size of the frame
+ *	@param room_id - symbol id of the room of its sender
+ *	@return void
+ */
+static void send_to_peers(char *buf, int bytes, int room_id)
+{
+	char temp[UUID_LEN + 1];
+	struct iovec iov[2];
+	struct room *room;
+	int seen;
+	int ret;
+	int i;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[PEER_MAX];
+	int count;
+#else
+	struct msghdr hdr;
+#endif
+
+	room = search_room(room_id);
+	if (room == NULL)
+		return;
+
+	/* the room is sent after the frame without copying the frame */
+	memset(temp, 0, sizeof(temp));
+	snprintf(temp, UUID_LEN + 1, ":%s", sym_name(room_id));
+	iov[0].iov_base = buf;
+	iov[0].iov_len = bytes;
+	iov[1].iov_base = temp;
+	iov[1].iov_len = UUID_LEN;
+
+#ifdef HAVE_SENDMMSG
+	count = 0;
+	for (i = 0; i < peer_count; i++) {
+		seen = __atomic_load_n(&room->peer_seen[i], __ATOMIC_RELAXED);
+		if (current_time - seen > PEER_TIMEOUT)
+			continue;
+		memset(&msgs[count], 0, sizeof(struct mmsghdr));
+		msgs[count].msg_hdr.msg_name = &peers[i].addr;
+		msgs[count].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		msgs[count].msg_hdr.msg_iov = iov;
+		msgs[count].msg_hdr.msg_iovlen = 2;
+		count++;
+		__atomic_add_fetch(&peers[i].sent, 1, __ATOMIC_RELAXED);
+	}
+	if (count == 0)
+		return;
+
+	/* one call however many peers share the room */
+	ret = sendmmsg(peer_fd, msgs, count, SEND_DONTWAIT);
+	if (ret < 0)
+		sock_error("wmasterd: sendmmsg");
+#else
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_namelen = sizeof(struct sockaddr_in);
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = 2;
+	for (i = 0; i < peer_count; i++) {
+		seen = __atomic_load_n(&room->peer_seen[i], __ATOMIC_RELAXED);
+		if (current_time - seen > PEER_TIMEOUT)
+			continue;
+		hdr.msg_name = &peers[i].addr;
+		ret = sendmsg(peer_fd, &hdr, SEND_DONTWAIT);
+		if (ret < 0)
+			sock_error("wmasterd: sendmsg");
+		else
+			__atomic_add_fetch(&peers[i].sent, 1,
+					__ATOMIC_RELAXED);
+	}
+#endif
+}
+
+/**
+ *	@brief Logs the room lists and frames exchanged with each peer
+ *	@return void
+ */
+void peer_status(void)
+{
+	int i;
+
+	for (i = 0; i < peer_count; i++)
+		print_debug(LOG_INFO, "peer %s:%d: %lu room lists received, %lu frames forwarded",
+				peers[i].name, ntohs(peers[i].addr.sin_port),
+				peers[i].adverts,
+				__atomic_load_n(&peers[i].sent,
+				__ATOMIC_RELAXED));
+}
+
+/**
+ *	@brief Sends a frame to the other wmasterd hosts, only to the peers
+ *	with members in its room when peers are given, otherwise broadcast
+ *	@param buf - the frame
+ *	@param bytes - size of the frame
+ *	@param room_id - symbol id of the room of its sender
+ *	@return void
+ */
+void send_to_hosts(char *buf, int bytes, int room_id)
+{
+	if (peer_count > 0) {
+		send_to_peers(buf, bytes, room_id);
+		return;
+	}
+
+	if (!esx || !broadcast)
+		return;
+
+	char temp[UUID_LEN + 1];
+	struct sockaddr_in dest_addr;
+	struct iovec iov[2];
+	struct msghdr hdr;
+	int sock_opts;
+	int sockfd;
+	int bytes_sent;
+
+	/* the room is sent after the frame without copying the frame */
+	memset(temp, 0, sizeof(temp));
+	snprintf(temp, UUID_LEN + 1, ":%s", sym_name(room_id));
+	iov[0].iov_base = buf;
+	iov[0].iov_len = bytes;
+	iov[1].iov_base = temp;
+	iov[1].iov_len = UUID_LEN;
+
+	/* set destination address */
+	memset(&dest_addr, 0, sizeof(struct sockaddr_in));
+	dest_addr.sin_family = AF_INET;
+	inet_pton(AF_INET, broadcast_addr, &dest_addr.sin_addr.s_addr);
+	dest_addr.sin_port = htons(HOST_PORT);
+
+	/* setup socket */
+	sock_opts = 1;
+	sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR|SO_BROADCAST,
+		(const char *)&sock_opts, sizeof(int));
+	if (sockfd < 0) {
+		sock_error("wmasterd: socket");
+		print_debug(LOG_ERR, "error: could not create udp socket\n");
+		return;
+	}
+
+	/* send packet */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_name = &dest_addr;
+	hdr.msg_namelen = sizeof(dest_addr);
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = 2;
+	bytes_sent = sendmsg(sockfd, &hdr, 0);
+	if (bytes_sent < 0)
+		sock_error("wmasterd: sendto\n");
+	else
+		print_debug(LOG_DEBUG, "sent %d bytes to %s\n",
+				bytes_sent, broadcast_addr);
+
+	/* cleanup */
+	close(sockfd);
+}
+#endif
+
+/**
+ *	@brief Checks whether the last send failed only because the
+ *	receiver's socket buffer is full, which is worth waiting out
+ *	@return 1 if the frame can be queued, 0 if the node is gone
+ */
+int send_backlogged(void)
+{
+#ifdef _WIN32
+	int err = WSAGetLastError();
+
+	return (err == WSAEWOULDBLOCK) || (err == WSAENOBUFS);
+#else
+	return (errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+		(errno == ENOBUFS);
+#endif
+}
+
+/**
+ *	@brief Sorts the error of the last send
+ *	@return SEND_TRANSIENT if the next send may work, SEND_PERSISTENT if
+ *	the receiver is gone, SEND_UNKNOWN otherwise
+ */
+int send_error_class(void)
+{
+#ifdef _WIN32
+	int err = WSAGetLastError();
+
+	if (send_backlogged() || (err == WSAEINTR))
+		return SEND_TRANSIENT;
+	if ((err == WSAECONNRESET) || (err == WSAEHOSTUNREACH) ||
+			(err == WSAENETDOWN))
+		return SEND_PERSISTENT;
+#else
+	if (send_backlogged() || (errno == ENOMEM) || (errno == EINTR))
+		return SEND_TRANSIENT;
+	/*
+	 * a powered off VM is no longer reachable over vsock, and a closed
+	 * connection or none at all means welled has gone
+	 */
+	if ((errno == ENODEV) || (errno == ECONNRESET) ||
+			(errno == EHOSTUNREACH) || (errno == EPIPE) ||
+			(errno == ENOTCONN))
+		return SEND_PERSISTENT;
+#endif
+	return SEND_UNKNOWN;
+}
+
+/**
+ *	@brief Handles a send which failed and was not queued
+ *	transient errors only drop the frame, a node is removed when the
+ *	error says it is gone or after SEND_FAIL_LIMIT failures within
+ *	SEND_FAIL_WINDOW seconds
+ *	@param cid - CID of the node
+ *	@param bytes - size of the message which failed
+ *	@return 1 if the node was removed from the list, 0 if not
+ */
+int send_failed(unsigned int cid, int bytes)
+{
+	struct client *curr;
+	int class;
+	int now;
+	int removed;
+
+	class = send_error_class();
+	if (class == SEND_TRANSIENT) {
+		__atomic_add_fetch(&send_transient, 1, __ATOMIC_RELAXED);
+		if (verbose)
+			sock_error("wmasterd: sendto");
+		return 0;
+	}
+
+	__atomic_add_fetch(&send_errors, 1, __ATOMIC_RELAXED);
+
+	removed = 0;
+	now = time(NULL);
+	pthread_mutex_lock(&list_mutex);
+	curr = cid_index_lookup(cid);
+	if (curr != NULL) {
+		if (verbose) {
+			sock_error("wmasterd: sendto");
+			print_debug(LOG_ERR, "error: name %s cid %d bytes %d\n", sym_name(curr->name_id), curr->cid, bytes);
+			print_node(curr);
+		}
+
+		/* failures older than the window are forgotten */
+		if (now - curr->failed_at >= SEND_FAIL_WINDOW)
+			curr->send_failures = 0;
+		if (curr->send_failures++ == 0)
+			curr->failed_at = now;
+
+		if ((class == SEND_PERSISTENT) ||
+				(curr->send_failures >= SEND_FAIL_LIMIT)) {
+			print_debug(LOG_NOTICE, "del: %11d room: %36s name: %s failures: %d", curr->cid, sym_name(curr->room_id), sym_name(curr->name_id), curr->send_failures);
+			remove_node_vmci(curr->cid);
+			__atomic_add_fetch(&send_evictions, 1,
+					__ATOMIC_RELAXED);
+			removed = 1;
+		}
+	}
+	pthread_mutex_unlock(&list_mutex);
+
+	return removed;
+}
+
+/**
+ *	@brief Reads a clock for timing queued frames
+ *	@return microseconds from an arbitrary start
+ */
+static unsigned long long sendq_now(void)
+{
+#ifdef _WIN32
+	return (unsigned long long)GetTickCount() * 1000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ *	@brief Sets up the send queue hash
+ *	@return void
+ */
+void sendq_init(void)
+{
+	int i;
+
+	for (i = 0; i < SENDQ_BUCKETS; i++) {
+		pthread_mutex_init(&send_queues[i].lock, NULL);
+		send_queues[i].head = NULL;
+	}
+}
+
+/**
+ *	@brief Finds the send queue of a receiver, bucket lock must be held
+ *	@param bucket - the bucket of the CID
+ *	@param cid - CID of the receiver
+ *	@param create - whether to add a queue if there is none
+ *	@return the queue, or NULL
+ */
+static struct send_queue *sendq_find(struct send_bucket *bucket,
+		unsigned int cid, int create)
+{
+	struct send_queue *queue;
+
+	for (queue = bucket->head; queue != NULL; queue = queue->next) {
+		if (queue->cid == cid)
+			return queue;
+	}
+
+	if (!create)
+		return NULL;
+
+	queue = calloc(1, sizeof(struct send_queue));
+	if (queue == NULL)
+		return NULL;
+	queue->cid = cid;
+	codel_init(&queue->codel, SENDQ_TARGET_US, SENDQ_INTERVAL_US);
+	queue->next = bucket->head;
+	bucket->head = queue;
+
+	return queue;
+}
+
+/**
+ *	@brief Removes the oldest frame of a queue, bucket lock must be held
+ *	@param queue - the queue
+ *	@return void
+ */
+static void sendq_pop(struct send_queue *queue)
+{
+	frame_put(&frame_pool, queue->frame[queue->head]);
+	queue->frame[queue->head] = NULL;
+	queue->head = (queue->head + 1) % SENDQ_LEN;
+	__atomic_sub_fetch(&sendq_frames, 1, __ATOMIC_RELAXED);
+
+	if (--queue->count == 0) {
+		codel_empty(&queue->codel);
+		__atomic_sub_fetch(&sendq_backlog, 1, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ *	@brief Queues a copy of a frame for a receiver whose socket buffer
+ *	is full, the frame is dropped if the queue is full
+ *	@param cid - CID of the receiving node
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param distance - distance sent after the frame, or NULL
+ *	@return 0 if queued, -1 if dropped
+ */
+int sendq_add(unsigned int cid, char *buf, int bytes, char *distance)
+{
+	struct send_bucket *bucket;
+	struct send_queue *queue;
+	char *frame;
+	int total;
+	int i;
+
+	total = bytes + ((distance != NULL) ? DISTANCE_LEN : 0);
+
+	bucket = &send_queues[cid & (SENDQ_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+
+	queue = sendq_find(bucket, cid, 1);
+	if (queue == NULL) {
+		pthread_mutex_unlock(&bucket->lock);
+		return -1;
+	}
+
+	/* tail drop when the queue or the buffers set aside are used up */
+	frame = NULL;
+	if ((queue->count < SENDQ_LEN) && (total <= (int)FRAME_LEN) &&
+			(__atomic_load_n(&sendq_frames, __ATOMIC_RELAXED) <
+			SENDQ_FRAMES))
+		frame = frame_get(&frame_pool);
+	if (frame == NULL) {
+		queue->dropped++;
+		pthread_mutex_unlock(&bucket->lock);
+		return -1;
+	}
+
+	memcpy(frame, buf, bytes);
+	if (distance != NULL)
+		memcpy(frame + bytes, distance, DISTANCE_LEN);
+
+	i = (queue->head + queue->count) % SENDQ_LEN;
+	queue->frame[i] = frame;
+	queue->bytes[i] = total;
+	queue->queued_at[i] = sendq_now();
+	__atomic_add_fetch(&sendq_frames, 1, __ATOMIC_RELAXED);
+
+	if (queue->count++ == 0)
+		__atomic_add_fetch(&sendq_backlog, 1, __ATOMIC_RELEASE);
+	if (queue->count > queue->max_depth)
+		queue->max_depth = queue->count;
+
+	pthread_mutex_unlock(&bucket->lock);
+
+	return 0;
+}
+
+/**
+ *	@brief Checks whether frames are waiting for a receiver, in which
+ *	case new frames must be queued behind them
+ *	@param cid - CID of the receiving node
+ *	@return 1 if frames are waiting, 0 if not
+ */
+int sendq_busy(unsigned int cid)
+{
+	struct send_bucket *bucket;
+	struct send_queue *queue;
+	int busy;
+
+	/* nothing has to be locked while every receiver keeps up */
+	if (__atomic_load_n(&sendq_backlog, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	bucket = &send_queues[cid & (SENDQ_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	queue = sendq_find(bucket, cid, 0);
+	busy = (queue != NULL) && (queue->count > 0);
+	pthread_mutex_unlock(&bucket->lock);
+
+	return busy;
+}
+
+/**
+ *	@brief Sends a queued frame without waiting for buffer space
+ *	@param cid - CID of the receiving node
+ *	@param buf - frame, with the distance already appended
+ *	@param bytes - size of the frame
+ *	@return bytes sent, or -1 on error
+ */
+static int sendq_send(unsigned int cid, char *buf, int bytes)
+{
+	union transport_addr addr;
+	socklen_t addrlen;
+
+#ifdef HAVE_CONN
+	if (transport.seqpacket)
+		return conn_send(cid, buf, bytes, NULL);
+#endif
+
+	addrlen = transport_addr(&transport, &addr, cid, SEND_PORT);
+
+	return sendto(sockfd, buf, bytes, SEND_DONTWAIT, &addr.sa, addrlen);
+}
+
+/**
+ *	@brief Sends or drops the frames of a queue until it is empty or
+ *	the receiver's buffer is full again, bucket lock must be held
+ *	@param queue - the queue
+ *	@param now - the current time
+ *	@return 0, or -1 if a frame failed with an error other than a full
+ *	buffer and was dropped
+ */
+static int sendq_drain_queue(struct send_queue *queue, unsigned long long now)
+{
+	unsigned long long sojourn;
+	int i;
+
+	while (queue->count > 0) {
+		i = queue->head;
+		sojourn = now - queue->queued_at[i];
+
+		if (codel_drop(&queue->codel, now, sojourn)) {
+			queue->dropped++;
+		} else if (sendq_send(queue->cid, queue->frame[i],
+				queue->bytes[i]) < 0) {
+			if (send_backlogged())
+				return 0;
+
+			/* send_failed decides whether the node is gone */
+			queue->dropped++;
+			sendq_pop(queue);
+			return -1;
+		} else {
+			queue->sent++;
+		}
+
+		queue->sojourn = sojourn;
+		sendq_pop(queue);
+	}
+
+	return 0;
+}
+
+/**
+ *	@brief Sends what the receivers have room for from every queue,
+ *	must not be called with list_mutex held
+ *	@return void
+ */
+void sendq_drain(void)
+{
+	struct send_bucket *bucket;
+	struct send_queue *queue;
+	unsigned long long now;
+	unsigned int failed;
+	int saved;
+	int bytes;
+	int i;
+
+	if (__atomic_load_n(&sendq_backlog, __ATOMIC_ACQUIRE) == 0)
+		return;
+
+	now = sendq_now();
+	for (i = 0; i < SENDQ_BUCKETS; i++) {
+		bucket = &send_queues[i];
+		do {
+			failed = 0;
+			saved = 0;
+			pthread_mutex_lock(&bucket->lock);
+			for (queue = bucket->head; queue != NULL;
+					queue = queue->next) {
+				if (sendq_drain_queue(queue, now) < 0) {
+					failed = queue->cid;
+					saved = errno;
+					bytes = queue->bytes[(queue->head +
+						SENDQ_LEN - 1) % SENDQ_LEN];
+					break;
+				}
+			}
+			pthread_mutex_unlock(&bucket->lock);
+
+			/* removing the node takes list_mutex */
+			if (failed) {
+				errno = saved;
+				send_failed(failed, bytes);
+			}
+		} while (failed);
+	}
+}
+
+/**
+ *	@brief Frees the queues of nodes which have been removed,
+ *	list_mutex must be held
+ *	@return void
+ */
+void sendq_expire(void)
+{
+	struct send_bucket *bucket;
+	struct send_queue **prev;
+	struct send_queue *queue;
+	int i;
+
+	for (i = 0; i < SENDQ_BUCKETS; i++) {
+		bucket = &send_queues[i];
+		pthread_mutex_lock(&bucket->lock);
+		prev = &bucket->head;
+		while ((queue = *prev) != NULL) {
+			if (cid_index_lookup(queue->cid) != NULL) {
+				prev = &queue->next;
+				continue;
+			}
+			while (queue->count > 0)
+				sendq_pop(queue);
+			*prev = queue->next;
+			free(queue);
+		}
+		pthread_mutex_unlock(&bucket->lock);
+	}
+}
+
+/**
+ *	@brief Logs the depth, wait and drops of every send queue
+ *	@return void
+ */
+void sendq_status(void)
+{
+	struct send_bucket *bucket;
+	struct send_queue *queue;
+	int i;
+
+	print_debug(LOG_INFO, "send queues: %d backlogged, %d frames queued",
+			__atomic_load_n(&sendq_backlog, __ATOMIC_RELAXED),
+			__atomic_load_n(&sendq_frames, __ATOMIC_RELAXED));
+
+	for (i = 0; i < SENDQ_BUCKETS; i++) {
+		bucket = &send_queues[i];
+		pthread_mutex_lock(&bucket->lock);
+		for (queue = bucket->head; queue != NULL; queue = queue->next)
+			print_debug(LOG_INFO, "send queue cid %u: %d queued, %d most queued, %llu us sojourn, %lu sent, %lu dropped",
+					queue->cid, queue->count,
+					queue->max_depth, queue->sojourn,
+					queue->sent, queue->dropped);
+		pthread_mutex_unlock(&bucket->lock);
+	}
+}
+
+/**
+ *	@brief Frees every send queue and the frames still in them
+ *	@return void
+ */
+void sendq_free(void)
+{
+	struct send_queue *queue;
+	int i;
+
+	for (i = 0; i < SENDQ_BUCKETS; i++) {
+		while ((queue = send_queues[i].head) != NULL) {
+			while (queue->count > 0)
+				sendq_pop(queue);
+			send_queues[i].head = queue->next;
+			free(queue);
+		}
+		pthread_mutex_destroy(&send_queues[i].lock);
+	}
+}
+
+/**
+ *	@brief Sends a message to a single node
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param cid - CID of the receiving node
+ *	@param distance - distance from the sender in meters, or -1 if unused
+ *	@return 0 if sent, queued or dropped, -1 if the node was removed from
+ *	the list
+ */
+int send_to_node_vmci(char *buf, int bytes, unsigned int cid, int distance)
+{
+	union transport_addr addr;
+	socklen_t addrlen;
+	char temp[DISTANCE_LEN + 1];
+	int bytes_sent;
+	int parts;
+#ifdef _WIN32
+	WSABUF iov[2];
+	DWORD sent;
+#else
+	struct iovec iov[2];
+	struct msghdr hdr;
+#endif
+
+	addrlen = transport_addr(&transport, &addr, cid, SEND_PORT);
+
+	/* the distance is sent after the frame without copying the frame */
+	parts = 1;
+	if (distance >= 0) {
+		snprintf(temp, sizeof(temp), "welled:%04d:",
+				distance > DISTANCE_MAX ? DISTANCE_MAX : distance);
+		parts = 2;
+	}
+
+#ifdef HAVE_SHM
+	if (shm_send(cid, buf, bytes, (parts == 2) ? temp : NULL) <= 0)
+		return 0;
+#endif
+
+	/* frames already waiting for this node go first */
+	if (sendq_busy(cid)) {
+		sendq_add(cid, buf, bytes, (parts == 2) ? temp : NULL);
+		return 0;
+	}
+
+	/* send frame to this welled client */
+#ifdef _WIN32
+	iov[0].buf = buf;
+	iov[0].len = bytes;
+	iov[1].buf = temp;
+	iov[1].len = DISTANCE_LEN;
+	if (WSASendTo(sockfd, iov, parts, &sent, 0, &addr.sa, addrlen,
+			NULL, NULL) == 0)
+		bytes_sent = sent;
+	else
+		bytes_sent = -1;
+#else
+	iov[0].iov_base = buf;
+	iov[0].iov_len = bytes;
+	iov[1].iov_base = temp;
+	iov[1].iov_len = DISTANCE_LEN;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_name = &addr;
+	hdr.msg_namelen = addrlen;
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = parts;
+#ifdef HAVE_CONN
+	if (transport.seqpacket)
+		bytes_sent = conn_send(cid, buf, bytes,
+				(parts == 2) ? temp : NULL);
+	else
+#endif
+	bytes_sent = sendmsg(sockfd, &hdr, SEND_DONTWAIT);
+#endif
+	if (bytes_sent < 0) {
+		/* a node which is only slow keeps its place in the list */
+		if (send_backlogged()) {
+			sendq_add(cid, buf, bytes, (parts == 2) ? temp : NULL);
+			return 0;
+		}
+		if (send_failed(cid, bytes + DISTANCE_LEN))
+			return -1;
+		return 0;
+	}
+
+	print_debug(LOG_DEBUG, "sent %d bytes to node: %11d", bytes, cid);
+
+	return 0;
+}
+
+/**
+ *	@brief Starts a batch of copies of a frame
+ *	@param batch - the batch
+ *	@param buf - message data, must stay valid until the batch is flushed
+ *	@param bytes - size of message data
+ *	@return void
+ */
+void send_batch_init(struct send_batch *batch, char *buf, int bytes)
+{
+	batch->buf = buf;
+	batch->bytes = bytes;
+	batch->count = 0;
+	batch->off_ring = 0;
+}
+
+/**
+ *	@brief Adds a receiver to a batch, sending the batch once it is full
+ *	@param batch - the batch
+ *	@param cid - CID of the receiving node
+ *	@param distance - distance from the sender in meters, or -1 if unused
+ *	@return void
+ */
+void send_batch_add(struct send_batch *batch, unsigned int cid, int distance)
+{
+#ifdef HAVE_SENDMMSG
+	struct msghdr *hdr;
+	socklen_t addrlen;
+	int i;
+
+#ifdef HAVE_CONN
+	/* every connection is its own socket, there is nothing to batch */
+	if (transport.seqpacket) {
+		send_to_node_vmci(batch->buf, batch->bytes, cid, distance);
+		return;
+	}
+#endif
+
+	i = batch->count;
+	if (distance >= 0)
+		snprintf(batch->distance[i], DISTANCE_LEN + 1, "welled:%04d:",
+				distance > DISTANCE_MAX ? DISTANCE_MAX : distance);
+
+#ifdef HAVE_SHM
+	if (shm_send(cid, batch->buf, batch->bytes,
+			(distance >= 0) ? batch->distance[i] : NULL) <= 0)
+		return;
+#endif
+
+	/* frames already waiting for this node go first */
+	if (sendq_busy(cid)) {
+		sendq_add(cid, batch->buf, batch->bytes,
+				(distance >= 0) ? batch->distance[i] : NULL);
+		return;
+	}
+
+	batch->count++;
+	batch->cid[i] = cid;
+
+	addrlen = transport_addr(&transport, &batch->addr[i], cid, SEND_PORT);
+
+	batch->iov[i][0].iov_base = batch->buf;
+	batch->iov[i][0].iov_len = batch->bytes;
+
+	hdr = &batch->msgs[i].msg_hdr;
+	memset(hdr, 0, sizeof(struct msghdr));
+	hdr->msg_name = &batch->addr[i];
+	hdr->msg_namelen = addrlen;
+	hdr->msg_iov = batch->iov[i];
+	hdr->msg_iovlen = 1;
+
+	if (distance >= 0) {
+		batch->iov[i][1].iov_base = batch->distance[i];
+		batch->iov[i][1].iov_len = DISTANCE_LEN;
+		hdr->msg_iovlen = 2;
+	}
+
+	if (batch->count == SEND_BATCH)
+		send_batch_flush(batch);
+#else
+	send_to_node_vmci(batch->buf, batch->bytes, cid, distance);
+#endif
+}
+
+#ifdef HAVE_SENDMMSG
+/**
+ *	@brief Queues or gives up on a copy of a batch which could not be sent
+ *	@param batch - the batch
+ *	@param i - the copy
+ *	@return void
+ */
+static void send_batch_failed(struct send_batch *batch, int i)
+{
+	if (send_backlogged())
+		sendq_add(batch->cid[i], batch->buf, batch->bytes,
+				(batch->msgs[i].msg_hdr.msg_iovlen == 2) ?
+				batch->distance[i] : NULL);
+	else
+		send_failed(batch->cid[i], batch->bytes + DISTANCE_LEN);
+}
+
+/**
+ *	@brief Sends some of the copies in a batch with sendmmsg
+ *	@param batch - the batch
+ *	@param from - the first copy
+ *	@param to - one past the last copy
+ *	@return void
+ */
+static void send_batch_range(struct send_batch *batch, int from, int to)
+{
+	int ret;
+
+	while (from < to) {
+		ret = sendmmsg(sockfd, batch->msgs + from, to - from,
+				SEND_DONTWAIT);
+		if (ret < 0) {
+			/* the first copy left failed, skip past it */
+			send_batch_failed(batch, from);
+			from++;
+			continue;
+		}
+		from += ret;
+	}
+}
+#endif
+
+/**
+ *	@brief Sends every copy waiting in a batch
+ *	a copy for a node whose buffer is full is queued and other failures
+ *	are handled by send_failed, the rest of the batch is still sent
+ *	@param batch - the batch
+ *	@return void
+ */
+void send_batch_flush(struct send_batch *batch)
+{
+#ifdef HAVE_SENDMMSG
+#ifdef HAVE_IO_URING
+	if (uring_io.sending && !batch->off_ring) {
+		uring_backend_send(batch);
+		batch->count = 0;
+		return;
+	}
+#endif
+
+	send_batch_range(batch, 0, batch->count);
+
+	print_debug(LOG_DEBUG, "sent %d bytes to %d nodes", batch->bytes,
+			batch->count);
+#endif
+	batch->count = 0;
+}
+
+/**
+ *	@brief Frame being relayed and the node which sent it
+ */
+struct relay {
+	/** copies waiting to be sent */
+	struct send_batch *batch;
+	/** CID of the sender, 0 for frames from other hosts */
+	unsigned int cid;
+	/** latitude of the sender */
+	float latitude;
+	/** longitude of the sender */
+	float longitude;
+};
+
+/**
+ *	@brief Adds a member of a room to a batch if it is in range
+ *	@param set - published members of the room
+ *	@param pos - position of the receiving node in set
+ *	@param arg - the struct relay to send
+ *	@return void
+ */
+static void send_in_range(struct member_set *set, int pos, void *arg)
+{
+	struct relay *relay;
+	int distance;
+
+	relay = arg;
+
+	/* determine distance between the nodes */
+	if (set->cid[pos] == relay->cid)
+		distance = 0;
+	else
+		distance = get_distance(set->latitude[pos],
+			set->longitude[pos], relay->latitude,
+			relay->longitude);
+
+	/* skip nodes out of range */
+	if ((distance > RADIO_RANGE) || (distance < 0))
+		return;
+
+	send_batch_add(relay->batch, set->cid[pos], distance);
+}
+
+/**
+ *	@brief Receivers of a frame split over the fan-out pool, either the
+ *	members of a room or a neighbour table
+ */
+struct fanout {
+	/** the sender, batch is unused */
+	struct relay relay;
+	/** frame being relayed */
+	char *buf;
+	/** size of the frame */
+	int bytes;
+	/** members of the room, NULL when sending to table */
+	struct member_set *set;
+	/** neighbours of the sender, NULL when sending to set */
+	struct neighbour_table *table;
+};
+
+/**
+ *	@brief Sends a frame to a range of the receivers of a struct fanout
+ *	@param arg - the struct fanout
+ *	@param worker - worker number, 0 is the thread which started fan-out
+ *	@param first - first receiver
+ *	@param last - one past the last receiver
+ *	@return void
+ */
+static void fanout_job(void *arg, int worker, int first, int last)
+{
+	struct send_batch batch;
+	struct fanout *fan;
+	struct relay relay;
+	int i;
+
+	fan = arg;
+
+	send_batch_init(&batch, fan->buf, fan->bytes);
+	/* the io_uring send ring belongs to the thread which started */
+	batch.off_ring = (worker != 0);
+
+	relay = fan->relay;
+	relay.batch = &batch;
+
+	for (i = first; i < last; i++) {
+		if (fan->table != NULL)
+			send_batch_add(&batch, fan->table->cid[i],
+					fan->table->distance[i]);
+		else if (!send_distance || (fan->relay.cid == 0))
+			send_batch_add(&batch, fan->set->cid[i], -1);
+		else
+			send_in_range(fan->set, i, &relay);
+	}
+
+	send_batch_flush(&batch);
+}
+
+/**
+ *	@brief Spreads the receivers of a large fan-out over the fan-out pool
+ *	the frame and receivers are shared read only and stay valid since
+ *	this returns only once every copy is sent, must be called from a
+ *	read section without list_mutex held
+ *	@param fan - the frame and receivers
+ *	@param count - number of receivers
+ *	@return 0 if sent, -1 if the caller should send it itself
+ */
+static int fanout_run(struct fanout *fan, int count)
+{
+	if ((fanout_pool.count < 2) || (count < fanout_threshold))
+		return -1;
+
+	/* another relay worker has the pool, this frame goes out serially */
+	if (pthread_mutex_trylock(&fanout_mutex) != 0)
+		return -1;
+
+	work_pool_run(&fanout_pool, 0, count, SEND_BATCH, fanout_job, fan);
+	pthread_mutex_unlock(&fanout_mutex);
+
+	return 0;
+}
+
+/**
+ *	@brief Adds all members of a room to a batch
+ *	with send_distance only the grid cells around the sender are walked,
+ *	frames from other hosts go to every member, must be called from a
+ *	read section
+ *	@param batch - copies of the message to send
+ *	@param room - the room to send to
+ *	@param cid - CID of the sender, 0 for frames from other hosts
+ *	@param lat - latitude of the sender
+ *	@param lon - longitude of the sender
+ *	@return void
+ */
+void send_to_room_vmci(struct send_batch *batch, struct room *room,
+		unsigned int cid, float lat, float lon)
+{
+	struct member_set *set;
+	struct relay relay;
+	struct fanout fan;
+	int i;
+
+	set = __atomic_load_n(&room->set, __ATOMIC_ACQUIRE);
+	if (set == NULL)
+		return;
+
+	/* large rooms are shared out, each member is checked for range */
+	fan.relay.cid = cid;
+	fan.relay.latitude = lat;
+	fan.relay.longitude = lon;
+	fan.buf = batch->buf;
+	fan.bytes = batch->bytes;
+	fan.set = set;
+	fan.table = NULL;
+	if (fanout_run(&fan, set->count) == 0)
+		return;
+
+	/* frames from other hosts carry no location to measure from */
+	if (!send_distance || (cid == 0)) {
+		for (i = 0; i < set->count; i++)
+			send_batch_add(batch, set->cid[i], -1);
+		return;
+	}
+
+	relay.batch = batch;
+	relay.cid = cid;
+	relay.latitude = lat;
+	relay.longitude = lon;
+
+	grid_visit(set, lat, lon, send_in_range, &relay);
+}
+
+/**
+ *	@brief Sends message to every node in a neighbour table
+ *	must be called from a read section
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param table - neighbours of the sender
+ *	@return void
+ */
+void send_to_neighbours_vmci(char *buf, int bytes,
+		struct neighbour_table *table)
+{
+	struct send_batch batch;
+	struct fanout fan;
+	int i;
+
+	memset(&fan, 0, sizeof(fan));
+	fan.buf = buf;
+	fan.bytes = bytes;
+	fan.table = table;
+	if (fanout_run(&fan, table->count) == 0)
+		return;
+
+	send_batch_init(&batch, buf, bytes);
+
+	for (i = 0; i < table->count; i++)
+		send_batch_add(&batch, table->cid[i], table->distance[i]);
+
+	send_batch_flush(&batch);
+}
+
+/**
+ *	@brief Sends message to all nodes in the room of the sender
+ *	when room checks are disabled all rooms are sent to. the sender is
+ *	passed by value so this can run without list_mutex, it must be
+ *	called from a read section
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param cid - CID of the sender, 0 for frames from other hosts
+ *	@param room_id - symbol id of the room of the sender
+ *	@param lat - latitude of the sender
+ *	@param lon - longitude of the sender
+ *	@return void - assumes success
+ */
+void send_to_nodes_vmci(char *buf, int bytes, unsigned int cid, int room_id,
+		float lat, float lon)
+{
+	struct send_batch batch;
+	struct room *room;
+
+	print_debug(LOG_DEBUG, "sending to nodes in room %s",
+			sym_name(room_id));
+
+	send_batch_init(&batch, buf, bytes);
+
+	if (!check_room) {
+		for (room = __atomic_load_n(&rooms, __ATOMIC_ACQUIRE);
+				room != NULL; room = room->next)
+			send_to_room_vmci(&batch, room, cid, lat, lon);
+	} else {
+		room = search_room(room_id);
+		if (room != NULL)
+			send_to_room_vmci(&batch, room, cid, lat, lon);
+	}
+
+	send_batch_flush(&batch);
+}
+
+/**
+ *	@brief Frees all of the nodes in the linked list
+ *	@return void - assumes success
+ */
+void free_list(void)
+{
+	struct client *temp = NULL;
+	struct client *curr = NULL;
+
+	curr = head;
+
+	while (curr != NULL) {
+		temp = curr;
+		curr = curr->next;
+		free(temp->neighbours);
+		free(temp);
+	}
+
+	head = NULL;
+	tail = NULL;
+	free(moved_nodes);
+	moved_nodes = NULL;
+	free(moved_tables);
+	moved_tables = NULL;
+	moved_count = 0;
+	moved_size = 0;
+	cid_index_free();
+	free_rooms();
+	epoch_free();
+}
+
+#ifndef _WIN32
+/**
+ *	@brief Signal handler which prints nodes
+ *	@return void
+ */
+void usr1_handler(void)
+{
+	print_status = 1;
+}
+
+/**
+ *	@brief Signal handler which causes program to exit
+ *	@return void - calls exit()
+ */
+void signal_handler(void)
+{
+	running = 0;
+}
+#endif
+
+/**
+ *
+ */
+void update_node_info(struct client *node, struct update_2 *data)
+{
+	struct room *old_room;
+	int update_file;
+	int name_id;
+	int room_id;
+	int old_pos;
+
+	update_file = 0;
+
+	/* TODO make sure we dont lose existing name */
+
+	if ((strnlen(data->name, NAME_LEN) > 0) &&
+			((name_id = sym_intern(data->name, NAME_LEN - 1)) >= 0)) {
+		node->name_id = name_id;
+		update_file = 1;
+	} else {
+		print_debug(LOG_DEBUG, "no name in update");
+	}
+
+	if ((strnlen(data->room, UUID_LEN) > 0) &&
+			((room_id = sym_intern(data->room, UUID_LEN - 1)) >= 0) &&
+			(room_id != node->room_id)) {
+		/* move the node and its location to its new room */
+		old_room = node->bucket;
+		old_pos = node->bucket_pos;
+		node->room_id = room_id;
+		if (room_add_member(node) < 0) {
+			print_debug(LOG_ERR, "error: could not add node %11d to room %s",
+					node->cid, sym_name(node->room_id));
+			node->room_id = old_room->room_id;
+			node->bucket = old_room;
+			node->bucket_pos = old_pos;
+		} else {
+			NODE_TIME(node) = old_room->set->time[old_pos];
+			NODE_LAT(node) = old_room->set->latitude[old_pos];
+			NODE_LON(node) = old_room->set->longitude[old_pos];
+			NODE_ALT(node) = old_room->set->altitude[old_pos];
+			node_moved(node);
+			room_remove_pos(old_room, old_pos);
+		}
+		update_file = 1;
+	} else {
+		print_debug(LOG_DEBUG, "no room in update");
+	}
+
+	if (update_file) {
+		print_debug(LOG_INFO, "node name %s room %s\n",
+				sym_name(node->name_id),
+				sym_name(node->room_id));
+		update_cache_file_info(node);
+	}
+}
+
+#ifndef _WIN32
+/**
+ *	@brief Opens the UDP socket frames from other wmasterd hosts arrive on
+ *	@return the socket, exits on failure
+ */
+int hosts_socket_open(void)
+{
+	int sockfd;
+	struct sockaddr_in bindaddr;
+
+	memset(&bindaddr, 0, sizeof(bindaddr));
+
+	// create socket
+	sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sockfd < 0) {
+		sock_error("wmasterd: socket");
+		printf("wmasterd: could not create udp listen socket\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bindaddr.sin_family = AF_INET;
+	bindaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	bindaddr.sin_port = htons(HOST_PORT);
+
+	// bind
+	if (bind(sockfd, (struct sockaddr *)&bindaddr, sizeof(bindaddr)) < 0) {
+		sock_error("wmasterd: bind");
+	}
+
+	return sockfd;
+}
+
+/**
+ *	@brief Receives one frame from another wmasterd host and relays it to
+ *	the members of its room
+ *	@param sockfd - socket from hosts_socket_open
+ *	@return void
+ */
+void recv_from_host(int sockfd)
+{
+	char src_host[16];
+	char buf[BUFF_LEN];
+	int bytes;
+	struct sockaddr_in cliaddr;
+	socklen_t addrlen;
+
+	addrlen = sizeof(struct sockaddr);
+	memset(&cliaddr, 0, sizeof(cliaddr));
+
+	// recv packet
+	bytes = recvfrom(sockfd, (char *)buf, BUFF_LEN, 0,
+			(struct sockaddr *)&cliaddr, &addrlen);
+
+	/* the rooms a peer has members in, not a frame */
+	if ((bytes >= (int)strlen(PEER_ROOMS)) &&
+			(memcmp(buf, PEER_ROOMS, strlen(PEER_ROOMS)) == 0)) {
+		peer_interest(buf, bytes, &cliaddr);
+		return;
+	}
+
+	if (bytes <= UUID_LEN)
+		return;
+
+	inet_ntop(AF_INET, &cliaddr.sin_addr, src_host, sizeof(src_host));
+	if (verbose) {
+		print_debug(LOG_DEBUG, "received %d bytes from src host: %s",
+			bytes, src_host);
+	}
+
+	relay_from_host(buf, bytes);
+}
+
+/**
+ *	@brief Relays a frame from another wmasterd host to the local members
+ *	of its room
+ *	@param buf - the frame followed by the room trailer
+ *	@param bytes - size of buf
+ *	@return void
+ */
+void relay_from_host(char *buf, int bytes)
+{
+	struct relay_job job;
+	int room_id;
+
+	if (bytes <= UUID_LEN)
+		return;
+
+	/* parse out room, there is nothing to do if it has no members */
+	epoch_enter();
+	room_id = sym_lookup(buf + bytes - UUID_LEN + 1, UUID_LEN - 1);
+	if (room_id >= 0) {
+		/* frames from other hosts carry a room but no local node */
+		job.frame = NULL;
+		job.buf = buf;
+		job.bytes = bytes - UUID_LEN;
+		job.hosts = 0;
+		job.cid = 0;
+		job.room_id = room_id;
+		job.latitude = 0;
+		job.longitude = 0;
+		job.table = NULL;
+		relay_submit(&job);
+	}
+	epoch_exit();
+}
+
+/**
+ *	@brief Thread relaying frames from other wmasterd hosts
+ *	@return NULL
+ */
+void *recv_from_hosts(void *arg)
+{
+	int sockfd;
+
+	sockfd = hosts_socket_open();
+
+	while (running)
+		recv_from_host(sockfd);
+
+	close(sockfd);
+
+	return ((void *)0);
+}
+#endif
+
+/**
+ *	@brief Sets up the receive buffers of a batch
+ *	@param batch - the batch
+ *	@return 0 on success, -1 on failure
+ */
+int recv_batch_init(struct recv_batch *batch)
+{
+	int i;
+
+	memset(batch, 0, sizeof(struct recv_batch));
+
+	for (i = 0; i < RECV_BATCH; i++) {
+		batch->buffer[i] = frame_get(&frame_pool);
+		if (!batch->buffer[i]) {
+			recv_batch_free(batch);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ *	@brief Frees the receive buffers of a batch
+ *	@param batch - the batch
+ *	@return void
+ */
+void recv_batch_free(struct recv_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < RECV_BATCH; i++) {
+		if (batch->buffer[i])
+			frame_put(&frame_pool, batch->buffer[i]);
+		batch->buffer[i] = NULL;
+	}
+}
+
+/**
+ *	@brief Gets the buffers of a batch back from the relay workers
+ *	a buffer still queued is swapped for a free one, the buffers which
+ *	can be received into are moved to the front
+ *	@param batch - the batch
+ *	@return number of buffers which can be received into
+ */
+static int recv_batch_ready(struct recv_batch *batch)
+{
+	void *spare;
+	void *buf;
+	int ready;
+	int i;
+
+	ready = 0;
+	for (i = 0; i < RECV_BATCH; i++) {
+		buf = batch->buffer[i];
+		if (frame_refs(buf) > 1) {
+			spare = frame_get(&frame_pool);
+			if (spare == NULL)
+				continue;
+			/* the worker frees it once the frame is relayed */
+			frame_put(&frame_pool, buf);
+			buf = spare;
+		}
+		batch->buffer[i] = batch->buffer[ready];
+		batch->buffer[ready++] = buf;
+	}
+
+	return ready;
+}
+
+/**
+ *	@brief Takes the datagrams waiting on the welled socket
+ *	without recvmmsg only one datagram is taken
+ *	@param batch - the batch to fill
+ *	@return number of datagrams received
+ */
+int recv_batch_fill(struct recv_batch *batch)
+{
+#ifdef HAVE_RECVMMSG
+	int i;
+#else
+	socklen_t addrlen;
+#endif
+	int ready;
+	int ret;
+
+	batch->count = 0;
+
+	/* every buffer waiting for a worker with none to spare */
+	ready = recv_batch_ready(batch);
+	if (ready == 0)
+		return 0;
+
+#ifdef HAVE_RECVMMSG
+	for (i = 0; i < ready; i++) {
+		batch->iov[i].iov_base = FRAME_DATA(batch->buffer[i]);
+		batch->iov[i].iov_len = BUFF_LEN;
+		memset(&batch->msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+		batch->msgs[i].msg_hdr.msg_name = &batch->addr[i];
+		batch->msgs[i].msg_hdr.msg_namelen =
+			sizeof(union transport_addr);
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		memset(&batch->addr[i], 0, sizeof(union transport_addr));
+	}
+
+	/* select said there is at least one, take whatever else is there */
+	ret = recvmmsg(myservfd, batch->msgs, ready, MSG_DONTWAIT, NULL);
+	if (ret < 0)
+		return 0;
+
+	for (i = 0; i < ret; i++) {
+		batch->frame[i] = FRAME_DATA(batch->buffer[i]);
+		batch->bid[i] = -1;
+		batch->bytes[i] = batch->msgs[i].msg_len;
+	}
+#else
+	addrlen = sizeof(union transport_addr);
+	memset(&batch->addr[0], 0, sizeof(union transport_addr));
+
+	ret = recvfrom(myservfd, FRAME_DATA(batch->buffer[0]), BUFF_LEN, 0,
+			(struct sockaddr *)&batch->addr[0], &addrlen);
+	if (ret < 0)
+		return 0;
+
+	batch->frame[0] = FRAME_DATA(batch->buffer[0]);
+	batch->bid[0] = -1;
+	batch->bytes[0] = ret;
+	ret = 1;
+#endif
+
+	batch->count = ret;
+
+	return ret;
+}
+
+/**
+ *	@brief Looks up or adds the sender of a datagram and handles updates
+ *	and status messages, must be called with list_mutex held
+ *	@param batch - the batch
+ *	@param i - position of the datagram in the batch
+ *	@return 1 if the datagram is a frame to relay, 0 otherwise
+ */
+static int recv_admit(struct recv_batch *batch, int i)
+{
+	char *buf;
+	int bytes;
+	unsigned int src_cid;
+	char room[UUID_LEN];
+	char name[NAME_LEN];
+	char uuid[UUID_LEN];
+	struct client *node;
+
+	buf = batch->frame[i];
+	bytes = batch->bytes[i];
+	src_cid = transport_id(&transport, &batch->addr[i]);
+	print_debug(LOG_DEBUG, "received %d bytes from src host: %d",
+			bytes, src_cid);
+
+	memset(room, 0, UUID_LEN);
+	memset(name, 0, NAME_LEN);
+	memset(uuid, 0, UUID_LEN);
+
+	node = search_node_vmci(src_cid);
+	if (!node) {
+		print_debug(LOG_DEBUG, "node %11d does not exist", src_cid);
+		get_vm_info(src_cid, room, name, uuid);
+		add_node_vmci(src_cid, room, name, uuid);
+		/* make sure we added the node */
+		node = search_node_vmci(src_cid);
+		if (!node) {
+			print_debug(LOG_ERR, "error: adding node %11d",
+					src_cid);
+			return 0;
+		}
+	} else if (update_room && check_room) {
+		print_debug(LOG_DEBUG, "checking vmx for room update\n");
+		/* check for room change if room enforced */
+		get_vm_info(src_cid, room, name, uuid);
+		if (sym_lookup(room, UUID_LEN - 1) != node->room_id) {
+			remove_node_vmci(src_cid);
+			add_node_vmci(src_cid, room, name, uuid);
+			/* make sure we updated the node */
+			node = search_node_vmci(src_cid);
+			if (!node) {
+				print_debug(LOG_ERR, "error: updating node %11d\n", src_cid);
+				return 0;
+			}
+		}
+	}
+
+	if ((bytes == 2) || (bytes == 5)) {
+		print_debug(LOG_INFO, "node %11d has sent status",
+					src_cid);
+		return 0;
+	}
+
+	/*
+	 * format of this message:
+	 * gelled:<struct client>
+	 */
+	/* check for gelled updates from gelled-ctrl */
+	if (strncmp(buf, "gelled:", 7) == 0) {
+
+		/*
+		 * if new size, copy into new buf
+		 * if old size, copy into old buf, then copy
+		 *	from the old into the new buf
+		 */
+
+		print_debug(LOG_INFO, "gelled update received from %11d",
+				src_cid);
+
+		struct update_2 data_2;
+
+		/*
+		 * update_1 is size 1100
+		 * update_2 is size 1136
+		 */
+
+		if (bytes == (sizeof(struct update) + 7)) {
+			print_debug(LOG_INFO, "update version 1 from %11d", src_cid);
+			struct update data_1;
+			/* pull loc from the buffer */
+			memcpy(&data_1, buf + 7, sizeof(struct update));
+			/* convert update to update_2 */
+			strncpy(data_2.version, "1", 8);
+			strncpy(data_2.follow, data_1.follow, FOLLOW_LEN - 1);
+			data_2.latitude = data_1.latitude;
+			data_2.longitude = data_1.longitude;
+			data_2.altitude = data_1.altitude;
+			data_2.velocity = data_1.velocity;
+			data_2.heading = data_1.heading;
+			snprintf(data_2.room, UUID_LEN, "%d", data_1.room_id);
+			strncpy(data_2.name, data_1.name, NAME_LEN - 1);
+			data_2.cid = data_1.cid;
+		} else if (bytes == (sizeof(struct update_2) + 7)) {
+			print_debug(LOG_INFO, "update version 2 from %11d", src_cid);
+			print_debug(LOG_DEBUG, "copying %d bytes from buf to data_2 which is size %d",
+					sizeof(struct update_2), sizeof(data_2));
+			/* pull loc from the buffer */
+			memcpy(&data_2, buf + 7, sizeof(struct update_2));
+		} else {
+			print_debug(LOG_ERR, "update version unknown from %11d", src_cid);
+			return 0;
+		}
+		update_node_info(node, &data_2);
+		update_node_location(node, &data_2);
+		return 0;
+	}
+
+	/* take what fan-out needs from the sender while it is locked */
+	batch->room_id[i] = node->room_id;
+	batch->latitude[i] = NODE_LAT(node);
+	batch->longitude[i] = NODE_LON(node);
+	batch->table[i] = node_neighbours(node);
+
+	return 1;
+}
+
+/**
+ *	@brief Receives a batch of datagrams from welled and relays the frames
+ *	@return void
+ */
+void recv_from_welled_vmci(void)
+{
+	if (recv_batch_fill(&recv_batch) == 0)
+		return;
+
+	recv_batch_process(&recv_batch);
+}
+
+/**
+ *	@brief Relays the frames in a filled batch
+ *	list_mutex is held once for the whole batch, only while the senders
+ *	are looked up or updated
+ *	@param batch - the batch
+ *	@return void
+ */
+void recv_batch_process(struct recv_batch *batch)
+{
+	struct relay_job job;
+	int i;
+
+	/* entered first so every table taken stays valid once unlocked */
+	epoch_enter();
+
+	pthread_mutex_lock(&list_mutex);
+	for (i = 0; i < batch->count; i++)
+		batch->relay[i] = recv_admit(batch, i);
+	pthread_mutex_unlock(&list_mutex);
+
+	/* not a status message or an update, relay */
+	for (i = 0; i < batch->count; i++) {
+		if (!batch->relay[i])
+			continue;
+
+		/* frames in provided io_uring buffers are copied if queued */
+		job.frame = (batch->bid[i] < 0) ? batch->buffer[i] : NULL;
+		job.buf = batch->frame[i];
+		job.bytes = batch->bytes[i];
+		job.hosts = 1;
+		job.cid = transport_id(&transport, &batch->addr[i]);
+		job.room_id = batch->room_id[i];
+		job.latitude = batch->latitude[i];
+		job.longitude = batch->longitude[i];
+		job.table = batch->table[i];
+		relay_submit(&job);
+	}
+
+	epoch_exit();
+}
+
+#ifdef HAVE_CONN
+/**
+ *	@brief Sets up the connection hash
+ *	@return void
+ */
+void conn_init(void)
+{
+	int i;
+
+	for (i = 0; i < CONN_BUCKETS; i++) {
+		pthread_mutex_init(&conn_clients[i].lock, NULL);
+		conn_clients[i].head = NULL;
+	}
+}
+
+/**
+ *	@brief Finds the connection of a node, bucket lock must be held
+ *	@param bucket - the bucket of the CID
+ *	@param cid - CID of the node
+ *	@return the connection, or NULL
+ */
+static struct conn_client *conn_find(struct conn_bucket *bucket,
+		unsigned int cid)
+{
+	struct conn_client *client;
+
+	for (client = bucket->head; client != NULL; client = client->next) {
+		if (client->cid == cid)
+			return client;
+	}
+
+	return NULL;
+}
+
+/**
+ *	@brief Sends a message on the connection of a node
+ *	@param cid - CID of the receiving node
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param distance - distance sent after the frame, or NULL
+ *	@return bytes sent, or -1 with errno set, ENOTCONN if the node has
+ *	no connection
+ */
+int conn_send(unsigned int cid, char *buf, int bytes, char *distance)
+{
+	struct conn_bucket *bucket;
+	struct conn_client *client;
+	struct iovec iov[2];
+	struct msghdr hdr;
+	int ret;
+	int err;
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = bytes;
+	iov[1].iov_base = distance;
+	iov[1].iov_len = DISTANCE_LEN;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = (distance != NULL) ? 2 : 1;
+
+	bucket = &conn_clients[cid & (CONN_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	client = conn_find(bucket, cid);
+	if (client == NULL) {
+		pthread_mutex_unlock(&bucket->lock);
+		errno = ENOTCONN;
+		return -1;
+	}
+	ret = sendmsg(client->fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL);
+	err = errno;
+	if (ret >= 0)
+		client->sent++;
+	pthread_mutex_unlock(&bucket->lock);
+
+	errno = err;
+	return ret;
+}
+
+/**
+ *	@brief Tells whether a node holds a connection, a node which does
+ *	is not expired however long it is quiet
+ *	@param cid - CID of the node
+ *	@return 1 if connected, 0 if not
+ */
+int conn_connected(unsigned int cid)
+{
+	struct conn_bucket *bucket;
+	int ret;
+
+	if (__atomic_load_n(&conn_count, __ATOMIC_RELAXED) == 0)
+		return 0;
+
+	bucket = &conn_clients[cid & (CONN_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	ret = (conn_find(bucket, cid) != NULL);
+	pthread_mutex_unlock(&bucket->lock);
+
+	return ret;
+}
+
+/**
+ *	@brief Takes a connection out of the hash and closes it
+ *	@param client - the connection
+ *	@return void
+ */
+static void conn_close(struct conn_client *client)
+{
+	struct conn_bucket *bucket;
+	struct conn_client **prev;
+
+	bucket = &conn_clients[client->cid & (CONN_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	for (prev = &bucket->head; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == client) {
+			*prev = client->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&bucket->lock);
+
+	/* closing it takes it out of epoll */
+	conn_by_fd[client->fd] = NULL;
+	close(client->fd);
+	free(client);
+	__atomic_sub_fetch(&conn_count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ *	@brief Accepts a connection from a welled, replacing one the same
+ *	node held before
+ *	@param r - the reactor the connection is added to
+ *	@return void
+ */
+void conn_accept(struct reactor *r)
+{
+	union transport_addr addr;
+	struct conn_bucket *bucket;
+	struct conn_client *client;
+	struct conn_client *old;
+	struct conn_client **grown;
+	socklen_t len;
+	int size;
+	int fd;
+
+	memset(&addr, 0, sizeof(union transport_addr));
+	len = sizeof(union transport_addr);
+	fd = accept(conn_fd, &addr.sa, &len);
+	if (fd < 0) {
+		sock_error("wmasterd: accept");
+		return;
+	}
+
+	if (fd >= conn_by_fd_len) {
+		size = (fd + 1 > conn_by_fd_len * 2) ? fd + 1 :
+			conn_by_fd_len * 2;
+		grown = realloc(conn_by_fd, size * sizeof(struct conn_client *));
+		if (grown == NULL) {
+			close(fd);
+			return;
+		}
+		memset(grown + conn_by_fd_len, 0,
+				(size - conn_by_fd_len) * sizeof(struct conn_client *));
+		conn_by_fd = grown;
+		conn_by_fd_len = size;
+	}
+
+	client = calloc(1, sizeof(struct conn_client));
+	if (client == NULL) {
+		close(fd);
+		return;
+	}
+	client->cid = transport_id(&transport, &addr);
+	client->fd = fd;
+	client->added = current_time;
+	transport_buffers(&transport, fd, TRANSPORT_CONN_BUF);
+
+	bucket = &conn_clients[client->cid & (CONN_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	old = conn_find(bucket, client->cid);
+	client->next = bucket->head;
+	bucket->head = client;
+	pthread_mutex_unlock(&bucket->lock);
+	__atomic_add_fetch(&conn_count, 1, __ATOMIC_RELAXED);
+
+	/* welled reconnected before its old connection was seen to close */
+	if (old != NULL)
+		conn_close(old);
+
+	conn_by_fd[fd] = client;
+	if (reactor_add(r, fd) < 0) {
+		conn_close(client);
+		return;
+	}
+
+	print_debug(LOG_NOTICE, "connection from node %u", client->cid);
+}
+
+/**
+ *	@brief Relays the messages waiting on a connection, and removes the
+ *	node once the connection closes
+ *	@param fd - the connection
+ *	@return void
+ */
+void conn_recv(int fd)
+{
+	struct conn_client *client;
+	unsigned int cid;
+	int closed;
+	int ready;
+	int ret;
+	int i;
+
+	if ((fd >= conn_by_fd_len) || (conn_by_fd[fd] == NULL))
+		return;
+	client = conn_by_fd[fd];
+
+	recv_batch.count = 0;
+	ready = recv_batch_ready(&recv_batch);
+
+	/* each message is one frame, the address is the same for all */
+	closed = 0;
+	for (i = 0; i < ready; i++) {
+		ret = recv(fd, FRAME_DATA(recv_batch.buffer[i]), BUFF_LEN,
+				MSG_DONTWAIT);
+		if (ret <= 0) {
+			if ((ret == 0) || ((errno != EAGAIN) &&
+					(errno != EWOULDBLOCK) &&
+					(errno != EINTR)))
+				closed = 1;
+			break;
+		}
+		recv_batch.frame[i] = FRAME_DATA(recv_batch.buffer[i]);
+		recv_batch.bid[i] = -1;
+		recv_batch.bytes[i] = ret;
+		transport_addr(&transport, &recv_batch.addr[i], client->cid,
+				SEND_PORT);
+		client->received++;
+	}
+	recv_batch.count = i;
+
+	if (recv_batch.count > 0)
+		recv_batch_process(&recv_batch);
+
+	if (!closed)
+		return;
+
+	cid = client->cid;
+	conn_close(client);
+
+	print_debug(LOG_NOTICE, "del: %11d connection closed", cid);
+	pthread_mutex_lock(&list_mutex);
+	if (cid_index_lookup(cid) != NULL)
+		remove_node_vmci(cid);
+	pthread_mutex_unlock(&list_mutex);
+}
+
+/**
+ *	@brief Logs the traffic of every connection
+ *	@return void
+ */
+void conn_status(void)
+{
+	struct conn_bucket *bucket;
+	struct conn_client *client;
+	int i;
+
+	if (conn_fd < 0)
+		return;
+
+	print_debug(LOG_INFO, "connections: %d",
+			__atomic_load_n(&conn_count, __ATOMIC_RELAXED));
+
+	for (i = 0; i < CONN_BUCKETS; i++) {
+		bucket = &conn_clients[i];
+		pthread_mutex_lock(&bucket->lock);
+		for (client = bucket->head; client != NULL;
+				client = client->next)
+			print_debug(LOG_INFO, "connection cid %u: %lu received, %lu sent, up %ld sec",
+					client->cid, client->received,
+					client->sent,
+					(long)(current_time - client->added));
+		pthread_mutex_unlock(&bucket->lock);
+	}
+}
+
+/**
+ *	@brief Closes every connection and the socket they are accepted on
+ *	@return void
+ */
+void conn_free(void)
+{
+	struct conn_client *client;
+	int i;
+
+	for (i = 0; i < CONN_BUCKETS; i++) {
+		while ((client = conn_clients[i].head) != NULL) {
+			conn_clients[i].head = client->next;
+			close(client->fd);
+			free(client);
+		}
+		pthread_mutex_destroy(&conn_clients[i].lock);
+	}
+	conn_count = 0;
+
+	free(conn_by_fd);
+	conn_by_fd = NULL;
+	conn_by_fd_len = 0;
+
+	if (conn_fd >= 0)
+		transport_close(&transport, conn_fd, transport.host,
+				RECV_PORT);
+	conn_fd = -1;
+}
+#endif
+
+#ifdef HAVE_SHM
+/**
+ *	@brief Sets up the shared memory channel hash
+ *	@return void
+ */
+void shm_init(void)
+{
+	int i;
+
+	for (i = 0; i < SHM_BUCKETS; i++) {
+		pthread_mutex_init(&shm_clients[i].lock, NULL);
+		shm_clients[i].head = NULL;
+	}
+}
+
+/**
+ *	@brief Pushes a frame to the down ring of a node with a channel
+ *	@param cid - CID of the receiving node
+ *	@param buf - message data
+ *	@param bytes - size of message data
+ *	@param distance - distance sent after the frame, or NULL
+ *	@return 0 if pushed, -1 if dropped because the ring was full, 1 if
+ *	the node has no channel and the frame must be sent
+ */
+int shm_send(unsigned int cid, char *buf, int bytes, char *distance)
+{
+	struct shm_bucket *bucket;
+	struct shm_client *client;
+	int ret;
+
+	if (__atomic_load_n(&shm_count, __ATOMIC_RELAXED) == 0)
+		return 1;
+
+	bucket = &shm_clients[cid & (SHM_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+
+	for (client = bucket->head; client != NULL; client = client->next) {
+		if (client->cid == cid)
+			break;
+	}
+	if (client == NULL) {
+		pthread_mutex_unlock(&bucket->lock);
+		return 1;
+	}
+
+	ret = shm_ring_push(&client->ch.map->down, buf, bytes, distance,
+			(distance != NULL) ? DISTANCE_LEN : 0);
+	if (ret < 0)
+		client->dropped++;
+	else
+		client->sent++;
+
+	/* only when welled is asleep */
+	if (ret > 0)
+		shm_signal(client->ch.down_event);
+
+	pthread_mutex_unlock(&bucket->lock);
+
+	return (ret < 0) ? -1 : 0;
+}
+
+/**
+ *	@brief Maps a channel offered by a welled on this host, replacing
+ *	one it offered before
+ *	@param r - the reactor the eventfd of the channel is added to
+ *	@return void
+ */
+void shm_accept(struct reactor *r)
+{
+	union transport_addr addr;
+	struct shm_bucket *bucket;
+	struct shm_client **prev;
+	struct shm_client *client;
+	struct shm_client *old;
+	socklen_t len;
+
+	client = calloc(1, sizeof(struct shm_client));
+	if (client == NULL)
+		return;
+
+	memset(&addr, 0, sizeof(union transport_addr));
+	len = sizeof(union transport_addr);
+	if (shm_channel_accept(shm_fd, &client->ch, &addr.sa, &len) < 0) {
+		print_debug(LOG_WARNING, "warning: invalid shared memory channel offered");
+		free(client);
+		return;
+	}
+	client->cid = transport_id(&transport, &addr);
+	client->added = current_time;
+
+	bucket = &shm_clients[client->cid & (SHM_BUCKETS - 1)];
+	pthread_mutex_lock(&bucket->lock);
+	old = NULL;
+	for (prev = &bucket->head; *prev != NULL; prev = &(*prev)->next) {
+		if ((*prev)->cid == client->cid) {
+			old = *prev;
+			*prev = old->next;
+			break;
+		}
+	}
+	client->next = bucket->head;
+	bucket->head = client;
+	pthread_mutex_unlock(&bucket->lock);
+
+	/* closing the old eventfd takes it out of epoll */
+	if (old != NULL) {
+		shm_channel_free(&old->ch);
+		free(old);
+	} else {
+		__atomic_add_fetch(&shm_count, 1, __ATOMIC_RELAXED);
+	}
+
+	reactor_add(r, client->ch.up_event);
+	__atomic_store_n(&client->ch.map->attached, 1, __ATOMIC_RELEASE);
+
+	print_debug(LOG_NOTICE, "shared memory channel from node %u",
+			client->cid);
+
+	/* welled did not signal what it pushed before it was attached */
+	shm_drain();
+}
+
+/**
+ *	@brief Moves the records of an up ring into a batch, bucket lock
+ *	must be held
+ *	@param batch - the batch
+ *	@param client - the channel
+ *	@param ready - buffers of the batch which can be filled
+ *	@return 1 if the batch is full, 0 once the ring is empty
+ */
+static int shm_fill(struct recv_batch *batch, struct shm_client *client,
+		int ready)
+{
+	struct shm_ring *ring;
+	char *buf;
+	int len;
+	int i;
+
+	ring = &client->ch.map->up;
+	while (batch->count < ready) {
+		len = shm_ring_peek(ring, &buf);
+		if (len == -1) {
+			/* sleep unless welled pushed while we looked */
+			if (shm_ring_sleep(ring))
+				continue;
+			return 0;
+		}
+		if (len < 0) {
+			/* welled wrote past its records, skip all of them */
+			if (client->errors++ == 0)
+				print_debug(LOG_WARNING, "warning: invalid shared memory ring from node %u",
+						client->cid);
+			__atomic_store_n(&ring->head,
+					__atomic_load_n(&ring->tail,
+					__ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+			return 0;
+		}
+
+		/* copied, welled may write the ring again once it is popped */
+		if (len <= BUFF_LEN) {
+			i = batch->count++;
+			memcpy(FRAME_DATA(batch->buffer[i]), buf, len);
+			batch->frame[i] = FRAME_DATA(batch->buffer[i]);
+			batch->bid[i] = -1;
+			batch->bytes[i] = len;
+			transport_addr(&transport, &batch->addr[i], client->cid,
+					SEND_PORT);
+			client->received++;
+		}
+		shm_ring_pop(ring, len);
+	}
+
+	return 1;
+}
+
+/**
+ *	@brief Relays the frames waiting in every up ring, batches are
+ *	filled from as many rings as it takes and handled like datagrams
+ *	from the socket
+ *	@return void
+ */
+void shm_drain(void)
+{
+	struct shm_bucket *bucket;
+	struct shm_client *client;
+	int ready;
+	int full;
+	int i;
+
+	recv_batch.count = 0;
+	ready = recv_batch_ready(&recv_batch);
+
+	shm_pending = 0;
+	for (i = 0; i < SHM_BUCKETS; i++) {
+		bucket = &shm_clients[i];
+		do {
+			if (ready == 0) {
+				/* retried once the relay workers give some back */
+				shm_pending = 1;
+				return;
+			}
+
+			full = 0;
+			pthread_mutex_lock(&bucket->lock);
+			for (client = bucket->head; (client != NULL) && !full;
+					client = client->next)
+				full = shm_fill(&recv_batch, client, ready);
+			pthread_mutex_unlock(&bucket->lock);
+
+			/* relayed unlocked, relaying pushes to down rings */
+			if (full) {
+				recv_batch_process(&recv_batch);
+				recv_batch.count = 0;
+				ready = recv_batch_ready(&recv_batch);
+			}
+		} while (full);
+	}
+
+	if (recv_batch.count > 0)
+		recv_batch_process(&recv_batch);
+}
+
+/**
+ *	@brief Frees the channels of nodes which have been removed,
+ *	list_mutex must be held
+ *	@return void
+ */
+void shm_expire(void)
+{
+	struct shm_bucket *bucket;
+	struct shm_client **prev;
+	struct shm_client *client;
+	int i;
+
+	for (i = 0; i < SHM_BUCKETS; i++) {
+		bucket = &shm_clients[i];
+		pthread_mutex_lock(&bucket->lock);
+		prev = &bucket->head;
+		while ((client = *prev) != NULL) {
+			if ((cid_index_lookup(client->cid) != NULL) ||
+					(current_time - client->added < SHM_GRACE)) {
+				prev = &client->next;
+				continue;
+			}
+			print_debug(LOG_INFO, "shared memory channel of node %u closed",
+					client->cid);
+			*prev = client->next;
+			shm_channel_free(&client->ch);
+			free(client);
+			__atomic_sub_fetch(&shm_count, 1, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&bucket->lock);
+	}
+}
+
+/**
+ *	@brief Logs the traffic of every shared memory channel
+ *	@return void
+ */
+void shm_status(void)
+{
+	struct shm_bucket *bucket;
+	struct shm_client *client;
+	int i;
+
+	if (shm_fd < 0)
+		return;
+
+	print_debug(LOG_INFO, "shared memory channels: %d",
+			__atomic_load_n(&shm_count, __ATOMIC_RELAXED));
+
+	for (i = 0; i < SHM_BUCKETS; i++) {
+		bucket = &shm_clients[i];
+		pthread_mutex_lock(&bucket->lock);
+		for (client = bucket->head; client != NULL;
+				client = client->next)
+			print_debug(LOG_INFO, "shared memory cid %u: %lu received, %lu sent, %lu dropped, %u up ring full, %lu invalid",
+					client->cid, client->received,
+					client->sent, client->dropped,
+					client->ch.map->up.full,
+					client->errors);
+		pthread_mutex_unlock(&bucket->lock);
+	}
+}
+
+/**
+ *	@brief Unmaps every shared memory channel and closes the socket
+ *	they are offered on
+ *	@return void
+ */
+void shm_free(void)
+{
+	struct shm_client *client;
+	int i;
+
+	for (i = 0; i < SHM_BUCKETS; i++) {
+		while ((client = shm_clients[i].head) != NULL) {
+			shm_clients[i].head = client->next;
+			shm_channel_free(&client->ch);
+			free(client);
+		}
+		pthread_mutex_destroy(&shm_clients[i].lock);
+	}
+	shm_count = 0;
+
+	if (shm_fd >= 0)
+		transport_close(&transport, shm_fd, transport.host,
+				TRANSPORT_SHM_PORT);
+	shm_fd = -1;
+}
+#endif
+
+/**
+ *	@brief Sends a frame to the other hosts and to the nodes which can
+ *	hear its sender
+ *	@param job - the frame and its sender
+ *	@return void
+ */
+void relay_run(struct relay_job *job)
+{
+	epoch_enter();
+
+#ifndef _WIN32
+	/* send to other wmasterd hosts */
+	if (job->hosts)
+		send_to_hosts(job->buf, job->bytes, job->room_id);
+#endif
+
+	if (job->table != NULL)
+		send_to_neighbours_vmci(job->buf, job->bytes, job->table);
+	else
+		send_to_nodes_vmci(job->buf, job->bytes, job->cid,
+				job->room_id, job->latitude, job->longitude);
+
+	epoch_exit();
+}
+
+/**
+ *	@brief Relays a frame, or queues a copy of it for the worker which
+ *	owns the room of its sender, must be called from the read section
+ *	the job was loaded in
+ *	@param job - the frame and its sender, the frame is not kept
+ *	@return void
+ */
+void relay_submit(struct relay_job *job)
+{
+	struct relay_worker *worker;
+	struct relay_job *copy;
+	void *frame;
+
+	if (relay_count == 0) {
+		relay_run(job);
 		return;
+	}
 
-	char *buffer;
-	char temp[UUID_LEN + 1];
-	struct sockaddr_in dest_addr;
-	int sock_opts;
-	int sockfd;
-	int bytes_sent;
+	worker = &relay_workers[(unsigned int)job->room_id % relay_count];
 
-	/* create packet data */
-	buffer = malloc(bytes + UUID_LEN);
-	memcpy(buffer, buf, bytes);
-	snprintf(temp, UUID_LEN + 1, ":%s", room);
-	memcpy(buffer + bytes, temp, UUID_LEN);
+	if (job->frame != NULL) {
+		/* shared with the receive batch, which swaps it out if needed */
+		frame = job->frame;
+		frame_hold(frame);
+	} else {
+		frame = frame_get(&frame_pool);
+		if (frame == NULL) {
+			__atomic_fetch_add(&worker->dropped, 1,
+					__ATOMIC_RELAXED);
+			return;
+		}
+		memcpy(FRAME_DATA(frame), job->buf, job->bytes);
+	}
 
-	/* set destination address */
-	memset(&dest_addr, 0, sizeof(struct sockaddr_in));
-	dest_addr.sin_family = AF_INET;
-	inet_pton(AF_INET, broadcast_addr, &dest_addr.sin_addr.s_addr);
-	dest_addr.sin_port = htons(2018);
+	copy = frame;
+	memcpy(copy, job, sizeof(struct relay_job));
+	copy->frame = frame;
+	copy->buf = FRAME_DATA(frame);
 
-	/* setup socket */
-	sock_opts = 1;
-	sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR|SO_BROADCAST,
-		(const char *)&sock_opts, sizeof(int));
-	if (sockfd < 0) {
-		sock_error("wmasterd: socket");
-		print_debug(LOG_ERR, "error: could not create udp socket\n");
-		free(buffer);
+	if (mpsc_push(&worker->ring, copy) < 0) {
+		/* a busy medium loses frames, the room falls behind otherwise */
+		__atomic_fetch_add(&worker->dropped, 1, __ATOMIC_RELAXED);
+		frame_put(&frame_pool, frame);
 		return;
 	}
 
-	/* send packet */
-	bytes_sent = sendto(sockfd, buffer, bytes + UUID_LEN, 0,
-			(const struct sockaddr *)&dest_addr,
-			sizeof(dest_addr));
-	if (bytes_sent < 0)
-		sock_error("wmasterd: sendto\n");
-	else
-		print_debug(LOG_DEBUG, "sent %d bytes to %s\n",
-				bytes_sent, broadcast_addr);
-
-	/* cleanup */
-	close(sockfd);
-	free(buffer);
+	if (__atomic_exchange_n(&worker->sleeping, 0, __ATOMIC_SEQ_CST))
+		sem_post(&worker->wake);
 }
-#endif
 
 /**
- *	@brief Sends message to all nodes in linked list
- *	@param buf - message data
- *	@param bytes - size of message data
- *	@param room - the uuid of the room
- *	@param node - the struct client node that sent the data
- *	@return void - assumes success
+ *	@brief Relays the frames queued for a worker until it is stopped
+ *	@param arg - the struct relay_worker
+ *	@return NULL
  */
-void send_to_nodes_vmci(char *buf, int bytes, struct client *node)
+static void *relay_worker_main(void *arg)
 {
-	struct client *curr;
-	struct client *temp;
-	int age;
-	int now;
-	int distance;
-	char *send_buf;
-	int bytes_sent;
-
-	curr = head;
-	age = 0;
-	now = time(NULL);
+	struct relay_worker *worker;
+	struct relay_job *job;
+	int idle;
 
-	print_debug(LOG_DEBUG, "sending to nodes in room %s", node->room);
+	worker = arg;
+	idle = 0;
 
-	while (curr != NULL) {
-		age = now - curr->time;
+	for (;;) {
+		job = mpsc_pop(&worker->ring);
+		if (job == NULL) {
+			if (++idle < RELAY_SPIN)
+				continue;
 
-		/* skip node if room differs */
-		if (check_room && (strncmp(
-				curr->room, node->room, UUID_LEN - 1) != 0)) {
-			print_debug(LOG_INFO, "skipped: %11d room: %36s\n", curr->cid, curr->room);
-			curr = curr->next;
-			continue;
-		} else if (age > 300) {
-			/* save our place */
-			temp = curr->next;
+			/* look once more after saying so, or a push is missed */
+			__atomic_store_n(&worker->sleeping, 1, __ATOMIC_SEQ_CST);
+			job = mpsc_pop(&worker->ring);
+			if (job == NULL) {
+				if (__atomic_load_n(&worker->stop,
+						__ATOMIC_SEQ_CST))
+					break;
+				while ((sem_wait(&worker->wake) < 0) &&
+						(errno == EINTR))
+					;
+				idle = 0;
+				continue;
+			}
+			__atomic_store_n(&worker->sleeping, 0,
+					__ATOMIC_SEQ_CST);
+		}
 
-			/* remove stale node */
-			print_debug(LOG_DEBUG, "stale node found\n");
-			remove_node_vmci(curr->cid);
+		idle = 0;
+		relay_run(job);
+		frame_put(&frame_pool, job->frame);
 
-			/* go to next node */
-			curr = temp;
-			continue;
-		}
+		/* the reclaiming thread moves the pin on this count */
+		__atomic_store_n(&worker->relayed, worker->relayed + 1,
+				__ATOMIC_RELEASE);
+	}
 
-		memset(&servaddr_vm, 0, sizeof(servaddr_vm));
-		servaddr_vm.svm_cid = curr->cid;
-		servaddr_vm.svm_port = SEND_PORT;
-		servaddr_vm.svm_family = af;
+	return NULL;
+}
 
-		/* send frame to this welled client */
-		if (send_distance) {
-			/* determine distance between the nodes */
-			if (curr == node)
-				distance = 0;
-			else
-				distance = get_distance(curr, node);
+/**
+ *	@brief Starts the relay workers
+ *	@param threads - number of workers, 0 or less relays on the
+ *	receiving thread
+ *	@return 0 on success, -1 on failure
+ */
+int relay_workers_init(int threads)
+{
+	struct relay_worker *worker;
+	int i;
 
-			/* skip nodes out of range */
-			if ((distance > 2500) || (distance < 0)) {
-				curr = curr->next;
-				continue;
-			}
+	relay_count = 0;
+	if (threads <= 0)
+		return 0;
+	if (threads > RELAY_WORKERS_MAX)
+		threads = RELAY_WORKERS_MAX;
 
-			char temp[13];
-			/* add the distance to the buf */
-			send_buf = malloc(bytes + 12);
-			memset(send_buf, 0, bytes + 12);
-			memcpy(send_buf, buf, bytes);
-			snprintf(temp, sizeof(temp), "welled:%04d:", distance);
-			memcpy(send_buf + bytes, temp, 12);
-			bytes_sent = sendto(sockfd, (char *)send_buf,
-				bytes + 12, 0,
-				(struct sockaddr *)&servaddr_vm,
-				sizeof(struct sockaddr));
-			free(send_buf);
-		} else {
-			/* send frame to this welled client */
-			bytes_sent = sendto(sockfd, (char *)buf, bytes, 0,
-				(struct sockaddr *)&servaddr_vm,
-				sizeof(struct sockaddr));
-		}
-		if (bytes_sent < 0) {
-			if (verbose) {
-				sock_error("wmasterd: sendto");
-				print_debug(LOG_ERR, "error: name %s cid %d bytes %d\n", curr->name, curr->cid, bytes + 12);
-				print_node(curr);
-			}
-			/* since powering off a VM results in this error
-			 * we should remove the node from list
-			 */
-			temp = curr->next;
-			remove_node_vmci(curr->cid);
-			curr = temp;
-		} else {
-			print_debug(LOG_DEBUG, "sent %d bytes to node: %11d room: %s", bytes, curr->cid, curr->room);
+	relay_workers = calloc(threads, sizeof(struct relay_worker));
+	if (!relay_workers) {
+		perror("wmasterd: calloc");
+		return -1;
+	}
 
-			curr = curr->next;
+	for (i = 0; i < threads; i++) {
+		worker = &relay_workers[i];
+		if (mpsc_init(&worker->ring, RELAY_QUEUE_LEN) < 0) {
+			relay_workers_free();
+			return -1;
 		}
+		sem_init(&worker->wake, 0, 0);
+
+		/* nothing is queued yet, hold only what is being read now */
+		worker->pin = epoch_pin_alloc();
+		worker->seen_epoch = epoch_readers_oldest();
+		epoch_pin(worker->pin, worker->seen_epoch);
+
+		if (pthread_create(&worker->tid, NULL, relay_worker_main,
+				worker) != 0) {
+			perror("wmasterd: pthread_create relay_worker_main");
+			sem_destroy(&worker->wake);
+			mpsc_free(&worker->ring);
+			relay_workers_free();
+			return -1;
+		}
+		relay_count++;
 	}
+
+	print_debug(LOG_INFO, "relaying on %d worker threads", relay_count);
+
+	return 0;
 }
 
 /**
- *	@brief Frees all of the nodes in the linked list
- *	@return void - assumes success
+ *	@brief Relays what is still queued and stops the relay workers
+ *	@return void
  */
-void free_list(void)
+void relay_workers_free(void)
 {
-	struct client *temp = NULL;
-	struct client *curr = NULL;
+	struct relay_worker *worker;
+	int i;
 
-	curr = head;
+	for (i = 0; i < relay_count; i++) {
+		worker = &relay_workers[i];
+		__atomic_store_n(&worker->stop, 1, __ATOMIC_SEQ_CST);
+		sem_post(&worker->wake);
+	}
 
-	while (curr != NULL) {
-		temp = curr;
-		curr = curr->next;
-		free(temp);
+	for (i = 0; i < relay_count; i++) {
+		worker = &relay_workers[i];
+		pthread_join(worker->tid, NULL);
+		sem_destroy(&worker->wake);
+		mpsc_free(&worker->ring);
 	}
 
-	head = NULL;
+	free(relay_workers);
+	relay_workers = NULL;
+	relay_count = 0;
 }
 
-#ifndef _WIN32
 /**
- *	@brief Signal handler which prints nodes
+ *	@brief Moves the epoch pin of each relay worker past the frames it
+ *	has relayed, called before reclaiming with list_mutex held
  *	@return void
  */
-void usr1_handler(void)
+void relay_workers_quiesce(void)
 {
-	print_status = 1;
+	struct relay_worker *worker;
+	unsigned long relayed;
+	int i;
+
+	for (i = 0; i < relay_count; i++) {
+		worker = &relay_workers[i];
+
+		/* frames queued by the last call can no longer be waiting */
+		relayed = __atomic_load_n(&worker->relayed, __ATOMIC_ACQUIRE);
+		if ((long)(relayed - worker->seen_claimed) >= 0)
+			epoch_pin(worker->pin, worker->seen_epoch);
+
+		/*
+		 * a frame queued from here on was either loaded in a
+		 * read section seen here or after it, and one queued before
+		 * is counted in seen_claimed
+		 */
+		worker->seen_epoch = epoch_readers_oldest();
+		worker->seen_claimed = mpsc_claimed(&worker->ring);
+	}
 }
 
 /**
- *	@brief Signal handler which causes program to exit
- *	@return void - calls exit()
+ *	@brief Logs the node list, as requested by usr1 or the console
+ *	@return void
  */
-void signal_handler(void)
+void print_status_now(void)
 {
-	running = 0;
+	struct relay_worker *worker;
+	unsigned long relayed;
+	int i;
+
+	pthread_mutex_lock(&list_mutex);
+	print_debug(LOG_INFO, "status requested");
+	list_nodes_vmci();
+	pthread_mutex_unlock(&list_mutex);
+
+	print_debug(LOG_INFO, "frame buffers: %u in use, %u most in use, %u total, %lu exhausted",
+			__atomic_load_n(&frame_pool.in_use, __ATOMIC_RELAXED),
+			__atomic_load_n(&frame_pool.high_water,
+				__ATOMIC_RELAXED),
+			frame_pool.count,
+			__atomic_load_n(&frame_pool.exhausted,
+				__ATOMIC_RELAXED));
+
+	for (i = 0; i < relay_count; i++) {
+		worker = &relay_workers[i];
+		relayed = __atomic_load_n(&worker->relayed, __ATOMIC_RELAXED);
+		print_debug(LOG_INFO, "relay worker %d: %lu relayed, %lu queued, %lu dropped, %lu full",
+				i, relayed,
+				mpsc_claimed(&worker->ring) - relayed,
+				__atomic_load_n(&worker->dropped,
+					__ATOMIC_RELAXED),
+				mpsc_full(&worker->ring));
+	}
+
+#ifdef HAVE_IO_URING
+	if (use_uring)
+		uring_backend_status();
+#endif
+
+	print_debug(LOG_INFO, "send errors: %lu transient, %lu other, %lu nodes removed",
+			__atomic_load_n(&send_transient, __ATOMIC_RELAXED),
+			__atomic_load_n(&send_errors, __ATOMIC_RELAXED),
+			__atomic_load_n(&send_evictions, __ATOMIC_RELAXED));
+	sendq_status();
+#ifndef _WIN32
+	peer_status();
+#endif
+#ifdef HAVE_CONN
+	conn_status();
+#endif
+#ifdef HAVE_SHM
+	shm_status();
+#endif
 }
+
+/**
+ *	@brief Expires stale nodes and their send queues, frees what readers
+ *	are done with and sends GPS sentences, called every TICK_SECONDS
+ *	@return void
+ */
+void run_tick(void)
+{
+	pthread_mutex_lock(&list_mutex);
+	current_time = time(NULL);
+	clear_inactive_nodes();
+	sendq_expire();
+#ifdef HAVE_SHM
+	shm_expire();
+#endif
+	relay_workers_quiesce();
+	epoch_reclaim();
+	pthread_mutex_unlock(&list_mutex);
+
+	sendq_drain();
+	send_gps_to_nodes();
+#ifndef _WIN32
+	if (peer_count > 0)
+		peer_advertise();
 #endif
+}
 
+#ifdef HAVE_EPOLL
 /**
- *
+ *	@brief Blocks the handled signals and sets up the epoll instance with
+ *	the signal, timer and console descriptors
+ *	must be called before any thread is started so every thread
+ *	inherits the signal mask
+ *	@param r - the reactor
+ *	@return 0 on success, -1 on failure
  */
-void update_node_info(struct client *node, struct update_2 *data)
+int reactor_init(struct reactor *r)
 {
-	int update_file;
+	struct itimerspec tick;
+	sigset_t mask;
+
+	r->epfd = -1;
+	r->sigfd = -1;
+	r->timerfd = -1;
+	r->hostfd = -1;
+	r->console = -1;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGQUIT);
+	sigaddset(&mask, SIGUSR1);
+	if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+		perror("wmasterd: pthread_sigmask");
+		return -1;
+	}
+	signal(SIGHUP, SIG_IGN);
 
-	update_file = 0;
+	r->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (r->epfd < 0) {
+		perror("wmasterd: epoll_create1");
+		return -1;
+	}
 
-	/* TODO make sure we dont lose existing name */
+	r->sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (r->sigfd < 0) {
+		perror("wmasterd: signalfd");
+		return -1;
+	}
 
-	if ((strnlen(data->name, NAME_LEN) > 0) &&
-			(strnlen(data->name, NAME_LEN) > 0)) {
-		strncpy(node->name, data->name, NAME_LEN - 1);
-		update_file = 1;
-	} else {
-		print_debug(LOG_DEBUG, "no name in update");
+	r->timerfd = timerfd_create(CLOCK_MONOTONIC,
+			TFD_NONBLOCK | TFD_CLOEXEC);
+	if (r->timerfd < 0) {
+		perror("wmasterd: timerfd_create");
+		return -1;
 	}
 
-	if ((strnlen(data->room, UUID_LEN) > 0) &&
-			(strncmp(node->room, data->room, UUID_LEN - 1) != 0)) {
-		strncpy(node->room, data->room, UUID_LEN - 1);
-		update_file = 1;
-	} else {
-		print_debug(LOG_DEBUG, "no room in update");
+	memset(&tick, 0, sizeof(tick));
+	tick.it_value.tv_sec = TICK_SECONDS;
+	tick.it_interval.tv_sec = TICK_SECONDS;
+	if (timerfd_settime(r->timerfd, 0, &tick, NULL) < 0) {
+		perror("wmasterd: timerfd_settime");
+		return -1;
 	}
 
-	if (update_file) {
-		print_debug(LOG_INFO, "node name %s room %s\n", node->name, node->room);
-		update_cache_file_info(node);
+	if ((reactor_add(r, r->sigfd) < 0) || (reactor_add(r, r->timerfd) < 0))
+		return -1;
+
+	/* stdin may be a file or closed when run as a service */
+	if (reactor_add(r, STDIN_FILENO) == 0)
+		r->console = STDIN_FILENO;
+
+	return 0;
+}
+
+/**
+ *	@brief Watches a descriptor for input
+ *	@param r - the reactor
+ *	@param fd - the descriptor
+ *	@return 0 on success, -1 on failure
+ */
+int reactor_add(struct reactor *r, int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		/* regular files can not be watched, which is expected */
+		if (fd != STDIN_FILENO)
+			perror("wmasterd: epoll_ctl");
+		return -1;
 	}
+
+	return 0;
 }
 
-#ifndef _WIN32
-void *recv_from_hosts(void *arg)
+/**
+ *	@brief Handles the signals waiting on the signal descriptor
+ *	@param r - the reactor
+ *	@return void
+ */
+static void reactor_signal(struct reactor *r)
 {
+	struct signalfd_siginfo info;
 
-	char *buffer;
-	struct client node;
-	char src_host[16];
-	char buf[BUFF_LEN];
-	int sockfd;
+	while (read(r->sigfd, &info, sizeof(info)) == sizeof(info)) {
+		if (info.ssi_signo == SIGUSR1)
+			print_status_now();
+		else
+			running = 0;
+	}
+}
+
+/**
+ *	@brief Handles input on the console, 'p' prints the node list
+ *	@param r - the reactor
+ *	@return void
+ */
+static void reactor_console(struct reactor *r)
+{
+	char buf[64];
 	int bytes;
-	struct sockaddr_in bindaddr;
-	struct sockaddr_in cliaddr;
-	socklen_t addrlen;
+	int i;
 
-	addrlen = sizeof(struct sockaddr);
-	memset(&cliaddr, 0, sizeof(cliaddr));
-	memset(&bindaddr, 0, sizeof(bindaddr));
+	bytes = read(r->console, buf, sizeof(buf));
+	if (bytes <= 0) {
+		/* closed, stop watching it */
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, r->console, NULL);
+		r->console = -1;
+		return;
+	}
 
-	// create socket
-	sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-	if (sockfd < 0) {
-		sock_error("wmasterd: socket");
-		printf("wmasterd: could not create udp listen socket\n");
-		exit(EXIT_FAILURE);
+	for (i = 0; i < bytes; i++) {
+		if (buf[i] == 'p') {
+			print_status_now();
+			break;
+		}
 	}
+}
 
-	bindaddr.sin_family = AF_INET;
-	bindaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-	bindaddr.sin_port = htons(2018);
+/**
+ *	@brief Waits for and handles events until wmasterd is stopped
+ *	@param r - the reactor
+ *	@return void
+ */
+void reactor_run(struct reactor *r)
+{
+	struct epoll_event events[REACTOR_EVENTS];
+	uint64_t expirations;
+	int timeout;
+	int count;
+	int fd;
+	int i;
 
-	// bind
-	if (bind(sockfd, (struct sockaddr *)&bindaddr, sizeof(bindaddr)) < 0) {
-		sock_error("wmasterd: bind");
+	while (running) {
+		/* vsock has no writability per receiver, so poll while queued */
+		timeout = (__atomic_load_n(&sendq_backlog, __ATOMIC_RELAXED) >
+				0) ? SENDQ_POLL_MS : -1;
+#ifdef HAVE_SHM
+		if (shm_pending)
+			timeout = SENDQ_POLL_MS;
+#endif
+		count = epoll_wait(r->epfd, events, REACTOR_EVENTS, timeout);
+		if (count < 0) {
+			if (errno != EINTR)
+				perror("wmasterd: epoll_wait");
+			continue;
+		}
+
+		current_time = time(NULL);
+
+		for (i = 0; (i < count) && running; i++) {
+			fd = events[i].data.fd;
+			if (fd == myservfd) {
+				recv_from_welled_vmci();
+#ifdef HAVE_IO_URING
+			} else if (fd == uring_io.eventfd) {
+				uring_backend_reap(r);
+#endif
+			} else if (fd == r->hostfd) {
+				recv_from_host(r->hostfd);
+			} else if (fd == r->timerfd) {
+				/* ticks missed while busy are not made up */
+				if (read(r->timerfd, &expirations,
+						sizeof(expirations)) > 0)
+					run_tick();
+			} else if (fd == r->sigfd) {
+				reactor_signal(r);
+			} else if (fd == r->console) {
+				reactor_console(r);
+#ifdef HAVE_CONN
+			} else if (fd == conn_fd) {
+				conn_accept(r);
+			} else if (transport.seqpacket) {
+				/* a connection from welled */
+				conn_recv(fd);
+#endif
+#ifdef HAVE_SHM
+			} else if (fd == shm_fd) {
+				shm_accept(r);
+			} else {
+				/* the up_event of a shared memory channel */
+				shm_clear(fd);
+				shm_drain();
+#endif
+			}
+		}
+
+#ifdef HAVE_SHM
+		if (shm_pending)
+			shm_drain();
+#endif
+		sendq_drain();
 	}
+}
 
-	while (running) {
+/**
+ *	@brief Closes the descriptors owned by the reactor
+ *	@param r - the reactor
+ *	@return void
+ */
+void reactor_free(struct reactor *r)
+{
+	if (r->hostfd >= 0)
+		close(r->hostfd);
+	if (r->timerfd >= 0)
+		close(r->timerfd);
+	if (r->sigfd >= 0)
+		close(r->sigfd);
+	if (r->epfd >= 0)
+		close(r->epfd);
+}
 
-		// recv packet
-		bytes = recvfrom(sockfd, (char *)buf, BUFF_LEN, 0,
-				(struct sockaddr *)&cliaddr, &addrlen);
-		if (bytes < 0)
-			continue;
+#ifdef HAVE_IO_URING
+/** size of a provided buffer, the name is written ahead of the payload */
+#define URING_RECV_BUF_SIZE	(sizeof(struct io_uring_recvmsg_out) + \
+				sizeof(struct sockaddr_storage) + BUFF_LEN)
+
+/**
+ *	@brief Posts a multishot receive on a socket
+ *	@param fd - the socket
+ *	@param msg - template giving the room kept for the source address
+ *	@param tag - URING_RECV_WELLED or URING_RECV_HOST
+ *	@return 0 on success, -1 on failure
+ */
+static int uring_backend_post(int fd, struct msghdr *msg, int tag)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe(&uring_io.recv);
+	if (!sqe)
+		return -1;
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_RECV_GROUP;
+	sqe->user_data = tag;
+
+	return uring_submit(&uring_io.recv, 0) < 0 ? -1 : 0;
+}
+
+/**
+ *	@brief Moves a socket from epoll to a multishot receive
+ *	@param r - the reactor
+ *	@param fd - the socket
+ *	@param msg - receive template for the socket
+ *	@param tag - URING_RECV_WELLED or URING_RECV_HOST
+ *	@return 0 on success, -1 if the socket stays with epoll
+ */
+static int uring_backend_take(struct reactor *r, int fd, struct msghdr *msg,
+		int tag)
+{
+	if (uring_backend_post(fd, msg, tag) < 0) {
+		print_debug(LOG_ERR, "io_uring receive on %d failed: %s",
+				fd, strerror(errno));
+		return -1;
+	}
+
+	epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+	return 0;
+}
+
+/**
+ *	@brief Sets up the io_uring rings and moves the sockets to them
+ *	anything the kernel does not support is left to epoll
+ *	@param r - the reactor, with the sockets already added
+ *	@return void
+ */
+void uring_backend_init(struct reactor *r)
+{
+	memset(&uring_io, 0, sizeof(struct uring_backend));
+	uring_io.send.fd = -1;
+	uring_io.recv.fd = -1;
+	uring_io.eventfd = -1;
+
+	if (relay_count > 0) {
+		/* the send ring belongs to the main thread, workers send */
+		print_debug(LOG_NOTICE, "io_uring sends not used with relay workers");
+	} else if (uring_init(&uring_io.send, URING_SEND_ENTRIES) < 0) {
+		print_debug(LOG_NOTICE, "io_uring unavailable, using epoll: %s",
+				strerror(errno));
+		return;
+	} else {
+		uring_io.sending = 1;
+		print_debug(LOG_INFO, "using io_uring for sends");
+	}
+
+	if (uring_init(&uring_io.recv, RECV_BATCH) < 0)
+		goto fallback;
+
+	if (uring_buf_ring_init(&uring_io.recv, URING_RECV_GROUP,
+			URING_RECV_BUFS, URING_RECV_BUF_SIZE) < 0)
+		goto fallback;
+
+	uring_io.eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (uring_io.eventfd < 0)
+		goto fallback;
+
+	if (uring_register_eventfd(&uring_io.recv, uring_io.eventfd) < 0)
+		goto fallback;
+
+	if (reactor_add(r, uring_io.eventfd) < 0)
+		goto fallback;
+
+	uring_io.welled_msg.msg_namelen = sizeof(union transport_addr);
+	uring_io.host_msg.msg_namelen = sizeof(struct sockaddr_in);
+
+	uring_io.receiving = 1;
+	uring_backend_take(r, myservfd, &uring_io.welled_msg,
+			URING_RECV_WELLED);
+	if (r->hostfd >= 0)
+		uring_backend_take(r, r->hostfd, &uring_io.host_msg,
+				URING_RECV_HOST);
 
-		inet_ntop(AF_INET, &cliaddr.sin_addr, src_host, addrlen);
-		if (verbose) {
-			print_debug(LOG_DEBUG, "received %d bytes from src host: %d",
-				bytes, src_host);
-		}
-		/* parse out room */
-		strncpy(node.room, buf + bytes - UUID_LEN + 1, UUID_LEN);
-		buffer = malloc(bytes - UUID_LEN - 1);
+	print_debug(LOG_INFO, "using io_uring for receives");
+	return;
 
-		/* lock list and send */
-		pthread_mutex_lock(&list_mutex);
-		send_to_nodes_vmci(buffer, bytes, &node);
-		pthread_mutex_unlock(&list_mutex);
+fallback:
+	print_debug(LOG_NOTICE, "io_uring receives unavailable, using epoll: %s",
+			strerror(errno));
+	/* closing the eventfd also takes it out of epoll */
+	if (uring_io.eventfd >= 0)
+		close(uring_io.eventfd);
+	uring_io.eventfd = -1;
+	uring_free(&uring_io.recv);
+	memset(&uring_io.recv, 0, sizeof(struct uring));
+	uring_io.recv.fd = -1;
+}
 
-		/* cleanup */
-		close(sockfd);
-		free(buffer);
+/**
+ *	@brief Consumes the completions of the copies of a batch
+ *	@param batch - the batch
+ *	@param done - set for each copy which completed
+ *	@return number of completions consumed
+ */
+static int uring_backend_sent(struct send_batch *batch, char *done)
+{
+	struct io_uring_cqe *cqe;
+	int reaped;
+
+	reaped = 0;
+	while ((cqe = uring_peek(&uring_io.send)) != NULL) {
+		done[cqe->user_data] = 1;
+		if (cqe->res < 0) {
+			errno = -cqe->res;
+			send_batch_failed(batch, cqe->user_data);
+		}
+		uring_seen(&uring_io.send);
+		reaped++;
 	}
-	return ((void *)0);
+
+	return reaped;
 }
-#endif
 
 /**
- *	@brief receive and process vmci packets from client nodes
- *	@return void - assumes success
+ *	@brief Sends every copy in a batch as one chain of linked sendmsg
+ *	requests and waits for all of them to complete, copies the ring
+ *	cannot take or did not complete are sent with sendmmsg
+ *	@param batch - the batch, its buffers are reused once this returns
+ *	@return void
  */
-void recv_from_welled_vmci(void)
+void uring_backend_send(struct send_batch *batch)
 {
-	char buf[VMCI_BUFF_LEN];
-	struct sockaddr_vm cliaddr_vmci;
-	socklen_t addrlen;
-	int bytes;
-	unsigned int src_cid;
-	char room[UUID_LEN];
-	char old_room[UUID_LEN];
-	char name[NAME_LEN];
-	char uuid[UUID_LEN];
-	struct client *node;
+	struct io_uring_sqe *sqe;
+	struct io_uring_sqe *prev;
+	char done[SEND_BATCH];
+	int inflight;
+	int queued;
+	int reaped;
+	int from;
+	int i;
 
-	addrlen = sizeof(struct sockaddr);
-	memset(&cliaddr_vmci, 0, sizeof(cliaddr_vmci));
+	memset(done, 0, sizeof(done));
 
-	bytes = recvfrom(myservfd, (char *)buf, BUFF_LEN, 0,
-			(struct sockaddr *)&cliaddr_vmci, &addrlen);
-	if (bytes < 0)
-		return;
-	src_cid = (unsigned int)cliaddr_vmci.svm_cid;
-	print_debug(LOG_DEBUG, "received %d bytes from src host: %d",
-			bytes, src_cid);
+	/* the ring is drained after every batch so every copy should fit */
+	prev = NULL;
+	for (queued = 0; queued < batch->count; queued++) {
+		sqe = uring_get_sqe(&uring_io.send);
+		if (sqe == NULL)
+			break;
+		/* a hard link keeps the order but not the failure */
+		if (prev != NULL)
+			prev->flags = IOSQE_IO_HARDLINK;
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = sockfd;
+		sqe->addr = (unsigned long)&batch->msgs[queued].msg_hdr;
+		sqe->len = 1;
+		sqe->msg_flags = SEND_DONTWAIT;
+		sqe->user_data = queued;
+		prev = sqe;
+	}
 
-	memset(room, 0, UUID_LEN);
-	memset(old_room, 0, UUID_LEN);
-	memset(name, 0, NAME_LEN);
-	memset(uuid, 0, UUID_LEN);
+	reaped = 0;
+	inflight = queued;
+	while (reaped < inflight) {
+		if ((uring_submit(&uring_io.send, inflight - reaped) < 0) &&
+				(errno != EAGAIN) && (errno != EBUSY)) {
+			print_debug(LOG_ERR, "io_uring send failed: %s, using sendmmsg",
+					strerror(errno));
+			uring_io.sending = 0;
+			inflight -= uring_withdraw(&uring_io.send);
+			break;
+		}
+		reaped += uring_backend_sent(batch, done);
+	}
 
-	node = search_node_vmci(src_cid);
-	if (!node) {
-		print_debug(LOG_DEBUG, "node %11d does not exist", src_cid);
-		get_vm_info(src_cid, room, name, uuid);
-		add_node_vmci(src_cid, room, name, uuid);
-		/* make sure we added the node */
-		node = search_node_vmci(src_cid);
-		if (!node) {
-			print_debug(LOG_ERR, "error: adding node %11d",
-					src_cid);
-			return;
+	/* the copies the kernel took still point into batch */
+	while (reaped < inflight) {
+		if (uring_wait(&uring_io.send, 1) < 0) {
+			print_debug(LOG_ERR, "io_uring wait failed: %s",
+					strerror(errno));
+			break;
 		}
-	} else if (update_room && check_room) {
-		print_debug(LOG_DEBUG, "checking vmx for room update\n");
-		/* check for room change if room enforced */
-		strncpy(old_room, node->room, UUID_LEN - 1);
-		get_vm_info(src_cid, room, name, uuid);
-		if (strncmp(old_room, room, UUID_LEN  - 1) != 0) {
-			remove_node_vmci(src_cid);
-			add_node_vmci(src_cid, room, name, uuid);
-			/* make sure we updated the node */
-			node = search_node_vmci(src_cid);
-			if (!node) {
-				print_debug(LOG_ERR, "error: updating node %11d\n", src_cid);
-				return;
-			}
+		reaped += uring_backend_sent(batch, done);
+	}
+
+	/* send what the ring did not with sendmmsg */
+	i = 0;
+	while (i < batch->count) {
+		if (done[i]) {
+			i++;
+			continue;
 		}
+		from = i;
+		while ((i < batch->count) && !done[i])
+			i++;
+		send_batch_range(batch, from, i);
 	}
 
-	if ((bytes == 2) || (bytes == 5)) {
-		print_debug(LOG_INFO, "node %11d has sent status",
-					src_cid);
+	print_debug(LOG_DEBUG, "sent %d bytes to %d nodes", batch->bytes,
+			batch->count);
+}
+
+/**
+ *	@brief Relays the frames gathered in recv_batch and gives their
+ *	buffers back to the kernel
+ *	@return void
+ */
+static void uring_backend_relay(void)
+{
+	int i;
+
+	if (recv_batch.count == 0)
 		return;
-	}
 
-	/*
-	 * format of this message:
-	 * gelled:<struct client>
-	 */
-	/* check for gelled updates from gelled-ctrl */
-	if (strncmp(buf, "gelled:", 7) == 0) {
+	recv_batch_process(&recv_batch);
 
-		/*
-		 * if new size, copy into new buf
-		 * if old size, copy into old buf, then copy
-		 *	from the old into the new buf
-		 */
+	for (i = 0; i < recv_batch.count; i++)
+		uring_buf_recycle(&uring_io.recv, recv_batch.bid[i]);
+	recv_batch.count = 0;
+}
 
-		print_debug(LOG_INFO, "gelled update received from %11d",
-				src_cid);
+/**
+ *	@brief Handles the completions of the multishot receives
+ *	frames from welled are relayed in batches of up to RECV_BATCH
+ *	@param r - the reactor
+ *	@return void
+ */
+void uring_backend_reap(struct reactor *r)
+{
+	struct io_uring_recvmsg_out *out;
+	struct io_uring_cqe *cqe;
+	struct msghdr *msg;
+	uint64_t signalled;
+	unsigned int bid;
+	char *payload;
+	int bytes;
+	int tag;
+	int fd;
+	int i;
 
-		struct update_2 data_2;
+	if (read(uring_io.eventfd, &signalled, sizeof(signalled)) < 0)
+		return;
 
-		/*
-		 * update_1 is size 1100
-		 * update_2 is size 1136
-		 */
+	recv_batch.count = 0;
 
-		if (bytes == (sizeof(struct update) + 7)) {
-			print_debug(LOG_INFO, "update version 1 from %11d", src_cid);
-			struct update data_1;
-			/* pull loc from the buffer */
-			memcpy(&data_1, buf + 7, sizeof(struct update));
-			/* convert update to update_2 */
-			strncpy(data_2.version, "1", 8);
-			strncpy(data_2.follow, data_1.follow, FOLLOW_LEN - 1);
-			data_2.latitude = data_1.latitude;
-			data_2.longitude = data_1.longitude;
-			data_2.altitude = data_1.altitude;
-			data_2.velocity = data_1.velocity;
-			data_2.heading = data_1.heading;
-			snprintf(data_2.room, UUID_LEN, "%d", data_1.room_id);
-			strncpy(data_2.name, data_1.name, NAME_LEN - 1);
-			data_2.cid = data_1.cid;
-		} else if (bytes == (sizeof(struct update_2) + 7)) {
-			print_debug(LOG_INFO, "update version 2 from %11d", src_cid);
-			print_debug(LOG_DEBUG, "copying %d bytes from buf to data_2 which is size %d",
-					sizeof(struct update_2), sizeof(data_2));
-			/* pull loc from the buffer */
-			memcpy(&data_2, buf + 7, sizeof(struct update_2));
+	while ((cqe = uring_peek(&uring_io.recv)) != NULL) {
+		tag = cqe->user_data;
+		if (tag == URING_RECV_WELLED) {
+			msg = &uring_io.welled_msg;
+			fd = myservfd;
 		} else {
-			print_debug(LOG_ERR, "update version unknown from %11d", src_cid);
-			return;
+			msg = &uring_io.host_msg;
+			fd = r->hostfd;
 		}
-		update_node_info(node, &data_2);
-		update_node_location(node, &data_2);
-		return;
+
+		if (cqe->res >= 0) {
+			bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			out = (struct io_uring_recvmsg_out *)
+				uring_buf(&uring_io.recv, bid);
+			payload = (char *)(out + 1) + msg->msg_namelen;
+
+			/* payloadlen is the size sent, not what fit */
+			bytes = out->payloadlen;
+			if (bytes > BUFF_LEN)
+				bytes = BUFF_LEN;
+
+			if (tag == URING_RECV_WELLED) {
+				i = recv_batch.count++;
+				recv_batch.frame[i] = payload;
+				recv_batch.bid[i] = bid;
+				recv_batch.bytes[i] = bytes;
+				memcpy(&recv_batch.addr[i], out + 1,
+					sizeof(union transport_addr));
+				if (recv_batch.count == RECV_BATCH)
+					uring_backend_relay();
+			} else {
+				relay_from_host(payload, bytes);
+				uring_buf_recycle(&uring_io.recv, bid);
+			}
+		} else if (cqe->res != -ENOBUFS) {
+			/* leave this socket to epoll from now on */
+			print_debug(LOG_ERR, "io_uring receive on %d failed: %s, using epoll",
+					fd, strerror(-cqe->res));
+			reactor_add(r, fd);
+			uring_seen(&uring_io.recv);
+			continue;
+		}
+
+		/* the kernel ends a multishot receive when it runs dry */
+		if (!(cqe->flags & IORING_CQE_F_MORE)) {
+			if (uring_backend_take(r, fd, msg, tag) < 0)
+				reactor_add(r, fd);
+		}
+
+		uring_seen(&uring_io.recv);
 	}
 
-#ifndef _WIN32
-	/* send to other wmasterd hosts */
-	send_to_hosts(buf, bytes, node->room);
-#endif
+	uring_backend_relay();
+}
 
-	/* not a status message or an update, relay */
-	send_to_nodes_vmci(buf, bytes, node);
+/**
+ *	@brief Logs how many requests were submitted to and completed by
+ *	each ring
+ *	@return void
+ */
+void uring_backend_status(void)
+{
+	if (uring_io.send.fd >= 0)
+		print_debug(LOG_INFO, "io_uring sends: %lu submitted, %lu completed",
+			uring_io.send.submitted, uring_io.send.completed);
+	if (uring_io.recv.fd >= 0)
+		print_debug(LOG_INFO, "io_uring receives: %lu submitted, %lu completed",
+			uring_io.recv.submitted, uring_io.recv.completed);
+}
+
+/**
+ *	@brief Reports the final counts and tears down the rings
+ *	@return void
+ */
+void uring_backend_free(void)
+{
+	uring_backend_status();
+
+	uring_io.sending = 0;
+	uring_io.receiving = 0;
+	uring_free(&uring_io.send);
+	uring_free(&uring_io.recv);
+	if (uring_io.eventfd >= 0)
+		close(uring_io.eventfd);
 }
+#endif
+#endif
 
 /**
  *	@brief main function
@@ -2099,30 +6228,39 @@ int main(int argc, char *argv[])
 {
 	int opt;
 	int cid;
-	struct timeval tv;
-	int ret;
 	int long_index;
+	int frame_threads;
+#ifndef HAVE_EPOLL
+	struct timeval tv;
 	fd_set fds;
+	int ret;
+#endif
 #ifndef _WIN32
 	struct utsname uts_buf;
 	int vsock_dev_fd;
 
-	vsock_dev_fd = 0;
+	vsock_dev_fd = -1;
 #endif
 
 	check_room = 1;
 	update_room = 0;
-	ret = 0;
 	verbose = 0;
 	head = 0;
+	tail = 0;
 	running = 0;
 	esx = 0;
 	long_index = 0;
 	print_status = 0;
 	send_distance = 0;
+	distance_method = DISTANCE_HAVERSINE;
+	neighbour_threads = 0;
+	use_uring = 0;
+	relay_threads = 0;
+	fanout_threshold = FANOUT_THRESHOLD;
 	broadcast = 0;
 	loglevel = -1;
 	send_pashr = 0;
+	transport_parse(&transport, "vsock");
 
 	static struct option long_options[] = {
 		{"help",		no_argument, 0, 'h'},
@@ -2131,12 +6269,19 @@ int main(int argc, char *argv[])
 		{"no-check-room",	no_argument, 0, 'r'},
 		{"update-room",		no_argument, 0, 'u'},
 		{"distance",		no_argument, 0, 'd'},
+		{"equirect",		no_argument, 0, 'e'},
 		{"pashr",		no_argument, 0, 'p'},
+		{"threads",		required_argument, 0, 't'},
+		{"workers",		required_argument, 0, 'w'},
+		{"fanout",		required_argument, 0, 'F'},
+		{"io-uring",		no_argument, 0, 'U'},
+		{"transport",		required_argument, 0, 'T'},
+		{"peer",		required_argument, 0, 'P'},
 		{"debug",		required_argument, 0, 'D'},
 		{"cache",		required_argument, 0, 'c'}
 	};
 
-	while ((opt = getopt_long(argc, argv, "hVvbrudpD:c:", long_options,
+	while ((opt = getopt_long(argc, argv, "hVvbrudepUt:w:F:T:P:D:c:", long_options,
 			&long_index)) != -1) {
 		switch (opt) {
 		case 'h':
@@ -2163,6 +6308,34 @@ int main(int argc, char *argv[])
 		case 'd':
 			send_distance = 1;
 			break;
+		case 'e':
+			distance_method = DISTANCE_EQUIRECT;
+			break;
+		case 't':
+			neighbour_threads = atoi(optarg);
+			break;
+		case 'w':
+			relay_threads = atoi(optarg);
+			break;
+		case 'F':
+			fanout_threshold = atoi(optarg);
+			break;
+		case 'U':
+			use_uring = 1;
+			break;
+		case 'T':
+			if (transport_parse(&transport, optarg) < 0) {
+				printf("wmasterd: unknown transport %s\n",
+						optarg);
+				show_usage(EXIT_FAILURE);
+			}
+			break;
+		case 'P':
+			if (peer_add(optarg) < 0) {
+				printf("wmasterd: bad peer %s\n", optarg);
+				show_usage(EXIT_FAILURE);
+			}
+			break;
 		case 'D':
 			loglevel = atoi(optarg);
 			printf("wmasterd: syslog level set to %d\n", loglevel);
@@ -2195,8 +6368,8 @@ int main(int argc, char *argv[])
 
 	#ifdef _WIN32
 	WSAStartup(MAKEWORD(1,1), &wsa_data);
-	if (broadcast) {
-		printf("broadcast not implemented on windows\n");
+	if (broadcast || peer_count) {
+		printf("broadcast and peers not implemented on windows\n");
 		show_usage(EXIT_FAILURE);
 	}
 	/* TODO: use vm_sockets and ioctl to get cid */
@@ -2218,33 +6391,46 @@ int main(int argc, char *argv[])
 
 	/* TODO: add check for other hypervisors */
 
-	vsock_dev_fd = open("/dev/vsock", 0);
-	if (vsock_dev_fd < 0) {
-		sock_error("wmasterd: open");
-		print_debug(LOG_ERR, "could not open /dev/vsock\n");
-		_exit(EXIT_FAILURE);
-	}
-	if (ioctl(vsock_dev_fd, IOCTL_VM_SOCKETS_GET_LOCAL_CID, &cid) < 0)
-		perror("wmasterd: ioctl IOCTL_VM_SOCKETS_GET_LOCAL_CID");
+	if (transport.type == TRANSPORT_VSOCK) {
+		vsock_dev_fd = open("/dev/vsock", 0);
+		if (vsock_dev_fd < 0) {
+			sock_error("wmasterd: open");
+			print_debug(LOG_ERR, "could not open /dev/vsock\n");
+			_exit(EXIT_FAILURE);
+		}
+		if (ioctl(vsock_dev_fd, IOCTL_VM_SOCKETS_GET_LOCAL_CID, &cid) < 0)
+			perror("wmasterd: ioctl IOCTL_VM_SOCKETS_GET_LOCAL_CID");
 
-	if (ioctl(vsock_dev_fd, IOCTL_VMCI_SOCKETS_GET_AF_VALUE, &af) < 0) {
-		perror("wmasterd: ioctl IOCTL_VMCI_SOCKETS_GET_AF_VALUE");
-		af = -1;
-	}
+		if (ioctl(vsock_dev_fd, IOCTL_VMCI_SOCKETS_GET_AF_VALUE, &af) < 0) {
+			perror("wmasterd: ioctl IOCTL_VMCI_SOCKETS_GET_AF_VALUE");
+			af = -1;
+		}
 
-	if (af == -1) {
-		/* take a guess */
-		if (esx)
-			af = 53;
-		else
-			af = 40;
+		if (af == -1) {
+			/* take a guess */
+			if (esx)
+				af = 53;
+			else
+				af = 40;
+		}
 	}
 	#endif
-	printf("wmasterd: CID: %u\n", cid);
+	if (transport.type == TRANSPORT_VSOCK) {
+		transport.af = af;
+		printf("wmasterd: CID: %u\n", cid);
+	} else {
+		printf("wmasterd: transport: %s\n", transport_name(&transport));
+	}
 
 	/*Handle kill signals*/
 	running = 1;
-	#ifndef _WIN32
+	#ifdef HAVE_EPOLL
+	/* signals are read from a descriptor by the main loop */
+	if (reactor_init(&reactor) < 0) {
+		print_debug(LOG_ERR, "error: cannot set up event loop");
+		return EXIT_FAILURE;
+	}
+	#elif !defined(_WIN32)
 	signal(SIGINT, (void *)signal_handler);
 	signal(SIGTERM, (void *)signal_handler);
 	signal(SIGQUIT, (void *)signal_handler);
@@ -2259,6 +6445,18 @@ int main(int argc, char *argv[])
 	else
 		strncpy(udp_int, "ens33", 8);
 
+	/* frames only go to peers with members in their room */
+	if (peer_count > 0) {
+		peer_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (peer_fd < 0) {
+			sock_error("wmasterd: socket");
+			print_debug(LOG_ERR, "error: could not create peer socket");
+			return EXIT_FAILURE;
+		}
+		print_debug(LOG_NOTICE, "relay to %d peers", peer_count);
+		broadcast = 0;
+	}
+
 	/* get ip address */
 	if (broadcast) {
 		int fd;
@@ -2278,9 +6476,12 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	/* setup vmci client socket */
-	sockfd = socket(af, SOCK_DGRAM, 0);
-	if (sockfd < 0) {
+	/* setup client socket */
+	sockfd = transport_open(&transport, transport.host, 0);
+	if ((sockfd < 0) && transport.seqpacket) {
+		/* only gelled still needs datagrams */
+		print_debug(LOG_WARNING, "warning: cannot open SOCK_DGRAM client, GPS will not be sent");
+	} else if (sockfd < 0) {
 		sock_error("wmasterd: socket");
 		print_debug(LOG_ERR, "error: cannot open SOCK_DGRAM client");
 		return EXIT_FAILURE;
@@ -2288,30 +6489,142 @@ int main(int argc, char *argv[])
 
 	/* TODO: add a udp socket for nmea stream/coordinate input */
 
-	/* create vmci server socket */
-	myservfd = socket(af, SOCK_DGRAM, 0);
-	if (myservfd < 0) {
-		sock_error("wmasterd: socket");
-		print_debug(LOG_ERR, "error: cannot open SOCK_DGRAM server");
+	/* create server socket */
+	myservfd = -1;
+	if (transport.seqpacket) {
+#ifdef HAVE_CONN
+		conn_fd = transport_listen(&transport, transport.host,
+				RECV_PORT);
+		if (conn_fd < 0) {
+			sock_error("wmasterd: listen");
+			print_debug(LOG_ERR, "error: cannot open SOCK_SEQPACKET server");
+			return EXIT_FAILURE;
+		}
+		/* io_uring only takes the datagram sockets over */
+		use_uring = 0;
+#else
+		print_debug(LOG_ERR, "error: SOCK_SEQPACKET is not supported");
 		return EXIT_FAILURE;
+#endif
+	} else {
+		myservfd = transport_open(&transport, transport.host,
+				RECV_PORT);
+		if (myservfd < 0) {
+			sock_error("wmasterd: myservaddr");
+			print_debug(LOG_ERR, "error: cannot open SOCK_DGRAM server");
+			return EXIT_FAILURE;
+		}
 	}
 
-	/* we can initalize this struct because it never changes */
-	memset(&myservaddr_vm, 0, sizeof(myservaddr_vm));
-	myservaddr_vm.svm_cid = VMADDR_CID_ANY;
-	myservaddr_vm.svm_port = RECV_PORT;
-	myservaddr_vm.svm_family = af;
-	ret = bind(myservfd, (struct sockaddr *)&myservaddr_vm,
-		sizeof(struct sockaddr));
-
-	if (ret < 0) {
-		sock_error("wmasterd: myservaddr");
-		print_debug(LOG_ERR, "error: invalid address");
+	/* welled on this host hand their shared memory channels over here */
+	if (transport.shm) {
+#ifdef HAVE_SHM
+		shm_fd = transport_open(&transport, transport.host,
+				TRANSPORT_SHM_PORT);
+		if (shm_fd < 0) {
+			sock_error("wmasterd: shm");
+			print_debug(LOG_ERR, "error: cannot open shared memory socket");
+			return EXIT_FAILURE;
+		}
+#else
+		print_debug(LOG_ERR, "error: shared memory is not supported");
 		return EXIT_FAILURE;
+#endif
 	}
 
 	pthread_mutex_init(&list_mutex, NULL);
 	pthread_mutex_init(&file_mutex, NULL);
+	sendq_init();
+#ifdef HAVE_CONN
+	conn_init();
+#endif
+#ifdef HAVE_SHM
+	shm_init();
+#endif
+
+	current_time = time(NULL);
+	tw_init(&expiry_wheel, current_time);
+
+	if (neighbour_pool_init(neighbour_threads) < 0) {
+		print_debug(LOG_ERR, "error: cannot start neighbour threads");
+		return EXIT_FAILURE;
+	}
+
+	if (fanout_pool_init(fanout_threshold) < 0) {
+		print_debug(LOG_ERR, "error: cannot start fan-out threads");
+		return EXIT_FAILURE;
+	}
+
+	if (relay_workers_init(relay_threads) < 0) {
+		print_debug(LOG_ERR, "error: cannot start relay workers");
+		return EXIT_FAILURE;
+	}
+
+	/*
+	 * relay workers keep frames after the receive batch moves on, send
+	 * queues keep copies for slow receivers and every thread which gets
+	 * or puts frames may hold some free ones in its cache: the pools
+	 * count their caller, add the nmea and hosts threads
+	 */
+	frame_threads = neighbour_pool.count + fanout_pool.count +
+			relay_count + 2;
+	if (frame_threads > FRAME_CACHES)
+		frame_threads = FRAME_CACHES;
+	if (frame_pool_init(&frame_pool, RECV_BATCH + SENDQ_FRAMES +
+			((relay_count > 0) ? FRAME_POOL_LEN : 0) +
+			frame_threads * FRAME_CACHE_MAX, FRAME_LEN) < 0) {
+		print_debug(LOG_ERR, "error: cannot allocate frame buffers");
+		return EXIT_FAILURE;
+	}
+
+	if (recv_batch_init(&recv_batch) < 0) {
+		print_debug(LOG_ERR, "error: cannot allocate receive buffers");
+		return EXIT_FAILURE;
+	}
+
+#ifdef HAVE_EPOLL
+	if ((myservfd >= 0) && (reactor_add(&reactor, myservfd) < 0))
+		return EXIT_FAILURE;
+
+#ifdef HAVE_CONN
+	if ((conn_fd >= 0) && (reactor_add(&reactor, conn_fd) < 0))
+		return EXIT_FAILURE;
+#endif
+
+#ifdef HAVE_SHM
+	if ((shm_fd >= 0) && (reactor_add(&reactor, shm_fd) < 0))
+		return EXIT_FAILURE;
+#endif
+
+	/* receive from other hosts */
+	if ((esx && broadcast) || (peer_count > 0)) {
+		reactor.hostfd = hosts_socket_open();
+		if (reactor_add(&reactor, reactor.hostfd) < 0)
+			return EXIT_FAILURE;
+	}
+
+#ifdef HAVE_IO_URING
+	/* takes the sockets over from epoll where the kernel allows */
+	if (use_uring)
+		uring_backend_init(&reactor);
+#else
+	if (use_uring)
+		print_debug(LOG_NOTICE, "io_uring not supported, using epoll");
+#endif
+
+	/* We wait for incoming msg unless kill signal received */
+	reactor_run(&reactor);
+
+	print_debug(LOG_INFO, "Shutting down...");
+
+#ifdef HAVE_IO_URING
+	if (use_uring)
+		uring_backend_free();
+#endif
+	reactor_free(&reactor);
+#else
+	if (use_uring)
+		print_debug(LOG_NOTICE, "io_uring not supported, using select");
 
 	/* start thread to send nmea */
 	ret = pthread_create(&nmea_tid, NULL, produce_nmea, NULL);
@@ -2333,7 +6646,7 @@ int main(int argc, char *argv[])
 
 #ifndef _WIN32
 	/* start thread to receive from other hosts */
-	if (esx && broadcast) {
+	if ((esx && broadcast) || (peer_count > 0)) {
 		ret = pthread_create(&hosts_tid, NULL, recv_from_hosts, NULL);
 		if (ret < 0) {
 			perror("wmasterd: pthread_create recv_from_hosts");
@@ -2353,56 +6666,57 @@ int main(int argc, char *argv[])
 		/* we need a timer to break us out of the recvfrom function */
 		tv.tv_sec = 0; /* seconds */
 		tv.tv_usec = 500000; /* microseconds */
+		/* come back sooner while frames wait in send queues */
+		if (__atomic_load_n(&sendq_backlog, __ATOMIC_RELAXED) > 0)
+			tv.tv_usec = SENDQ_POLL_MS * 1000;
 
 		ret = select(myservfd + 1, &fds, NULL, NULL, &tv);
 		if (ret < 0) {
 			/* timer error */
 			continue;
-		} else if (ret == 0) {
-			/*
-			 * timer expired
-			 * only check for stale nodes when timer expires
-			 * which is after .5 seconds of inactivity. when an
-			 * AP is broadcasting, this should never happen.
-			 */
+		}
 
-			#ifndef _WIN32
-			/* block signals while we perform node identification */
-			block_signal();
-			#endif
+		#ifndef _WIN32
+		/* block signals while we perform node identification */
+		block_signal();
+		#endif
 
-			pthread_mutex_lock(&list_mutex);
-			clear_inactive_nodes();
-			pthread_mutex_unlock(&list_mutex);
+		pthread_mutex_lock(&list_mutex);
 
-			#ifndef _WIN32
-			/* unblock signal */
-			unblock_signal();
-			#endif
-		} else {
-			/* data recived */
+		/*
+		 * expiring stale nodes only touches the nodes whose deadline
+		 * has passed, so it is cheap enough to do on every loop and
+		 * no longer depends on the relay going quiet
+		 */
+		current_time = time(NULL);
+		clear_inactive_nodes();
+		sendq_expire();
+#ifndef _WIN32
+		/* send room lists at the cadence run_tick uses */
+		if (peer_count > 0)
+			peer_advertise();
+#endif
 
-			#ifndef _WIN32
-			/* block signals while we perform node identification */
-			block_signal();
-			#endif
+		/* free what readers are done with */
+		relay_workers_quiesce();
+		epoch_reclaim();
 
-			pthread_mutex_lock(&list_mutex);
+		pthread_mutex_unlock(&list_mutex);
+
+		/* data recived, this takes list_mutex itself */
+		if (ret > 0)
 			recv_from_welled_vmci();
-			pthread_mutex_unlock(&list_mutex);
 
-			#ifndef _WIN32
-			/* unblock signal */
-			unblock_signal();
-			#endif
-		}
+		sendq_drain();
+
+		#ifndef _WIN32
+		/* unblock signal */
+		unblock_signal();
+		#endif
 
 		/* print status is requested by usr1 signal */
 		if (print_status) {
-			pthread_mutex_lock(&list_mutex);
-			print_debug(LOG_INFO, "status requested");
-			list_nodes_vmci();
-			pthread_mutex_unlock(&list_mutex);
+			print_status_now();
 			print_status = 0;
 		}
 	}
@@ -2416,9 +6730,22 @@ int main(int argc, char *argv[])
 	pthread_join(console_tid, NULL);
 
 	print_debug(LOG_INFO, "Threads have been cancelled");
+#endif
 
-	/* cleanup */
+	/* cleanup, queued frames are relayed first */
+	relay_workers_free();
+	fanout_pool_free();
+	neighbour_pool_free();
 	free_list();
+	recv_batch_free(&recv_batch);
+	sendq_free();
+#ifdef HAVE_CONN
+	conn_free();
+#endif
+#ifdef HAVE_SHM
+	shm_free();
+#endif
+	frame_pool_free(&frame_pool);
 
 	pthread_mutex_destroy(&list_mutex);
 	pthread_mutex_destroy(&file_mutex);
@@ -2429,9 +6756,14 @@ int main(int argc, char *argv[])
 		fclose(cache_fp);
 
 	/* close sockets*/
-	close(myservfd);
+	if (myservfd >= 0)
+		transport_close(&transport, myservfd, transport.host,
+				RECV_PORT);
+	if (sockfd >= 0)
+		transport_close(&transport, sockfd, transport.host, 0);
 	#ifndef _WIN32
-	close(vsock_dev_fd);
+	if (vsock_dev_fd >= 0)
+		close(vsock_dev_fd);
 	#endif
 
 	print_debug(LOG_NOTICE, "Exiting\n");
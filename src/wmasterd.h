@@ -32,6 +32,18 @@
 
 #ifndef WMASTERD_H_
 
+#include "symtab.h"
+#include "timerwheel.h"
+#include "epoch.h"
+#include "distance.h"
+#include "workpool.h"
+#include "mpsc.h"
+#include "framepool.h"
+#include "uring.h"
+#include "codel.h"
+#include "transport.h"
+#include "shmring.h"
+
 /** Buffer size for NMEA sentences */
 #define NMEA_LEN	100
 
@@ -39,6 +51,37 @@
 #define NAME_LEN	1024
 #define UUID_LEN	37
 
+/** Seconds without a frame after which a node is removed */
+#define NODE_TIMEOUT	300
+
+/** UDP port frames and room lists are exchanged with other hosts on */
+#define HOST_PORT	2018
+/** Most other hosts given with -P */
+#define PEER_MAX	32
+/** Seconds between room lists sent to each peer */
+#define PEER_ADVERTISE	2
+/** Seconds a room list from a peer is believed without being repeated */
+#define PEER_TIMEOUT	7
+/** Start of a room list, followed by the GUID of each room */
+#define PEER_ROOMS	"wmasterd:rooms:"
+
+/** Distance in meters beyond which nodes can not hear each other */
+#define RADIO_RANGE	2500
+/** Meters in a degree of arc, as used by get_distance */
+#define METERS_PER_DEGREE	111189.57f
+/** Size of a spatial grid cell in degrees, must span RADIO_RANGE */
+#define GRID_CELL	0.025f
+/** Number of grid cells from pole to pole */
+#define GRID_LAT_CELLS	7200
+/** Number of grid cells around a parallel */
+#define GRID_LON_CELLS	14400
+/** Most longitude cells searched each side before walking the whole room */
+#define GRID_MAX_SPAN	8
+/** Neighbour tables handed to a rebuild thread at a time */
+#define NEIGHBOUR_CHUNK	16
+/** Default number of receivers above which fan-out is spread over threads */
+#define FANOUT_THRESHOLD	256
+
 #ifdef _WIN32
 #define LOG_EMERG       0       /* system is unusable */
 #define LOG_ALERT       1       /* action must be taken immediately */
@@ -52,15 +95,13 @@
 
 /**
  *      Structure for tracking welled node locations
- *	latitude and longitude are stored in degrees decimal
  *	velocity is in knots
  *	heading is in degrees
+ *	latitude, longitude and altitude are kept with the room, see NODE_LAT
  */
 struct location {
-	char follow[FOLLOW_LEN];
-	float latitude;
-	float longitude;
-	float altitude;
+	/** symbol id of the name of the node being followed */
+	int follow_id;
 	float velocity;
 	float heading;
 	float pitch;
@@ -105,6 +146,137 @@ struct update_2 {
 	unsigned int cid;
 };
 
+struct client;
+
+/**
+ *      \brief Published members of a room
+ *
+ *      The fields read for every relayed frame are kept in parallel arrays
+ *      indexed by member position so fan-out and range checks walk
+ *      contiguous memory. Everything else about a member is in its
+ *      struct client, which records its position in these arrays. A
+ *      removed member is replaced by the last one.
+ *
+ *      Members are also hashed by the grid cell of their location so that
+ *      with send_distance only the cells around a transmitter are walked.
+ *      The set is republished when a member moves to another cell.
+ *
+ *      The trig of each location is worked out when neighbour tables are
+ *      refreshed, so tables are built with distance_batch and no trig.
+ *
+ *      A set is copied whenever a member joins or leaves, so threads
+ *      relaying frames can walk it without taking list_mutex. Only the
+ *      time stamp and location of members are updated in place. All of
+ *      the arrays share one allocation with the set.
+ */
+struct member_set {
+	/** number of nodes in the set */
+	int count;
+	/** remaining state of each member */
+	struct client **members;
+	/** CID of each member */
+	unsigned int *cid;
+	/** epoch time stamp of last access of each member */
+	int *time;
+	/** latitude of each member in degrees decimal */
+	float *latitude;
+	/** longitude of each member in degrees decimal */
+	float *longitude;
+	/** altitude of each member in meters */
+	float *altitude;
+	/** sine of each latitude as of the last neighbour refresh */
+	double *sin_lat;
+	/** cosine of each latitude as of the last neighbour refresh */
+	double *cos_lat;
+	/** sine of each longitude as of the last neighbour refresh */
+	double *sin_lon;
+	/** cosine of each longitude as of the last neighbour refresh */
+	double *cos_lon;
+	/** spatial grid cell each member was indexed under */
+	unsigned int *cell;
+	/** next member in the same grid bucket, -1 at the end */
+	int *cell_next;
+	/** first member in each grid bucket, -1 when empty */
+	int *cell_head;
+	/** number of grid buckets, a power of two */
+	int buckets;
+};
+
+/**
+ *      \brief Nodes in radio range of a node
+ *
+ *      Rebuilt once per movement epoch for the nodes whose distance to
+ *      another node may have changed, so relaying a frame needs no trig.
+ *      The node itself is included at distance 0. A table is never changed
+ *      once published, the CIDs and distances share one allocation.
+ */
+struct neighbour_table {
+	/** number of neighbours */
+	int count;
+	/** CID of each neighbour */
+	unsigned int *cid;
+	/** distance in meters to each neighbour */
+	int *distance;
+};
+
+/**
+ *      \brief Growable buffer for building a neighbour table
+ *
+ *      The members found by the grid walk are gathered into points so
+ *      their distances can be measured in one distance_batch call.
+ */
+struct neighbour_scratch {
+	/** position in the set of each candidate found so far */
+	int *pos;
+	/** location and trig of each candidate found so far */
+	struct geo_points points;
+	/** distance to each candidate, -1 if out of range */
+	int *distance;
+	/** number of candidates found so far */
+	int count;
+	/** number of entries allocated */
+	int size;
+};
+
+/**
+ *      \brief Members of a single room
+ *
+ *      Rooms are kept in their own list so that a frame is only relayed to
+ *      the nodes which share the room of the sender, and are found by the
+ *      symbol id of their GUID. Rooms are never freed while running.
+ */
+struct room {
+	/** symbol id of the GUID for Room */
+	int room_id;
+	/** current members, NULL when empty */
+	struct member_set *set;
+	/** when each peer last said it has members here */
+	int peer_seen[PEER_MAX];
+	/** neighbour_epoch in which a member last joined, left or moved */
+	unsigned long changed;
+	/** Pointer to next room */
+	struct room *next;
+};
+
+/**
+ *      \brief Another wmasterd host frames are forwarded to
+ *
+ *      Each peer sends the rooms it has members in every PEER_ADVERTISE
+ *      seconds. A frame is only forwarded to the peers which listed its
+ *      room within PEER_TIMEOUT seconds, instead of being broadcast to
+ *      every host.
+ */
+struct peer {
+	/** where frames and room lists are sent */
+	struct sockaddr_in addr;
+	/** address for messages */
+	char name[INET_ADDRSTRLEN];
+	/** room lists received */
+	unsigned long adverts;
+	/** frames forwarded */
+	unsigned long sent;
+};
+
 /**
  *      \brief Structure for tracking welled nodes
  *
@@ -114,22 +286,489 @@ struct update_2 {
 struct client {
 	/** CID */
 	unsigned int cid;
-        /** Isolation Tag */
-        char isolation_tag[UUID_LEN];
-	/** RoomID */
-	//int room_id;
-	/** GUID for Room */
-	char room[UUID_LEN];
-	/** VM name */
-	char name[NAME_LEN];
+	/** symbol id of the Isolation Tag */
+	int tag_id;
+	/** symbol id of the GUID for Room */
+	int room_id;
+	/** symbol id of the VM name */
+	int name_id;
 	/** VM UUID, unused */
 	char uuid[UUID_LEN];
-	/** epoch time stamp of last access */
-	int time;
 	/** GPS location data */
 	struct location loc;
+	/** deadline after which the node is checked for staleness */
+	struct tw_entry expiry;
 	/** Pointer to next node */
 	struct client *next;
+	/** Pointer to previous node */
+	struct client *prev;
+	/** room this node is a member of, only valid under list_mutex */
+	struct room *bucket;
+	/** position of this node in the members of its room */
+	int bucket_pos;
+	/** nodes in range, NULL until the first epoch after joining */
+	struct neighbour_table *neighbours;
+	/** position in moved_nodes plus one, 0 when not queued */
+	int moved;
+	/** sends which failed since failed_at, only valid under list_mutex */
+	int send_failures;
+	/** epoch time of the first of send_failures */
+	int failed_at;
+};
+
+/*
+ * the hot fields of a node in the current set of its room, these may only
+ * be used while holding list_mutex
+ */
+
+/** epoch time stamp of last access of a node */
+#define NODE_TIME(n)	((n)->bucket->set->time[(n)->bucket_pos])
+/** latitude of a node */
+#define NODE_LAT(n)	((n)->bucket->set->latitude[(n)->bucket_pos])
+/** longitude of a node */
+#define NODE_LON(n)	((n)->bucket->set->longitude[(n)->bucket_pos])
+/** altitude of a node */
+#define NODE_ALT(n)	((n)->bucket->set->altitude[(n)->bucket_pos])
+
+#if defined(__linux__) && !defined(_ESX)
+/** sendmmsg is available, ESXi ships a libc older than it */
+#define HAVE_SENDMMSG
+/** recvmmsg is available */
+#define HAVE_RECVMMSG
+/** epoll, timerfd and signalfd are available */
+#define HAVE_EPOLL
+#endif
+
+#if defined(HAVE_EPOLL) && defined(URING_SUPPORTED)
+/** the io_uring backend can be selected with -U */
+#define HAVE_IO_URING
+#endif
+
+#ifdef _WIN32
+/** sends on Windows block, WSAENOBUFS is still queued */
+#define SEND_DONTWAIT	0
+#else
+/** a full socket buffer fails the send so the frame can be queued */
+#define SEND_DONTWAIT	MSG_DONTWAIT
+#endif
+
+/** Send error which may not happen again, the frame is dropped */
+#define SEND_TRANSIENT		0
+/** Send error meaning the receiver is gone, the node is removed */
+#define SEND_PERSISTENT		1
+/** Any other send error, counted against SEND_FAIL_LIMIT */
+#define SEND_UNKNOWN		2
+/** Failed sends within SEND_FAIL_WINDOW after which a node is removed */
+#define SEND_FAIL_LIMIT		3
+/** Seconds over which failed sends are counted */
+#define SEND_FAIL_WINDOW	10
+
+/** Most frames handed to the kernel in one sendmmsg call */
+#define SEND_BATCH	64
+/** Size of the distance appended to frames, "welled:0000:" */
+#define DISTANCE_LEN	12
+/** Largest distance that fits the four digits of the trailer */
+#define DISTANCE_MAX	9999
+
+/**
+ *      \brief Copies of one frame waiting to be sent to several nodes
+ *
+ *      Fan-out adds each receiver here and the copies are sent SEND_BATCH
+ *      at a time with sendmmsg. The distance is sent from its own buffer
+ *      after the frame so the frame is never copied. Without sendmmsg
+ *      each copy is sent as soon as it is added.
+ */
+struct send_batch {
+	/** message data */
+	char *buf;
+	/** size of message data */
+	int bytes;
+	/** number of copies waiting */
+	int count;
+	/** set when the batch is sent off the main thread's io_uring ring */
+	int off_ring;
+#ifdef HAVE_SENDMMSG
+	/** CID of each receiver */
+	unsigned int cid[SEND_BATCH];
+	/** address of each receiver */
+	union transport_addr addr[SEND_BATCH];
+	/** frame and distance of each copy */
+	struct iovec iov[SEND_BATCH][2];
+	/** distance of each copy, with room for snprintf's terminator */
+	char distance[SEND_BATCH][DISTANCE_LEN + 1];
+	/** headers handed to sendmmsg */
+	struct mmsghdr msgs[SEND_BATCH];
+#endif
+};
+
+/** Most frames waiting for one receiver before new ones are dropped */
+#define SENDQ_LEN		16
+/** Buckets of the send queue hash, a power of two */
+#define SENDQ_BUCKETS		64
+/** Pooled frame buffers for frames waiting in send queues */
+#define SENDQ_FRAMES		256
+/** Milliseconds between attempts to drain send queues */
+#define SENDQ_POLL_MS		5
+/** Microseconds a frame may wait before CoDel considers dropping */
+#define SENDQ_TARGET_US		5000
+/** Microseconds the wait must stay above target before CoDel drops */
+#define SENDQ_INTERVAL_US	100000
+
+/**
+ *      \brief Frames waiting for a receiver whose socket buffer is full
+ *
+ *      A receiver is given a queue the first time sending to it fails
+ *      with a full buffer. While anything is queued, later frames for it
+ *      are queued behind so order is kept. Frames are copied into pooled
+ *      buffers with the distance already appended, and are dropped from
+ *      the head by CoDel when they wait too long.
+ */
+struct send_queue {
+	/** next queue in the same bucket */
+	struct send_queue *next;
+	/** CID of the receiver */
+	unsigned int cid;
+	/** pooled buffer of each frame */
+	void *frame[SENDQ_LEN];
+	/** size of each frame, including the distance */
+	int bytes[SENDQ_LEN];
+	/** when each frame was queued, in microseconds */
+	unsigned long long queued_at[SENDQ_LEN];
+	/** position of the oldest frame */
+	int head;
+	/** number of frames waiting */
+	int count;
+	/** drop state */
+	struct codel codel;
+	/** frames sent from the queue */
+	unsigned long sent;
+	/** frames dropped by CoDel or because the queue was full */
+	unsigned long dropped;
+	/** most frames that have waited at once */
+	int max_depth;
+	/** wait of the last frame to leave the queue, in microseconds */
+	unsigned long long sojourn;
+};
+
+/**
+ *      \brief Send queues whose CIDs share a hash
+ */
+struct send_bucket {
+	pthread_mutex_t lock;
+	struct send_queue *head;
+};
+
+#if defined(HAVE_EPOLL) && defined(SHM_SUPPORTED)
+/** welled on the same host can exchange frames through shared memory */
+#define HAVE_SHM
+#endif
+
+#ifdef HAVE_SHM
+/** Buckets of the shared memory channel hash, a power of two */
+#define SHM_BUCKETS		64
+/** Seconds a channel is kept for a node which has sent nothing yet */
+#define SHM_GRACE		10
+
+/**
+ *      \brief Shared memory channel of a welled on this host
+ *
+ *      Frames for the node are pushed to its down ring instead of being
+ *      sent, and frames it pushes to its up ring are relayed as if they
+ *      came from the socket. The eventfds are only signalled when the
+ *      other side has gone to sleep, so busy rings cost no system calls.
+ */
+struct shm_client {
+	/** next channel in the same bucket */
+	struct shm_client *next;
+	/** name of the node */
+	unsigned int cid;
+	/** the mapped channel */
+	struct shm_channel ch;
+	/** when the channel was offered */
+	time_t added;
+	/** frames taken from the up ring */
+	unsigned long received;
+	/** frames pushed to the down ring */
+	unsigned long sent;
+	/** frames dropped because the down ring was full */
+	unsigned long dropped;
+	/** times the up ring held invalid records */
+	unsigned long errors;
+};
+
+/**
+ *      \brief Shared memory channels whose CIDs share a hash
+ *
+ *      The lock also keeps a single producer on each down ring.
+ */
+struct shm_bucket {
+	pthread_mutex_t lock;
+	struct shm_client *head;
+};
+#endif
+
+#ifdef HAVE_EPOLL
+/** welled can hold a SOCK_SEQPACKET connection instead of datagrams */
+#define HAVE_CONN
+#endif
+
+#ifdef HAVE_CONN
+/** Buckets of the connection hash, a power of two */
+#define CONN_BUCKETS		64
+
+/**
+ *      \brief SOCK_SEQPACKET connection from a welled
+ *
+ *      Frames for the node are sent on the connection, so no address is
+ *      built per frame. A full buffer is EAGAIN and queued like any other,
+ *      while a closed connection removes the node at once instead of
+ *      waiting NODE_TIMEOUT for it to go stale.
+ */
+struct conn_client {
+	/** next connection in the same bucket */
+	struct conn_client *next;
+	/** name of the node */
+	unsigned int cid;
+	/** the connection */
+	int fd;
+	/** when the connection was accepted */
+	time_t added;
+	/** messages received */
+	unsigned long received;
+	/** messages sent */
+	unsigned long sent;
+};
+
+/**
+ *      \brief Connections whose CIDs share a hash
+ *
+ *      The lock is held while sending so a connection is not closed
+ *      under a sender.
+ */
+struct conn_bucket {
+	pthread_mutex_t lock;
+	struct conn_client *head;
+};
+#endif
+
+/** Most datagrams taken from the socket in one recvmmsg call */
+#define RECV_BATCH	32
+
+/**
+ *      \brief Datagrams received together from welled
+ *
+ *      The receive buffers are allocated once and reused. Every datagram
+ *      of a batch is checked against the node list under a single hold
+ *      of list_mutex, what fan-out needs is copied out per datagram and
+ *      the frames are relayed once the lock is released.
+ */
+struct recv_batch {
+	/** number of datagrams received */
+	int count;
+	/** pooled buffer each datagram is received into */
+	void *buffer[RECV_BATCH];
+	/** each datagram, in buffer or in a provided io_uring buffer */
+	char *frame[RECV_BATCH];
+	/** provided io_uring buffer holding each datagram, -1 for data */
+	int bid[RECV_BATCH];
+	/** size of each datagram */
+	int bytes[RECV_BATCH];
+	/** address each datagram came from */
+	union transport_addr addr[RECV_BATCH];
+#ifdef HAVE_RECVMMSG
+	/** buffer of each datagram */
+	struct iovec iov[RECV_BATCH];
+	/** headers handed to recvmmsg */
+	struct mmsghdr msgs[RECV_BATCH];
+#endif
+	/** whether each datagram is a frame to relay */
+	int relay[RECV_BATCH];
+	/** room of the sender of each frame */
+	int room_id[RECV_BATCH];
+	/** latitude of the sender of each frame */
+	float latitude[RECV_BATCH];
+	/** longitude of the sender of each frame */
+	float longitude[RECV_BATCH];
+	/** neighbours of the sender of each frame, may be NULL */
+	struct neighbour_table *table[RECV_BATCH];
+};
+
+/** Most relay worker threads */
+#define RELAY_WORKERS_MAX	16
+/** Most frames waiting for one relay worker before new ones are dropped */
+#define RELAY_QUEUE_LEN		1024
+/** Pooled frame buffers for frames waiting for relay workers */
+#define FRAME_POOL_LEN		2048
+/** Times a relay worker looks again before sleeping on an empty ring */
+#define RELAY_SPIN		64
+
+/**
+ *      \brief A frame classified by the receiving thread, waiting to be
+ *      relayed
+ *
+ *      Everything fan-out needs is copied out of the node list before
+ *      the frame is queued. A queued job sits at the start of a pooled
+ *      buffer, ahead of the frame, so the pointer pushed to the worker
+ *      is both the job and the buffer. The neighbour table was loaded in the read
+ *      section of the receiving thread, the worker's pin keeps it from
+ *      being freed until the frame is relayed.
+ */
+struct relay_job {
+	/** pooled buffer holding the job and the frame, NULL if neither */
+	void *frame;
+	/** the frame */
+	char *buf;
+	/** size of the frame */
+	int bytes;
+	/** whether the frame is also sent to other wmasterd hosts */
+	int hosts;
+	/** CID of the sender, 0 for frames from other hosts */
+	unsigned int cid;
+	/** room of the sender */
+	int room_id;
+	/** latitude of the sender */
+	float latitude;
+	/** longitude of the sender */
+	float longitude;
+	/** neighbours of the sender, may be NULL */
+	struct neighbour_table *table;
+};
+
+/**
+ *      \brief Thread relaying the frames of the rooms hashed to it
+ *
+ *      All frames of a room go through the same worker, so they are
+ *      relayed in the order they arrived while other rooms are relayed
+ *      on other cores. Any thread may queue frames without taking a
+ *      lock, the worker only sleeps once its ring stays empty.
+ *
+ *      The pin is moved only by the thread reclaiming memory. It moves
+ *      to the oldest read section seen at the previous reclaim once the
+ *      worker has relayed every frame queued before then, so whatever
+ *      a queued frame points at outlives the thread which queued it.
+ */
+struct relay_worker {
+	/** the thread */
+	pthread_t tid;
+	/** frames waiting, as struct relay_job pointers */
+	struct mpsc_ring ring;
+	/** posted when a frame is queued for a sleeping worker */
+	sem_t wake;
+	/** set while the worker sleeps or is about to */
+	int sleeping;
+	/** set to stop once the ring is empty */
+	int stop;
+	/** frames relayed */
+	unsigned long relayed;
+	/** frames dropped because the ring was full or memory ran out */
+	unsigned long dropped;
+	/** epoch pin held for the frames waiting */
+	int pin;
+	/** oldest read section at the previous reclaim */
+	unsigned long seen_epoch;
+	/** frames queued by the previous reclaim */
+	unsigned long seen_claimed;
+};
+
+/** Seconds between GPS sentences, expiry of stale nodes and reclaiming */
+#define TICK_SECONDS	1
+/** Most events handled per epoll_wait */
+#define REACTOR_EVENTS	16
+
+/**
+ *      \brief Descriptors watched by the main thread
+ *
+ *      With epoll the main thread waits on everything wmasterd reacts to,
+ *      so it only wakes when there is something to do. Frames, ticks,
+ *      signals and console input are handled in turn and no other
+ *      thread is needed besides the neighbour pool. Unused descriptors
+ *      are -1.
+ */
+struct reactor {
+	/** the epoll instance */
+	int epfd;
+	/** SIGUSR1 and the signals which stop wmasterd */
+	int sigfd;
+	/** fires every TICK_SECONDS */
+	int timerfd;
+	/** UDP socket for frames from other hosts */
+	int hostfd;
+	/** console commands, -1 once it is closed */
+	int console;
+};
+
+#ifdef HAVE_IO_URING
+/** SQEs in the send ring, every copy of a send_batch fits at once */
+#define URING_SEND_ENTRIES	SEND_BATCH
+/** Provided receive buffers, a power of two */
+#define URING_RECV_BUFS		64
+/** Provided buffer group for receives */
+#define URING_RECV_GROUP	1
+
+/** user_data of the multishot receive on the welled socket */
+#define URING_RECV_WELLED	1
+/** user_data of the multishot receive on the inter-host socket */
+#define URING_RECV_HOST		2
+
+/**
+ *      \brief Optional io_uring I/O for the relay
+ *
+ *      Selected with -U. Fan-out hands each send_batch to the kernel as
+ *      one chain of hard linked sendmsg requests, so the copies go out
+ *      in order and a failed copy does not cancel the rest. Multishot
+ *      receives stay posted on the welled and inter-host sockets and
+ *      land in provided buffers. The receive ring signals an eventfd the
+ *      reactor watches in place of the sockets. Either half falls back
+ *      to the epoll path if the kernel does not support it.
+ */
+struct uring_backend {
+	/** whether send_batch_flush uses send */
+	int sending;
+	/** ring used for fan-out, only by the main thread */
+	struct uring send;
+	/** whether receives are posted on recv */
+	int receiving;
+	/** ring with the multishot receives */
+	struct uring recv;
+	/** signalled by recv on every completion */
+	int eventfd;
+	/** template for receives on the welled socket */
+	struct msghdr welled_msg;
+	/** template for receives on the inter-host socket */
+	struct msghdr host_msg;
+};
+#endif
+
+/** Initial number of slots in the CID index, must be a power of two */
+#define CID_INDEX_MIN	64
+
+/**
+ *      \brief Entry in the CID index
+ *
+ *      The CID is stored with the pointer so probing does not touch the
+ *      node itself.
+ */
+struct client_slot {
+	/** CID of the node */
+	unsigned int cid;
+	/** the node, NULL marks an empty slot */
+	struct client *node;
+};
+
+/**
+ *      \brief Open addressing index of welled clients keyed by CID
+ *
+ *      Linear probing table kept next to the linked list so that a node
+ *      can be found without walking the list. size is a power of two and
+ *      the table doubles once it is more than half full.
+ */
+struct client_index {
+	/** table of entries */
+	struct client_slot *slots;
+	/** number of slots */
+	unsigned int size;
+	/** number of nodes stored */
+	unsigned int count;
 };
 
 void show_usage(int);
@@ -139,28 +778,124 @@ void unblock_signal(void);
 int parse_vmx(char *, unsigned int, char *, char *, char *);
 void get_vm_info(unsigned int, char *, char *, char *);
 void add_node_vmci(unsigned int, char *, char *, char *);
+void expire_node(struct tw_entry *);
 void clear_inactive_nodes(void);
 struct client *search_node_vmci(unsigned int);
-struct client *search_node_name(char *);
+unsigned int cid_hash(unsigned int);
+int cid_index_grow(unsigned int);
+int cid_index_insert(struct client *);
+struct client *cid_index_lookup(unsigned int);
+void cid_index_remove(unsigned int);
+void cid_index_free(void);
+struct room *search_room(int);
+struct room *add_room(int);
+struct member_set *member_set_alloc(int);
+unsigned int grid_cell(float, float);
+int grid_span(float);
+void member_set_index(struct member_set *);
+void node_moved(struct client *);
+void grid_visit(struct member_set *, float, float,
+		void (*)(struct member_set *, int, void *), void *);
+void node_mark(struct client *);
+void node_unmark(struct client *);
+void mark_neighbours(struct neighbour_table *);
+struct neighbour_table *neighbour_table_build(struct client *,
+		struct neighbour_scratch *);
+struct neighbour_table *node_neighbours(struct client *);
+void refresh_neighbours(void);
+int neighbour_pool_init(int);
+void neighbour_pool_free(void);
+int fanout_pool_init(int);
+void fanout_pool_free(void);
+void room_publish(struct room *, struct member_set *);
+int room_add_member(struct client *);
+void room_remove_pos(struct room *, int);
+void room_remove_member(struct client *);
+void free_rooms(void);
+struct client *search_node_name(int);
 void list_nodes_vmci(void);
 void remove_node_vmci(unsigned int);
-void send_to_hosts(char *, int, char *);
-void send_to_nodes_vmci(char *, int, struct client *);
+void send_to_hosts(char *, int, int);
+int peer_add(const char *);
+void peer_advertise(void);
+void peer_interest(char *, int, struct sockaddr_in *);
+void peer_status(void);
+int send_failed(unsigned int, int);
+int send_to_node_vmci(char *, int, unsigned int, int);
+void send_batch_init(struct send_batch *, char *, int);
+void send_batch_add(struct send_batch *, unsigned int, int);
+void send_batch_flush(struct send_batch *);
+int send_backlogged(void);
+int send_error_class(void);
+void sendq_init(void);
+int sendq_add(unsigned int, char *, int, char *);
+int sendq_busy(unsigned int);
+void sendq_drain(void);
+void sendq_expire(void);
+void sendq_status(void);
+void sendq_free(void);
+void send_to_neighbours_vmci(char *, int, struct neighbour_table *);
+void send_to_room_vmci(struct send_batch *, struct room *, unsigned int,
+		float, float);
+void send_to_nodes_vmci(char *, int, unsigned int, int, float, float);
+int send_gps_to_node(struct member_set *, int);
 void send_gps_to_nodes(void);
 void *produce_nmea(void *);
 void free_list(void);
 void usr1_handler(void);
 void signal_handler(void);
+int recv_batch_init(struct recv_batch *);
+void recv_batch_free(struct recv_batch *);
+int recv_batch_fill(struct recv_batch *);
+void recv_batch_process(struct recv_batch *);
+void relay_run(struct relay_job *);
+void relay_submit(struct relay_job *);
+int relay_workers_init(int);
+void relay_workers_free(void);
+void relay_workers_quiesce(void);
 void recv_from_welled_vmci(void);
+int hosts_socket_open(void);
+void relay_from_host(char *, int);
+void recv_from_host(int);
 void *recv_from_hosts(void *);
+void run_tick(void);
+void print_status_now(void);
+int reactor_init(struct reactor *);
+int reactor_add(struct reactor *, int);
+void reactor_run(struct reactor *);
+void reactor_free(struct reactor *);
+#ifdef HAVE_CONN
+void conn_init(void);
+int conn_send(unsigned int, char *, int, char *);
+int conn_connected(unsigned int);
+void conn_accept(struct reactor *);
+void conn_recv(int);
+void conn_status(void);
+void conn_free(void);
+#endif
+#ifdef HAVE_SHM
+void shm_init(void);
+int shm_send(unsigned int, char *, int, char *);
+void shm_accept(struct reactor *);
+void shm_drain(void);
+void shm_expire(void);
+void shm_status(void);
+void shm_free(void);
+#endif
+#ifdef HAVE_IO_URING
+void uring_backend_init(struct reactor *);
+void uring_backend_send(struct send_batch *);
+void uring_backend_reap(struct reactor *);
+void uring_backend_status(void);
+void uring_backend_free(void);
+#endif
 void update_node_location(struct client *, struct update_2 *);
 void update_node_info(struct client *, struct update_2 *);
 void update_cache_file_info(struct client *);
 void update_cache_file_location(struct client *);
 void update_followers(struct client *);
-int get_distance(struct client *, struct client *);
 unsigned int nmea_checksum(char *);
-void create_new_sentences(struct client *);
+void create_new_sentences(struct member_set *, int);
 double rad2deg(double);
 double deg2rad(double);
 void dec_deg_to_dec_min(float, char *, int);
@@ -0,0 +1,251 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef _ESX
+/** ESXi 5.5 and 6.0 do not have 2.24 so we need to link older one */
+__asm__(".symver memcpy,memcpy@GLIBC_2.2.5");
+#endif
+
+#include "workpool.h"
+
+/**
+ *	@brief Counts the processors available to run workers on
+ *	@return number of processors, at least 1
+ */
+int work_pool_cpus(void)
+{
+	long cpus;
+
+	cpus = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (cpus < 1)
+		cpus = 1;
+
+	return cpus;
+}
+
+/**
+ *	@brief Works through chunks of the current job until none are left
+ *	@param pool - the pool
+ *	@param id - worker number of the calling thread
+ *	@return void
+ */
+static void work_pool_drain(struct work_pool *pool, int id)
+{
+	int first;
+	int last;
+
+	for (;;) {
+		first = __atomic_fetch_add(&pool->next, pool->chunk,
+				__ATOMIC_RELAXED);
+		if (first >= pool->last)
+			break;
+		last = first + pool->chunk;
+		if (last > pool->last)
+			last = pool->last;
+		pool->job(pool->arg, id, first, last);
+	}
+}
+
+/**
+ *	@brief Helper thread which waits for jobs and works on them
+ *	@param arg - the struct work_thread of the thread
+ *	@return NULL
+ */
+static void *work_pool_thread(void *arg)
+{
+	struct work_thread *thread;
+	struct work_pool *pool;
+	unsigned long seen;
+
+	thread = arg;
+	pool = thread->pool;
+	seen = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while ((pool->generation == seen) && !pool->stop)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->stop)
+			break;
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		work_pool_drain(pool, thread->id);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+/**
+ *	@brief Starts the helper threads of a pool
+ *	if a thread can not be started the pool runs with fewer workers
+ *	@param pool - the pool
+ *	@param count - number of workers including the caller of work_pool_run
+ *	@return 0 on success, -1 on failure
+ */
+int work_pool_init(struct work_pool *pool, int count)
+{
+	int ret;
+	int i;
+
+	if (count < 1)
+		count = 1;
+
+	pool->count = 1;
+	pool->generation = 0;
+	pool->busy = 0;
+	pool->stop = 0;
+	pool->job = NULL;
+	pool->arg = NULL;
+	pool->next = 0;
+	pool->last = 0;
+	pool->chunk = 1;
+
+	pool->threads = calloc(count, sizeof(struct work_thread));
+	if (!pool->threads) {
+		perror("workpool: calloc");
+		return -1;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (i = 1; i < count; i++) {
+		pool->threads[i - 1].pool = pool;
+		pool->threads[i - 1].id = i;
+		ret = pthread_create(&pool->threads[i - 1].tid, NULL,
+				work_pool_thread, &pool->threads[i - 1]);
+		if (ret != 0) {
+			fprintf(stderr, "workpool: pthread_create failed, "
+					"running with %d workers\n", i);
+			break;
+		}
+		pool->count++;
+	}
+
+	return 0;
+}
+
+/**
+ *	@brief Calls a job for every item in a range, spread over the pool
+ *	returns once every item is done and is not a cancellation point
+ *	@param pool - the pool
+ *	@param first - first item
+ *	@param last - one past the last item
+ *	@param chunk - number of items handed to a worker at a time
+ *	@param job - called with arg, the worker number and a range of items
+ *	@param arg - passed to job
+ *	@return void
+ */
+void work_pool_run(struct work_pool *pool, int first, int last, int chunk,
+		void (*job)(void *, int, int, int), void *arg)
+{
+	int state;
+
+	if (first >= last)
+		return;
+
+	if (chunk < 1)
+		chunk = 1;
+
+	/* not worth waking anyone for a single chunk */
+	if ((pool->count == 1) || (last - first <= chunk)) {
+		job(arg, 0, first, last);
+		return;
+	}
+
+	/* the helpers must not be left on a job nobody waits for */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->job = job;
+	pool->arg = arg;
+	pool->next = first;
+	pool->last = last;
+	pool->chunk = chunk;
+	pool->busy = pool->count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	work_pool_drain(pool, 0);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+
+	pthread_setcancelstate(state, NULL);
+}
+
+/**
+ *	@brief Stops the helper threads of a pool and frees it
+ *	@param pool - the pool, no job may be running
+ *	@return void
+ */
+void work_pool_free(struct work_pool *pool)
+{
+	int i;
+
+	if (pool->threads == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->count - 1; i++)
+		pthread_join(pool->threads[i].tid, NULL);
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+
+	free(pool->threads);
+	pool->threads = NULL;
+	pool->count = 1;
+}
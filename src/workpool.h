@@ -0,0 +1,95 @@
+/*
+ *	Copyright 2018 Carnegie Mellon University. All Rights Reserved.
+ *
+ *	NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *	INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *	UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR IMPLIED,
+ *	AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF FITNESS FOR
+ *	PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS OBTAINED FROM USE OF
+ *	THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT MAKE ANY WARRANTY OF
+ *	ANY KIND WITH RESPECT TO FREEDOM FROM PATENT, TRADEMARK, OR COPYRIGHT
+ *	INFRINGEMENT.
+ *
+ *	Released under a GNU GPL 2.0-style license, please see license.txt or
+ *	contact permission@sei.cmu.edu for full terms.
+ *
+ *	[DISTRIBUTION STATEMENT A] This material has been approved for public
+ *	release and unlimited distribution.  Please see Copyright notice for
+ *	non-US Government use and distribution. Carnegie Mellon® and CERT® are
+ *	registered in the U.S. Patent and Trademark Office by Carnegie Mellon
+ *	University.
+ *
+ *	This Software includes and/or makes use of the following Third-Party
+ *	Software subject to its own license:
+ *	1. wmediumd (https://github.com/bcopeland/wmediumd)
+ *		Copyright 2011 cozybit Inc..
+ *	2. mac80211_hwsim (https://github.com/torvalds/linux/blob/master/drivers/net/wireless/mac80211_hwsim.c)
+ *		Copyright 2008 Jouni Malinen <j@w1.fi>
+ *		Copyright (c) 2011, Javier Lopez <jlopex@gmail.com>
+ *
+ *	DM17-0952
+ */
+
+#ifndef WORKPOOL_H_
+#define WORKPOOL_H_
+
+#include <pthread.h>
+
+struct work_pool;
+
+/**
+ *      \brief A helper thread of a work pool
+ */
+struct work_thread {
+	/** the pool the thread belongs to */
+	struct work_pool *pool;
+	/** worker number passed to jobs, the caller of work_pool_run is 0 */
+	int id;
+	/** the thread */
+	pthread_t tid;
+};
+
+/**
+ *      \brief Fixed set of threads which split a range of work items
+ *
+ *      The thread calling work_pool_run works on the range alongside the
+ *      helper threads and returns once every item is done. Items are
+ *      handed out a chunk at a time so uneven items still balance.
+ *      Only one thread may run jobs on a pool at a time.
+ */
+struct work_pool {
+	/** number of workers including the caller */
+	int count;
+	/** helper threads, count - 1 of them */
+	struct work_thread *threads;
+	/** protects the fields below */
+	pthread_mutex_t mutex;
+	/** signalled when a job is posted or the pool stops */
+	pthread_cond_t start;
+	/** signalled when the last helper finishes a job */
+	pthread_cond_t done;
+	/** bumped for every job posted */
+	unsigned long generation;
+	/** helpers still working on the current job */
+	int busy;
+	/** set when the helpers should exit */
+	int stop;
+	/** function called for each chunk of the current job */
+	void (*job)(void *, int, int, int);
+	/** passed to job */
+	void *arg;
+	/** next item of the current job to hand out */
+	int next;
+	/** end of the current job */
+	int last;
+	/** number of items handed out at a time */
+	int chunk;
+};
+
+int work_pool_cpus(void);
+int work_pool_init(struct work_pool *, int);
+void work_pool_run(struct work_pool *, int, int, int,
+		void (*)(void *, int, int, int), void *);
+void work_pool_free(struct work_pool *);
+
+#endif /* WORKPOOL_H_ */